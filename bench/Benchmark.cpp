@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <BufferStream.h>
+#include <BufferStreamVectorKernels.h>
+#include <FileStream.h>
+
+#include "Harness.h"
+#include "PerfCounters.h"
+#include "Workloads.h"
+
+namespace {
+
+struct BufferStreamReader {
+	BufferStreamReadOnly& stream;
+
+	template<typename T>
+	T get() {
+		return this->stream.read<T>();
+	}
+
+	template<typename T>
+	void get(T* out, std::uint64_t n) {
+		this->stream.read(out, n);
+	}
+
+	std::string get_string() {
+		return this->stream.read_string();
+	}
+};
+
+struct FileStreamReader {
+	FileStream& stream;
+
+	template<typename T>
+	T get() {
+		return this->stream.read<T>();
+	}
+
+	template<typename T>
+	void get(T* out, std::uint64_t n) {
+		this->stream.read(out, n);
+	}
+
+	std::string get_string() {
+		return this->stream.read_string();
+	}
+};
+
+struct IfstreamReader {
+	std::ifstream& stream;
+
+	template<typename T>
+	T get() {
+		T out{};
+		this->stream.read(reinterpret_cast<char*>(&out), sizeof(T));
+		return out;
+	}
+
+	template<typename T>
+	void get(T* out, std::uint64_t n) {
+		this->stream.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(sizeof(T) * n));
+	}
+
+	std::string get_string() {
+		std::string out;
+		std::getline(this->stream, out, '\0');
+		return out;
+	}
+};
+
+struct FreadReader {
+	std::FILE* file;
+
+	template<typename T>
+	T get() {
+		T out{};
+		std::fread(&out, sizeof(T), 1, this->file);
+		return out;
+	}
+
+	template<typename T>
+	void get(T* out, std::uint64_t n) {
+		std::fread(out, sizeof(T), n, this->file);
+	}
+
+	std::string get_string() {
+		std::string out;
+		for (int c = std::fgetc(this->file); c != EOF && c != '\0'; c = std::fgetc(this->file)) {
+			out += static_cast<char>(c);
+		}
+		return out;
+	}
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const std::uint64_t size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4 * 1024 * 1024;
+	constexpr std::uint64_t SEED = 0xB0FFE85;
+
+	const auto tempDir = std::filesystem::temp_directory_path() / "bufferstream_bench";
+	std::filesystem::create_directories(tempDir);
+
+	PerfCounters counters;
+	std::vector<Harness::Result> results;
+	const auto run = [&](const Workloads::Workload& workload, std::string backend, std::string floor, const std::function<std::uint64_t()>& fn) {
+		const auto measurement = Harness::measure(fn, &counters);
+		results.push_back({workload.name, std::move(backend), std::move(floor), workload.data.size(), workload.records, measurement.nanoseconds, measurement.counters});
+	};
+	for (auto kind : Workloads::ALL_KINDS) {
+		const auto workload = Workloads::generate(kind, SEED, size);
+		const auto bytes = workload.data.size();
+		const auto path = (tempDir / (workload.name + ".bin")).string();
+		{
+			std::ofstream out{path, std::ios::binary | std::ios::trunc};
+			out.write(reinterpret_cast<const char*>(workload.data.data()), static_cast<std::streamsize>(bytes));
+		}
+
+		std::vector<std::byte> copy(bytes);
+		run(workload, "memcpy", "memcpy", [&] {
+			std::memcpy(copy.data(), workload.data.data(), bytes);
+			return static_cast<std::uint64_t>(copy[bytes / 2]);
+		});
+
+		BufferStreamReadOnly bufferStream{workload.data.data(), bytes};
+		run(workload, "BufferStream", "memcpy", [&] {
+			bufferStream.seek(0);
+			BufferStreamReader reader{bufferStream};
+			return Workloads::parse(kind, reader);
+		});
+
+		if (std::FILE* file = std::fopen(path.c_str(), "rb")) {
+			run(workload, "fread", "fread", [&] {
+				std::fseek(file, 0, SEEK_SET);
+				FreadReader reader{file};
+				return Workloads::parse(kind, reader);
+			});
+			std::fclose(file);
+		} else {
+			std::printf("Couldn't open %s for fread, skipping\n", path.c_str());
+		}
+
+		if (std::ifstream ifstream{path, std::ios::binary}) {
+			run(workload, "std::ifstream", "fread", [&] {
+				ifstream.clear();
+				ifstream.seekg(0);
+				IfstreamReader reader{ifstream};
+				return Workloads::parse(kind, reader);
+			});
+		} else {
+			std::printf("Couldn't open %s for std::ifstream, skipping\n", path.c_str());
+		}
+
+		if (FileStream fileStream{path}) {
+			run(workload, "FileStream", "fread", [&] {
+				fileStream.seek_in(0);
+				FileStreamReader reader{fileStream};
+				return Workloads::parse(kind, reader);
+			});
+		} else {
+			std::printf("Couldn't open %s for FileStream, skipping\n", path.c_str());
+		}
+	}
+
+	Harness::print(results);
+	std::filesystem::remove_all(tempDir);
+	return 0;
+}
@@ -0,0 +1,120 @@
+// Cold page cache reads of a large local file through FileStream, with and without access pattern hints.
+// Usage: bufferstream_bench_cold_cache [directory on a real disk] [file size in MiB]
+// The directory should not be on a tmpfs, since dropping its pages from the page cache does nothing.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <FileStream.h>
+
+#include "Workloads.h"
+
+#if defined(BUFFERSTREAM_HAS_POSIX_IO) && defined(POSIX_FADV_DONTNEED)
+
+namespace {
+
+void drop_page_cache(const std::string& path) {
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		::fdatasync(fd);
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		::close(fd);
+	}
+}
+
+double time_cold_ms(const std::string& path, const std::function<void()>& fn) {
+	std::vector<double> times;
+	for (int i = 0; i < 3; i++) {
+		drop_page_cache(path);
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		times.push_back(elapsed.count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[1];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const std::filesystem::path directory = argc > 1 ? argv[1] : std::filesystem::current_path().string();
+	const std::uint64_t size = (argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256) * 1024 * 1024;
+	const auto path = (directory / "bufferstream_cold_cache.bin").string();
+	{
+		FileStream out{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		std::vector<std::byte> chunk(1024 * 1024);
+		Workloads::Random random{1};
+		for (auto& byte : chunk) {
+			byte = static_cast<std::byte>(random.next());
+		}
+		for (std::uint64_t written = 0; written < size; written += chunk.size()) {
+			out.write(chunk);
+		}
+	}
+
+	struct Scenario {
+		const char* name;
+		std::function<std::uint64_t(FileStream&)> run;
+	};
+	const Scenario scenarios[] = {
+		{"sequential 4 KiB reads", [size](FileStream& stream) {
+			std::uint64_t sum = 0;
+			std::vector<std::byte> buffer(4096);
+			for (std::uint64_t pos = 0; pos + buffer.size() <= size; pos += buffer.size()) {
+				stream.read(buffer.data(), buffer.size());
+				sum += static_cast<std::uint64_t>(buffer[0]);
+			}
+			return sum;
+		}},
+		{"strided 64 B every 256 KiB", [size](FileStream& stream) {
+			std::uint64_t sum = 0;
+			for (std::uint64_t pos = 0; pos + 64 <= size; pos += 256 * 1024) {
+				sum += stream.seek_in_u(pos).read<std::uint64_t>();
+			}
+			return sum;
+		}},
+		{"random 64 B reads", [size](FileStream& stream) {
+			std::uint64_t sum = 0;
+			Workloads::Random random{2};
+			for (std::uint64_t i = 0; i < size / (256 * 1024); i++) {
+				sum += stream.seek_in_u(random.next(size - 64)).read<std::uint64_t>();
+			}
+			return sum;
+		}},
+	};
+
+	std::printf("%-28s %14s %14s %10s\n", "scenario", "HINT_NONE ms", "HINT_AUTO ms", "speedup");
+	for (const auto& scenario : scenarios) {
+		volatile std::uint64_t sink = 0;
+		const auto none = time_cold_ms(path, [&] {
+			FileStream stream{path};
+			stream.set_access_hint(FileStream::HINT_NONE);
+			sink = sink + scenario.run(stream);
+		});
+		const auto automatic = time_cold_ms(path, [&] {
+			FileStream stream{path};
+			stream.set_access_hint(FileStream::HINT_AUTO);
+			sink = sink + scenario.run(stream);
+		});
+		std::printf("%-28s %14.1f %14.1f %9.2fx\n", scenario.name, none, automatic, none / automatic);
+	}
+
+	std::filesystem::remove(path);
+	return 0;
+}
+
+#else
+
+int main() {
+	std::printf("Cold cache benchmark needs posix_fadvise, skipping\n");
+	return 0;
+}
+
+#endif
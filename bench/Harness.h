@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
+
+/// Minimal benchmark harness: no dependencies, so it runs anywhere the tests do.
+namespace Harness {
+
+struct Result {
+	std::string workload;
+	std::string backend;
+	std::string floor;  // Backend this one is compared against
+	std::uint64_t bytes;      // Bytes processed per iteration
+	std::uint64_t operations; // Logical operations (records, fields, calls) per iteration
+	double nanoseconds;       // Median time of one iteration
+	PerfCounters::Values counters; // Mean counts per iteration, -1 when unavailable
+};
+
+struct Measurement {
+	double nanoseconds;
+	PerfCounters::Values counters;
+};
+
+/// Runs the function in batches until minSeconds have elapsed, and reports the median batch time per iteration.
+/// If counters are given they are collected over all the timed batches and averaged per iteration.
+inline Measurement measure(const std::function<std::uint64_t()>& fn, PerfCounters* counters = nullptr, double minSeconds = 0.25, int samples = 9) {
+	using Clock = std::chrono::steady_clock;
+	volatile std::uint64_t sink = 0;
+
+	// Calibrate the batch size so one batch takes roughly minSeconds / samples
+	std::uint64_t batch = 1;
+	for (;;) {
+		const auto start = Clock::now();
+		for (std::uint64_t i = 0; i < batch; i++) {
+			sink = sink + fn();
+		}
+		const std::chrono::duration<double> elapsed = Clock::now() - start;
+		if (elapsed.count() >= minSeconds / samples || batch >= (std::uint64_t{1} << 30)) {
+			break;
+		}
+		batch *= 2;
+	}
+
+	if (counters) {
+		counters->start();
+	}
+	std::vector<double> times;
+	for (int s = 0; s < samples; s++) {
+		const auto start = Clock::now();
+		for (std::uint64_t i = 0; i < batch; i++) {
+			sink = sink + fn();
+		}
+		const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+		times.push_back(elapsed.count() / static_cast<double>(batch));
+	}
+	Measurement out{};
+	out.counters.fill(-1.0);
+	if (counters) {
+		out.counters = counters->stop();
+		for (auto& value : out.counters) {
+			if (value >= 0.0) {
+				value /= static_cast<double>(batch) * samples;
+			}
+		}
+	}
+	std::sort(times.begin(), times.end());
+	out.nanoseconds = times[times.size() / 2];
+	return out;
+}
+
+/// Prints every result, with its time relative to the result of its floor backend on the same workload.
+inline void print(const std::vector<Result>& results) {
+	std::printf("%-20s %-14s %12s %10s %10s\n", "workload", "backend", "ns/iter", "MB/s", "vs floor");
+	for (const auto& result : results) {
+		double floor = 0.0;
+		for (const auto& other : results) {
+			if (other.workload == result.workload && other.backend == result.floor) {
+				floor = other.nanoseconds;
+			}
+		}
+		std::printf("%-20s %-14s %12.0f %10.1f %9.2fx\n",
+				result.workload.c_str(),
+				result.backend.c_str(),
+				result.nanoseconds,
+				static_cast<double>(result.bytes) / result.nanoseconds * 1e3,
+				floor > 0.0 ? result.nanoseconds / floor : 0.0);
+	}
+
+	bool anyCounters = false;
+	for (const auto& result : results) {
+		for (auto value : result.counters) {
+			anyCounters |= value >= 0.0;
+		}
+	}
+	if (!anyCounters) {
+		std::printf("\nHardware counters unavailable (not Linux, or perf_event_open not permitted: check kernel.perf_event_paranoid)\n");
+		return;
+	}
+
+	// Ratios are printed as "-" when the counter couldn't be opened
+	const auto ratio = [](double value, double divisor, const char* format) {
+		static char text[32];
+		if (value < 0.0 || divisor <= 0.0) {
+			return "-";
+		}
+		std::snprintf(text, sizeof(text), format, value / divisor);
+		return static_cast<const char*>(text);
+	};
+	std::printf("\n%-20s %-14s %10s %10s %8s %12s %12s %12s %12s\n", "workload", "backend", "ins/byte", "cyc/byte", "IPC", "br-miss/op", "L1D-miss/op", "LLC-miss/op", "dTLB-miss/op");
+	for (const auto& result : results) {
+		const auto& c = result.counters;
+		const auto bytes = static_cast<double>(result.bytes);
+		const auto ops = static_cast<double>(result.operations);
+		std::printf("%-20s %-14s", result.workload.c_str(), result.backend.c_str());
+		std::printf(" %10s", ratio(c[PerfCounters::INSTRUCTIONS], bytes, "%.2f"));
+		std::printf(" %10s", ratio(c[PerfCounters::CYCLES], bytes, "%.2f"));
+		std::printf(" %8s", ratio(c[PerfCounters::INSTRUCTIONS], c[PerfCounters::CYCLES], "%.2f"));
+		std::printf(" %12s", ratio(c[PerfCounters::BRANCH_MISSES], ops, "%.4f"));
+		std::printf(" %12s", ratio(c[PerfCounters::L1D_MISSES], ops, "%.4f"));
+		std::printf(" %12s", ratio(c[PerfCounters::LLC_MISSES], ops, "%.4f"));
+		std::printf(" %12s\n", ratio(c[PerfCounters::DTLB_MISSES], ops, "%.4f"));
+	}
+}
+
+} // namespace Harness
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// Hardware performance counters around a region of code, through perf_event_open on Linux.
+/// Each counter is opened on its own so the kernel can multiplex them, and counts are scaled by
+/// the fraction of time each counter was actually scheduled. Counters that can't be opened (no
+/// permission, unsupported event, virtualized hardware, non-Linux platform) report as unavailable.
+class PerfCounters {
+public:
+	enum Counter {
+		INSTRUCTIONS,
+		CYCLES,
+		BRANCH_MISSES,
+		L1D_MISSES,
+		LLC_MISSES,
+		DTLB_MISSES,
+		COUNTER_COUNT,
+	};
+
+	static constexpr std::array<std::string_view, COUNTER_COUNT> NAMES{
+		"instructions", "cycles", "branch-misses", "L1D-misses", "LLC-misses", "dTLB-misses",
+	};
+
+	using Values = std::array<double, COUNTER_COUNT>;
+
+	PerfCounters() {
+		this->fds.fill(-1);
+#if defined(__linux__)
+		static constexpr auto cache = [](std::uint64_t cacheId, std::uint64_t op, std::uint64_t result) {
+			return cacheId | (op << 8) | (result << 16);
+		};
+		const std::array<std::pair<std::uint32_t, std::uint64_t>, COUNTER_COUNT> events{{
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+			{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+			{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+		}};
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			perf_event_attr attr{};
+			attr.size = sizeof(attr);
+			attr.type = events[i].first;
+			attr.config = events[i].second;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			this->fds[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		}
+#endif
+	}
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	~PerfCounters() {
+#if defined(__linux__)
+		for (int fd : this->fds) {
+			if (fd >= 0) {
+				::close(fd);
+			}
+		}
+#endif
+	}
+
+	[[nodiscard]] bool is_available(Counter counter) const {
+		return this->fds[counter] >= 0;
+	}
+
+	[[nodiscard]] bool is_any_available() const {
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			if (this->is_available(static_cast<Counter>(i))) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void start() {
+#if defined(__linux__)
+		for (int fd : this->fds) {
+			if (fd >= 0) {
+				::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+	}
+
+	/// Stops counting and returns the scaled counts since start(), or -1 for unavailable counters.
+	Values stop() {
+		Values out;
+		out.fill(-1.0);
+#if defined(__linux__)
+		for (int fd : this->fds) {
+			if (fd >= 0) {
+				::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			std::uint64_t data[3]{};
+			if (this->fds[i] < 0 || ::read(this->fds[i], data, sizeof(data)) != sizeof(data) || !data[2]) {
+				continue;
+			}
+			out[i] = static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+		}
+#endif
+		return out;
+	}
+
+private:
+	std::array<int, COUNTER_COUNT> fds{};
+};
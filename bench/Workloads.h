@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <BufferStream.h>
+
+/// Deterministic synthetic workloads shaped like the files BufferStream is typically used to parse.
+/// Every generator is seeded, so the same seed always produces the same bytes on every platform.
+namespace Workloads {
+
+/// splitmix64, small and good enough for generating test data.
+class Random {
+public:
+	explicit Random(std::uint64_t seed_)
+			: state(seed_) {}
+
+	std::uint64_t next() {
+		std::uint64_t z = (this->state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	std::uint64_t next(std::uint64_t bound) {
+		return this->next() % bound;
+	}
+
+	float next_float() {
+		return static_cast<float>(this->next() >> 40) / static_cast<float>(1 << 24);
+	}
+
+	std::string next_name(std::uint64_t minLen, std::uint64_t maxLen) {
+		static constexpr std::string_view CHARS = "abcdefghijklmnopqrstuvwxyz0123456789_/";
+		std::string out(minLen + this->next(maxLen - minLen + 1), '\0');
+		for (auto& c : out) {
+			c = CHARS[this->next(CHARS.size())];
+		}
+		return out;
+	}
+
+private:
+	std::uint64_t state;
+};
+
+struct Workload {
+	std::string name;
+	std::vector<std::byte> data;
+	std::uint64_t records = 0; // Vertices + indices, strings, entries or varint fields
+};
+
+enum class Kind {
+	MESH,
+	STRING_TABLE,
+	ARCHIVE_DIRECTORY,
+	VARINT_MESSAGES,
+};
+
+inline constexpr Kind ALL_KINDS[] = {Kind::MESH, Kind::STRING_TABLE, Kind::ARCHIVE_DIRECTORY, Kind::VARINT_MESSAGES};
+
+/// u32 vertex count, u32 index count, then vertices (position, normal, uv as floats) and u32 indices.
+inline Workload mesh(std::uint64_t seed, std::uint32_t vertexCount) {
+	Random random{seed};
+	Workload out{"mesh", {}};
+	BufferStream stream{out.data};
+
+	const std::uint32_t indexCount = vertexCount * 3;
+	stream << vertexCount << indexCount;
+	for (std::uint32_t i = 0; i < vertexCount * 8; i++) {
+		stream << random.next_float();
+	}
+	for (std::uint32_t i = 0; i < indexCount; i++) {
+		stream << static_cast<std::uint32_t>(random.next(vertexCount));
+	}
+	out.data.resize(stream.size());
+	out.records = vertexCount + indexCount;
+	return out;
+}
+
+/// u32 string count, then that many null-terminated strings.
+inline Workload string_table(std::uint64_t seed, std::uint32_t stringCount) {
+	Random random{seed};
+	Workload out{"string_table", {}};
+	BufferStream stream{out.data};
+
+	stream << stringCount;
+	for (std::uint32_t i = 0; i < stringCount; i++) {
+		stream << random.next_name(4, 48);
+	}
+	out.data.resize(stream.size());
+	out.records = stringCount;
+	return out;
+}
+
+/// u32 entry count, then entries of (path string, u32 crc, u16 preload size, u16 archive index, u32 offset, u32 length).
+inline Workload archive_directory(std::uint64_t seed, std::uint32_t entryCount) {
+	Random random{seed};
+	Workload out{"archive_directory", {}};
+	BufferStream stream{out.data};
+
+	stream << entryCount;
+	for (std::uint32_t i = 0; i < entryCount; i++) {
+		stream << random.next_name(12, 96);
+		stream
+			<< static_cast<std::uint32_t>(random.next())
+			<< static_cast<std::uint16_t>(random.next(64))
+			<< static_cast<std::uint16_t>(random.next(32))
+			<< static_cast<std::uint32_t>(random.next())
+			<< static_cast<std::uint32_t>(random.next(1 << 20));
+	}
+	out.data.resize(stream.size());
+	out.records = entryCount;
+	return out;
+}
+
+/// u32 message count, then messages of (u8 field count, that many LEB128 varints).
+/// Field magnitudes are skewed towards small values, like most real protocol fields.
+inline Workload varint_messages(std::uint64_t seed, std::uint32_t messageCount) {
+	Random random{seed};
+	Workload out{"varint_messages", {}};
+	BufferStream stream{out.data};
+
+	stream << messageCount;
+	for (std::uint32_t i = 0; i < messageCount; i++) {
+		const auto fieldCount = static_cast<std::uint8_t>(1 + random.next(16));
+		stream << fieldCount;
+		out.records += fieldCount;
+		for (std::uint8_t j = 0; j < fieldCount; j++) {
+			std::uint64_t value = random.next() >> (random.next(8) * 8);
+			while (value >= 0x80) {
+				stream << static_cast<std::uint8_t>(value | 0x80);
+				value >>= 7;
+			}
+			stream << static_cast<std::uint8_t>(value);
+		}
+	}
+	out.data.resize(stream.size());
+	return out;
+}
+
+/// Generates a workload of roughly the given size in bytes.
+inline Workload generate(Kind kind, std::uint64_t seed, std::uint64_t approximateSize) {
+	switch (kind) {
+		case Kind::MESH:
+			return mesh(seed, static_cast<std::uint32_t>(approximateSize / (8 * sizeof(float) + 3 * sizeof(std::uint32_t))));
+		case Kind::STRING_TABLE:
+			return string_table(seed, static_cast<std::uint32_t>(approximateSize / 27));
+		case Kind::ARCHIVE_DIRECTORY:
+			return archive_directory(seed, static_cast<std::uint32_t>(approximateSize / 71));
+		case Kind::VARINT_MESSAGES:
+			return varint_messages(seed, static_cast<std::uint32_t>(approximateSize / 40));
+	}
+	return {};
+}
+
+/// Parses a workload through any reader exposing get<T>(), get(T*, n) and get_string().
+/// Returns a checksum of everything parsed so the compiler can't throw the work away.
+template<typename Reader>
+std::uint64_t parse(Kind kind, Reader& reader) {
+	std::uint64_t checksum = 0;
+	switch (kind) {
+		case Kind::MESH: {
+			const auto vertexCount = reader.template get<std::uint32_t>();
+			const auto indexCount = reader.template get<std::uint32_t>();
+			std::vector<float> vertices(static_cast<std::uint64_t>(vertexCount) * 8);
+			std::vector<std::uint32_t> indices(indexCount);
+			reader.get(vertices.data(), vertices.size());
+			reader.get(indices.data(), indices.size());
+			for (std::uint64_t i = 0; i < indices.size(); i += 64) {
+				checksum += indices[i];
+			}
+			checksum += vertices.size() + static_cast<std::uint64_t>(vertices.empty() ? 0.f : vertices.back() * 1000.f);
+			break;
+		}
+		case Kind::STRING_TABLE: {
+			const auto stringCount = reader.template get<std::uint32_t>();
+			for (std::uint32_t i = 0; i < stringCount; i++) {
+				checksum += reader.get_string().size();
+			}
+			break;
+		}
+		case Kind::ARCHIVE_DIRECTORY: {
+			const auto entryCount = reader.template get<std::uint32_t>();
+			for (std::uint32_t i = 0; i < entryCount; i++) {
+				checksum += reader.get_string().size();
+				checksum += reader.template get<std::uint32_t>();
+				checksum += reader.template get<std::uint16_t>();
+				checksum += reader.template get<std::uint16_t>();
+				checksum += reader.template get<std::uint32_t>();
+				checksum += reader.template get<std::uint32_t>();
+			}
+			break;
+		}
+		case Kind::VARINT_MESSAGES: {
+			const auto messageCount = reader.template get<std::uint32_t>();
+			for (std::uint32_t i = 0; i < messageCount; i++) {
+				const auto fieldCount = reader.template get<std::uint8_t>();
+				for (std::uint8_t j = 0; j < fieldCount; j++) {
+					std::uint64_t value = 0;
+					for (int shift = 0;; shift += 7) {
+						const auto byte = reader.template get<std::uint8_t>();
+						value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+						if (!(byte & 0x80)) {
+							break;
+						}
+					}
+					checksum ^= value;
+				}
+			}
+			break;
+		}
+	}
+	return checksum;
+}
+
+} // namespace Workloads
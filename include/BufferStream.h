@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <bit>
 #include <concepts>
@@ -7,6 +8,7 @@
 #include <cstring>
 #include <functional>
 #include <ios>
+#include <memory_resource>
 #include <span>
 #include <stdexcept>
 #include <string>
@@ -15,6 +17,8 @@
 #include <utility>
 #include <vector>
 
+#include "BufferStreamDispatch.h"
+
 /// Only POD types are directly readable from the stream.
 template<typename T>
 concept BufferStreamPODType = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>;
@@ -60,11 +64,201 @@ concept BufferStreamPossiblyNonContiguousResizableContainer = BufferStreamPossib
 constexpr auto BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE = "Attempted to read value out of buffer bounds!";
 constexpr auto BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE = "Attempted to write value out of buffer bounds!";
 constexpr auto BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE = "Cannot change endianness of complex types!";
+constexpr auto BUFFERSTREAM_STRIDED_DESTINATION_ERROR_MESSAGE = "Destination is too small for the strided region!";
+
+/// The shape of an N-dimensional region of elements inside a stream, like std::layout_stride.
+/// Extents are the number of elements in each dimension, strides the distance in elements
+/// between neighbouring elements of each dimension. The last dimension varies fastest.
+template<std::uint64_t Rank>
+struct BufferStreamStridedLayout {
+	static_assert(Rank > 0, "A strided layout needs at least one dimension!");
+
+	std::array<std::uint64_t, Rank> extents;
+	std::array<std::uint64_t, Rank> strides;
+
+	/// The number of elements in the region, or UINT64_MAX if that doesn't fit in 64 bits.
+	[[nodiscard]] constexpr std::uint64_t size() const {
+		std::uint64_t size = 1;
+		for (std::uint64_t extent : this->extents) {
+			if (!extent) {
+				return 0;
+			}
+			if (size > UINT64_MAX / extent) {
+				size = UINT64_MAX;
+			} else {
+				size *= extent;
+			}
+		}
+		return size;
+	}
+
+	/// The number of elements between the first and the last element of the region, inclusive,
+	/// or UINT64_MAX if that doesn't fit in 64 bits.
+	[[nodiscard]] constexpr std::uint64_t required_span_size() const {
+		if (!this->size()) {
+			return 0;
+		}
+		std::uint64_t span = 1;
+		for (std::uint64_t d = 0; d < Rank; d++) {
+			const std::uint64_t last = this->extents[d] - 1;
+			if (this->strides[d] && last > (UINT64_MAX - span) / this->strides[d]) {
+				return UINT64_MAX;
+			}
+			span += last * this->strides[d];
+		}
+		return span;
+	}
+
+	/// True if the region is too large to address: its element count or span doesn't fit in 64 bits,
+	/// or its span in bytes of elements of elementSize doesn't.
+	[[nodiscard]] constexpr bool overflows(std::uint64_t elementSize) const {
+		const std::uint64_t span = this->required_span_size();
+		return this->size() == UINT64_MAX || span == UINT64_MAX || (elementSize && span > UINT64_MAX / elementSize);
+	}
+
+	/// Calls fn(sourceOffset, destinationOffset, count) for every run of elements that is contiguous
+	/// in the source, in order. Trailing dimensions that are laid out back to back are merged into one run.
+	template<typename F>
+	constexpr void for_each_run(F&& fn) const {
+		if (!this->size()) {
+			return;
+		}
+
+		std::uint64_t run = 1;
+		std::uint64_t outer = Rank;
+		while (outer > 0 && (this->extents[outer - 1] == 1 || this->strides[outer - 1] == run)) {
+			run *= this->extents[outer - 1];
+			outer--;
+		}
+
+		std::array<std::uint64_t, Rank> index{};
+		std::uint64_t source = 0;
+		for (std::uint64_t destination = 0;; destination += run) {
+			fn(source, destination, run);
+
+			// Step the outer dimensions like an odometer
+			std::uint64_t d = outer;
+			for (; d > 0; d--) {
+				source += this->strides[d - 1];
+				if (++index[d - 1] < this->extents[d - 1]) {
+					break;
+				}
+				source -= this->strides[d - 1] * this->extents[d - 1];
+				index[d - 1] = 0;
+			}
+			if (d == 0) {
+				return;
+			}
+		}
+	}
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BUFFERSTREAM_NOINLINE [[gnu::noinline]]
+#define BUFFERSTREAM_COLD [[gnu::cold, gnu::noinline]]
+#define BUFFERSTREAM_ALWAYS_INLINE [[gnu::always_inline]] inline
+#elif defined(_MSC_VER)
+#define BUFFERSTREAM_NOINLINE __declspec(noinline)
+#define BUFFERSTREAM_COLD __declspec(noinline)
+#define BUFFERSTREAM_ALWAYS_INLINE __forceinline
+#else
+#define BUFFERSTREAM_NOINLINE
+#define BUFFERSTREAM_COLD
+#define BUFFERSTREAM_ALWAYS_INLINE inline
+#endif
+
+/// Out of line throw sites, so a bounds check inlines to a compare and a branch to a cold call.
+struct BufferStreamThrow {
+	[[noreturn]] BUFFERSTREAM_COLD static void overflow_read() {
+		throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
+	}
+
+	[[noreturn]] BUFFERSTREAM_COLD static void overflow_write() {
+		throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
+	}
+
+	[[noreturn]] BUFFERSTREAM_COLD static void big_endian_pod_type() {
+		throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
+	}
+
+	[[noreturn]] BUFFERSTREAM_COLD static void invalid_argument(const char* message) {
+		throw std::invalid_argument{message};
+	}
+};
+
+/// A string of at most N chars stored inline, so short strings can be read without allocating.
+/// Always null terminated, and converts to std::string_view.
+template<std::uint64_t N>
+class BufferStreamFixedString {
+public:
+	constexpr BufferStreamFixedString() = default;
+
+	/// Copies the string, cut short at N chars.
+	constexpr explicit BufferStreamFixedString(std::string_view str)
+			: length(std::min<std::uint64_t>(str.size(), N)) {
+		std::copy_n(str.data(), this->length, this->storage.data());
+	}
+
+	[[nodiscard]] constexpr const char* data() const {
+		return this->storage.data();
+	}
+
+	[[nodiscard]] constexpr const char* c_str() const {
+		return this->storage.data();
+	}
+
+	[[nodiscard]] constexpr std::uint64_t size() const {
+		return this->length;
+	}
+
+	[[nodiscard]] constexpr bool empty() const {
+		return !this->length;
+	}
+
+	[[nodiscard]] static constexpr std::uint64_t capacity() {
+		return N;
+	}
+
+	[[nodiscard]] constexpr char operator[](std::uint64_t index) const {
+		return this->storage[index];
+	}
+
+	[[nodiscard]] constexpr const char* begin() const {
+		return this->storage.data();
+	}
+
+	[[nodiscard]] constexpr const char* end() const {
+		return this->storage.data() + this->length;
+	}
+
+	[[nodiscard]] constexpr std::string_view view() const {
+		return {this->storage.data(), this->length};
+	}
+
+	[[nodiscard]] constexpr operator std::string_view() const { // NOLINT(*-explicit-constructor)
+		return this->view();
+	}
+
+	[[nodiscard]] constexpr bool operator==(const BufferStreamFixedString& other) const {
+		return this->view() == other.view();
+	}
+
+	[[nodiscard]] constexpr bool operator==(std::string_view other) const {
+		return this->view() == other;
+	}
+
+private:
+	std::array<char, N + 1> storage{};
+	std::uint64_t length = 0;
+};
 
 class BufferStream {
 public:
 	using ResizeCallback = std::function<std::byte*(BufferStream* stream, std::uint64_t newLen)>;
 
+	/// Byte swaps shorter than this are done inline, longer ones call the SIMD kernel for this CPU.
+	static constexpr std::uint64_t SWAP_ENDIAN_DISPATCH_THRESHOLD = 64;
+
 	template<BufferStreamPODType T>
 	BufferStream(T* buffer, std::uint64_t bufferLen_, ResizeCallback resizeCallback = nullptr)
 			: buffer(reinterpret_cast<std::byte*>(buffer))
@@ -76,19 +270,19 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t N>
 	explicit BufferStream(T(&buffer)[N])
-			: BufferStream(buffer, sizeof(T) * N) {}
+			: BufferStream(buffer, N) {}
 
 	template<BufferStreamPODType T, std::uint64_t M, std::uint64_t N>
 	explicit BufferStream(T(&buffer)[M][N])
-			: BufferStream(buffer, sizeof(T) * M * N) {}
+			: BufferStream(&buffer[0][0], M * N) {}
 
 	template<BufferStreamNonResizableContiguousContainer T>
 	explicit BufferStream(T& buffer)
-			: BufferStream(buffer.data(), buffer.size() * sizeof(typename T::value_type)) {}
+			: BufferStream(buffer.data(), buffer.size()) {}
 
 	template<BufferStreamResizableContiguousContainer T>
 	explicit BufferStream(T& buffer, bool resizable = true)
-			: BufferStream(buffer.data(), buffer.size() * sizeof(typename T::value_type), resizable ? [&buffer](BufferStream*, std::uint64_t newLen) {
+			: BufferStream(buffer.data(), buffer.size(), resizable ? [&buffer](BufferStream*, std::uint64_t newLen) {
 				auto curSize = buffer.size();
 				while (curSize * sizeof(typename T::value_type) < newLen) {
 					if (!curSize) {
@@ -123,19 +317,19 @@ public:
 		switch (offsetFrom) {
 			case std::ios::beg:
 				if (this->useExceptions && (std::cmp_greater(offset, this->bufferLen) || offset < 0)) {
-					throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
+					BufferStreamThrow::overflow_read();
 				}
 				this->bufferPos = offset;
 				break;
 			case std::ios::cur:
-				if (this->useExceptions && (std::cmp_greater(this->bufferPos + offset, this->bufferLen) || this->bufferPos + offset < 0)) {
-					throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
+				if (this->useExceptions && !this->fits_offset(offset)) {
+					BufferStreamThrow::overflow_read();
 				}
 				this->bufferPos += offset;
 				break;
 			case std::ios::end:
 				if (this->useExceptions && (std::cmp_greater(offset, this->bufferLen) || offset < 0)) {
-					throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
+					BufferStreamThrow::overflow_read();
 				}
 				this->bufferPos = this->bufferLen - offset;
 				break;
@@ -151,15 +345,24 @@ public:
 
 	template<BufferStreamPODType T = std::byte>
 	BufferStream& skip(std::int64_t n = 1) {
-		if (!n) {
-			return *this;
+		if (n >= 0) {
+			return this->skip_u<T>(static_cast<std::uint64_t>(n));
 		}
-		return this->seek(sizeof(T) * n, std::ios::cur);
+		// Negated without overflowing, even for INT64_MIN
+		const std::uint64_t back = static_cast<std::uint64_t>(-(n + 1)) + 1;
+		if (this->useExceptions && back > this->bufferPos / sizeof(T)) {
+			BufferStreamThrow::overflow_read();
+		}
+		this->bufferPos -= sizeof(T) * back;
+		return *this;
 	}
 
+	/// Element counts are checked before they're scaled to bytes, so huge counts can't wrap around.
 	template<BufferStreamPODType T = std::byte>
 	BufferStream& skip_u(std::uint64_t n = 1) {
-		return this->skip(static_cast<std::int64_t>(n));
+		this->check_read(n, sizeof(T));
+		this->bufferPos += sizeof(T) * n;
+		return *this;
 	}
 
 	[[nodiscard]] const std::byte* data() const {
@@ -170,6 +373,15 @@ public:
 		return this->buffer;
 	}
 
+	/// The size bytes of the buffer at the given offset, whatever the stream's position.
+	/// A range past the end of the buffer is an overflow, whether or not exceptions are enabled.
+	[[nodiscard]] std::span<const std::byte> bytes(std::uint64_t offset, std::uint64_t size) const {
+		if (offset > this->bufferLen || size > this->bufferLen - offset) {
+			BufferStreamThrow::overflow_read();
+		}
+		return {this->buffer + offset, size};
+	}
+
 	[[nodiscard]] std::uint64_t tell() const {
 		return this->bufferPos;
 	}
@@ -180,44 +392,7 @@ public:
 
 	template<BufferStreamPODType T>
 	BufferStream& read(T& obj) {
-		if (this->useExceptions && this->bufferPos + sizeof(T) > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
-
-		std::memcpy(&obj, this->buffer + this->bufferPos, sizeof(T));
-		if constexpr (sizeof(T) > 1) {
-			if constexpr (std::endian::native == std::endian::little) {
-				if (this->bigEndian) {
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						swap_endian(&obj);
-					} else if constexpr (std::is_enum_v<T>) {
-						swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&obj));
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-				}
-			} else if constexpr (std::endian::native == std::endian::big) {
-				if (!this->bigEndian) {
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						swap_endian(&obj);
-					} else if constexpr (std::is_enum_v<T>) {
-						swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&obj));
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-				}
-			} else {
-				static_assert("Need to investigate what the proper endianness of this platform is!");
-			}
-		}
-		this->bufferPos += sizeof(T);
-
+		this->read_elements(&obj, 1);
 		return *this;
 	}
 
@@ -228,44 +403,7 @@ public:
 
 	template<BufferStreamPODType T>
 	BufferStream& write(const T& obj) {
-		if (this->bufferPos + sizeof(T) > this->bufferLen && !this->resize_buffer(this->bufferPos + sizeof(T)) && this->useExceptions) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
-		}
-
-		std::memcpy(this->buffer + this->bufferPos, &obj, sizeof(T));
-		if constexpr (sizeof(T) > 1) {
-			if constexpr (std::endian::native == std::endian::little) {
-				if (this->bigEndian) {
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						swap_endian(reinterpret_cast<T*>(this->buffer + this->bufferPos));
-					} else if constexpr (std::is_enum_v<T>) {
-						swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(this->buffer + this->bufferPos));
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-				}
-			} else if constexpr (std::endian::native == std::endian::big) {
-				if (!this->bigEndian) {
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						swap_endian(reinterpret_cast<T*>(this->buffer + this->bufferPos));
-					} else if constexpr (std::is_enum_v<T>) {
-						swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(this->buffer + this->bufferPos));
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-				}
-			} else {
-				static_assert("Need to investigate what the proper endianness of this platform is!");
-			}
-		}
-		this->bufferPos += sizeof(T);
-
+		this->write_elements(&obj, 1);
 		return *this;
 	}
 
@@ -276,18 +414,7 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t N>
 	BufferStream& read(T(&obj)[N]) {
-		if (this->useExceptions && this->bufferPos + sizeof(T) * N > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
-
-		if constexpr (BufferStreamPODByteType<T>) {
-			std::memcpy(obj, this->buffer + this->bufferPos, N);
-			this->bufferPos += N;
-		} else {
-			for (int i = 0; i < N; i++) {
-				this->read(obj[i]);
-			}
-		}
+		this->read_elements(obj, N);
 		return *this;
 	}
 
@@ -298,18 +425,7 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t N>
 	BufferStream& write(const T(&obj)[N]) {
-		if (this->bufferPos + sizeof(T) * N > this->bufferLen && !this->resize_buffer(this->bufferPos + sizeof(T) * N) && this->useExceptions) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
-		}
-
-		if constexpr (BufferStreamPODByteType<T>) {
-			std::memcpy(this->buffer + this->bufferPos, obj, N);
-			this->bufferPos += N;
-		} else {
-			for (int i = 0; i < N; i++) {
-				this->write(obj[i]);
-			}
-		}
+		this->write_elements(obj, N);
 		return *this;
 	}
 
@@ -320,15 +436,7 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t M, std::uint64_t N>
 	BufferStream& read(T(&obj)[M][N]) {
-		if (this->useExceptions && this->bufferPos + sizeof(T) * M * N > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
-
-		for (int i = 0; i < M; i++) {
-			for (int j = 0; j < N; j++) {
-				this->read(obj[i][j]);
-			}
-		}
+		this->read_elements(&obj[0][0], M * N);
 		return *this;
 	}
 
@@ -339,15 +447,7 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t M, std::uint64_t N>
 	BufferStream& write(const T(&obj)[M][N]) {
-		if (this->bufferPos + sizeof(T) * M * N > this->bufferLen && !this->resize_buffer(this->bufferPos + sizeof(T) * M * N) && this->useExceptions) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
-		}
-
-		for (int i = 0; i < M; i++) {
-			for (int j = 0; j < N; j++) {
-				this->write(obj[i][j]);
-			}
-		}
+		this->write_elements(&obj[0][0], M * N);
 		return *this;
 	}
 
@@ -358,18 +458,7 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t N>
 	BufferStream& read(std::array<T, N>& obj) {
-		if (this->useExceptions && this->bufferPos + sizeof(T) * N > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
-
-		if constexpr (BufferStreamPODByteType<T>) {
-			std::memcpy(obj.data(), this->buffer + this->bufferPos, N);
-			this->bufferPos += N;
-		} else {
-			for (int i = 0; i < N; i++) {
-				this->read(obj[i]);
-			}
-		}
+		this->read_elements(obj.data(), N);
 		return *this;
 	}
 
@@ -380,18 +469,7 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t N>
 	BufferStream& write(const std::array<T, N>& obj) {
-		if (this->bufferPos + sizeof(T) * N > this->bufferLen && !this->resize_buffer(this->bufferPos + sizeof(T) * N) && this->useExceptions) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
-		}
-
-		if constexpr (BufferStreamPODByteType<T>) {
-			std::memcpy(this->buffer + this->bufferPos, obj.data(), N);
-			this->bufferPos += N;
-		} else {
-			for (int i = 0; i < N; i++) {
-				this->write(obj[i]);
-			}
-		}
+		this->write_elements(obj.data(), N);
 		return *this;
 	}
 
@@ -402,19 +480,11 @@ public:
 
 	template<BufferStreamPossiblyNonContiguousResizableContainer T>
 	BufferStream& read(T& obj, std::uint64_t n) {
-		if (this->useExceptions && this->bufferPos + sizeof(typename T::value_type) * n > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
-
+		this->check_read(n, sizeof(typename T::value_type));
 		obj.clear();
-		if (!n) {
-			return *this;
-		}
-
-		if constexpr (BufferStreamPODByteType<typename T::value_type> && BufferStreamResizableContiguousContainer<T>) {
+		if constexpr (BufferStreamResizableContiguousContainer<T>) {
 			obj.resize(n);
-			std::memcpy(obj.data(), this->buffer + this->bufferPos, n);
-			this->bufferPos += n;
+			this->read_elements(obj.data(), n);
 		} else {
 			// BufferStreamPossiblyNonContiguousResizableContainer doesn't guarantee T::reserve(std::uint64_t) exists!
 			if constexpr (requires([[maybe_unused]] T& t) {
@@ -422,7 +492,7 @@ public:
 			}) {
 				obj.reserve(n);
 			}
-			for (int i = 0; i < n; i++) {
+			for (std::uint64_t i = 0; i < n; i++) {
 				obj.push_back(this->read<typename T::value_type>());
 			}
 		}
@@ -437,20 +507,12 @@ public:
 
 	template<BufferStreamPossiblyNonContiguousResizableContainer T>
 	BufferStream& write(const T& obj) {
-		if (this->bufferPos + sizeof(typename T::value_type) * obj.size() > this->bufferLen && !this->resize_buffer(this->bufferPos + sizeof(typename T::value_type) * obj.size()) && this->useExceptions) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
-		}
-
-		if (!obj.size()) {
-			return *this;
-		}
-
-		if constexpr (BufferStreamPODByteType<typename T::value_type> && (BufferStreamNonResizableContiguousContainer<T> || BufferStreamResizableContiguousContainer<T>)) {
-			std::memcpy(this->buffer + this->bufferPos, obj.data(), obj.size());
-			this->bufferPos += obj.size();
+		if constexpr (BufferStreamNonResizableContiguousContainer<T> || BufferStreamResizableContiguousContainer<T>) {
+			this->write_elements(obj.data(), obj.size());
 		} else {
-			for (int i = 0; i < obj.size(); i++) {
-				this->write(obj[i]);
+			this->reserve_for_write(obj.size(), sizeof(typename T::value_type));
+			for (const auto& value : obj) {
+				this->write(value);
 			}
 		}
 		return *this;
@@ -463,64 +525,184 @@ public:
 
 	template<BufferStreamPODType T>
 	BufferStream& read(T* obj, std::uint64_t n) {
-		if (this->useExceptions && this->bufferPos + sizeof(T) * n > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
+		this->read_elements(obj, n);
+		return *this;
+	}
 
-		if (!n) {
+	template<BufferStreamPODType T>
+	BufferStream& write(const T* obj, std::uint64_t n) {
+		this->write_elements(obj, n);
+		return *this;
+	}
+
+	/// Copies the region with the given layout, starting at the current position, into out packed in row-major order.
+	/// The stream is left just past the last element of the region.
+	template<BufferStreamPODType T, std::uint64_t Extent, std::uint64_t Rank>
+	BufferStream& read_strided(std::span<T, Extent> out, const BufferStreamStridedLayout<Rank>& layout) {
+		if (layout.overflows(sizeof(T))) {
+			if (this->useExceptions) {
+				BufferStreamThrow::overflow_read();
+			}
 			return *this;
 		}
-
-		if constexpr (BufferStreamPODByteType<T>) {
-			std::memcpy(obj, this->buffer + this->bufferPos, n);
-			this->bufferPos += n;
-		} else {
-			for (std::uint64_t i = 0; i < n; i++) {
-				obj[i] = this->read<T>();
+		if (out.size() < layout.size()) {
+			if (this->useExceptions) {
+				BufferStreamThrow::invalid_argument(BUFFERSTREAM_STRIDED_DESTINATION_ERROR_MESSAGE);
 			}
+			return *this;
 		}
+		const std::uint64_t spanSize = layout.required_span_size();
+		this->check_read(spanSize, sizeof(T));
+
+		const std::byte* source = this->buffer + this->bufferPos;
+		auto* destination = reinterpret_cast<std::byte*>(out.data());
+		layout.for_each_run([source, destination](std::uint64_t sourceOffset, std::uint64_t destinationOffset, std::uint64_t count) {
+			std::memcpy(destination + destinationOffset * sizeof(T), source + sourceOffset * sizeof(T), count * sizeof(T));
+		});
+		this->swap_endian_if_needed(out.data(), layout.size());
+		this->bufferPos += sizeof(T) * spanSize;
 		return *this;
 	}
 
-	template<BufferStreamPODType T>
-	BufferStream& write(const T* obj, std::uint64_t n) {
-		if (this->bufferPos + sizeof(T) * n > this->bufferLen && !this->resize_buffer(this->bufferPos + sizeof(T) * n) && this->useExceptions) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
-		}
+	/// Copies a rows by columns block of a larger row-major matrix, starting at the current position.
+	template<BufferStreamPODType T, std::uint64_t Extent>
+	BufferStream& read_strided(std::span<T, Extent> out, std::uint64_t rows, std::uint64_t columns, std::uint64_t rowStride) {
+		return this->read_strided(out, BufferStreamStridedLayout<2>{{rows, columns}, {rowStride, 1}});
+	}
 
+	/// Copies one field out of n fixed-size records into out, e.g. the id at fieldOffset 12 of every 48 byte record.
+	/// The records start at the absolute offset base and are stride bytes apart. The range is checked once up front,
+	/// and the stream is left just past the last record.
+	template<BufferStreamPODType T, std::uint64_t Extent>
+	BufferStream& read_column(std::uint64_t base, std::uint64_t stride, std::uint64_t fieldOffset, std::uint64_t n, std::span<T, Extent> out) {
+		if (out.size() < n) {
+			if (this->useExceptions) {
+				BufferStreamThrow::invalid_argument(BUFFERSTREAM_STRIDED_DESTINATION_ERROR_MESSAGE);
+			}
+			return *this;
+		}
 		if (!n) {
 			return *this;
 		}
-
-		if constexpr (BufferStreamPODByteType<T> && (BufferStreamNonResizableContiguousContainer<T> || BufferStreamResizableContiguousContainer<T>)) {
-			std::memcpy(this->buffer + this->bufferPos, obj, n);
-			this->bufferPos += n;
-		} else {
-			for (std::uint64_t i = 0; i < n; i++) {
-				this->write(obj[i]);
+		// The last record may be cut short after the field, as long as the field itself fits
+		if (this->useExceptions) {
+			const bool fits = base <= this->bufferLen
+				&& fieldOffset <= this->bufferLen - base
+				&& sizeof(T) <= this->bufferLen - base - fieldOffset
+				&& (!stride || n - 1 <= (this->bufferLen - base - fieldOffset - sizeof(T)) / stride);
+			if (!fits) {
+				BufferStreamThrow::overflow_read();
 			}
 		}
+
+		const std::byte* source = this->buffer + base + fieldOffset;
+		T* destination = out.data();
+		T* const end = destination + n;
+		for (; end - destination >= 4; destination += 4, source += 4 * stride) {
+			std::memcpy(destination, source, sizeof(T));
+			std::memcpy(destination + 1, source + stride, sizeof(T));
+			std::memcpy(destination + 2, source + 2 * stride, sizeof(T));
+			std::memcpy(destination + 3, source + 3 * stride, sizeof(T));
+		}
+		for (; destination != end; destination++, source += stride) {
+			std::memcpy(destination, source, sizeof(T));
+		}
+		this->swap_endian_if_needed(out.data(), n);
+		this->bufferPos = std::min(base + n * stride, this->bufferLen);
 		return *this;
 	}
 
-	template<BufferStreamPODType T>
-	BufferStream& read(std::span<T>& obj) {
-		if (this->useExceptions && this->bufferPos + sizeof(T) * obj.size() > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
+	/// Writes the elements byte shuffled: byte 0 of every element, then byte 1 of every element, and so on.
+	/// Neighbouring floats and slowly changing integers share their high bytes, so grouping bytes by significance
+	/// leaves long runs for a compressor to find. The endian conversion happens in the same pass: big endian
+	/// streams write the most significant group first.
+	template<BufferStreamPODType T, std::uint64_t Extent>
+	BufferStream& write_shuffled(std::span<T, Extent> obj) {
+		this->reserve_for_write(obj.size(), sizeof(T));
+		if (obj.empty()) {
+			return *this;
 		}
+		BufferStreamDispatch::kernels().shuffle(this->buffer + this->bufferPos, reinterpret_cast<const std::byte*>(obj.data()), obj.size(), sizeof(T), this->swap_groups<T>());
+		this->bufferPos += sizeof(T) * obj.size();
+		return *this;
+	}
 
-		if (obj.empty()) {
+	/// Reads out.size() elements written by write_shuffled().
+	template<BufferStreamPODType T, std::uint64_t Extent>
+	BufferStream& read_shuffled(std::span<T, Extent> out) {
+		this->check_read(out.size(), sizeof(T));
+		if (out.empty()) {
 			return *this;
 		}
+		BufferStreamDispatch::kernels().unshuffle(reinterpret_cast<std::byte*>(out.data()), this->buffer + this->bufferPos, out.size(), sizeof(T), this->swap_groups<T>());
+		this->bufferPos += sizeof(T) * out.size();
+		return *this;
+	}
 
-		if constexpr (BufferStreamPODByteType<T>) {
-			std::memcpy(obj.data(), this->buffer + this->bufferPos, obj.size());
-			this->bufferPos += obj.size();
-		} else {
-			for (int i = 0; i < obj.size(); i++) {
-				obj[i] = this->read<T>();
+	/// Writes the elements bit shuffled: byte shuffled as by write_shuffled(), then each group of bytes split
+	/// into its 8 bit planes, lowest bit first. Suits values that only use their low bits or change in small steps.
+	/// Elements are shuffled 8 at a time; the last n % 8 follow the planes unshuffled.
+	template<BufferStreamPODType T, std::uint64_t Extent>
+	BufferStream& write_bitshuffled(std::span<T, Extent> obj) {
+		const std::uint64_t n = obj.size();
+		this->reserve_for_write(n, sizeof(T));
+		if (!n) {
+			return *this;
+		}
+		const BufferStreamKernels& kernels = BufferStreamDispatch::kernels();
+		const bool swap = this->swap_groups<T>();
+		const auto* in = reinterpret_cast<const std::byte*>(obj.data());
+		std::byte* out = this->buffer + this->bufferPos;
+		const std::uint64_t whole = n - n % 8;
+
+		// Byte groups are built a cache-sized chunk at a time, then split into planes whole / 8 bytes apart
+		constexpr std::uint64_t chunk = bitshuffle_chunk<T>();
+		std::array<std::byte, chunk * sizeof(T)> groups;
+		for (std::uint64_t first = 0; first < whole; first += chunk) {
+			const std::uint64_t m = std::min(chunk, whole - first);
+			kernels.shuffle(groups.data(), in + first * sizeof(T), m, sizeof(T), swap);
+			for (std::uint64_t b = 0; b < sizeof(T); b++) {
+				kernels.bit_transpose(out + b * whole + first / 8, whole / 8, groups.data() + b * m, m);
+			}
+		}
+		std::memcpy(out + whole * sizeof(T), in + whole * sizeof(T), (n - whole) * sizeof(T));
+		this->swap_endian_if_needed(reinterpret_cast<std::remove_const_t<T>*>(out + whole * sizeof(T)), n - whole);
+		this->bufferPos += sizeof(T) * n;
+		return *this;
+	}
+
+	/// Reads out.size() elements written by write_bitshuffled().
+	template<BufferStreamPODType T, std::uint64_t Extent>
+	BufferStream& read_bitshuffled(std::span<T, Extent> out) {
+		const std::uint64_t n = out.size();
+		this->check_read(n, sizeof(T));
+		if (!n) {
+			return *this;
+		}
+		const BufferStreamKernels& kernels = BufferStreamDispatch::kernels();
+		const bool swap = this->swap_groups<T>();
+		const std::byte* in = this->buffer + this->bufferPos;
+		auto* destination = reinterpret_cast<std::byte*>(out.data());
+		const std::uint64_t whole = n - n % 8;
+
+		constexpr std::uint64_t chunk = bitshuffle_chunk<T>();
+		std::array<std::byte, chunk * sizeof(T)> groups;
+		for (std::uint64_t first = 0; first < whole; first += chunk) {
+			const std::uint64_t m = std::min(chunk, whole - first);
+			for (std::uint64_t b = 0; b < sizeof(T); b++) {
+				kernels.bit_untranspose(groups.data() + b * m, in + b * whole + first / 8, whole / 8, m);
 			}
+			kernels.unshuffle(destination + first * sizeof(T), groups.data(), m, sizeof(T), swap);
 		}
+		std::memcpy(destination + whole * sizeof(T), in + whole * sizeof(T), (n - whole) * sizeof(T));
+		this->swap_endian_if_needed(out.data() + whole, n - whole);
+		this->bufferPos += sizeof(T) * n;
+		return *this;
+	}
+
+	template<BufferStreamPODType T>
+	BufferStream& read(std::span<T>& obj) {
+		this->read_elements(obj.data(), obj.size());
 		return *this;
 	}
 
@@ -532,48 +714,17 @@ public:
 
 	template<BufferStreamPODType T>
 	BufferStream& read(std::span<T>& obj, std::uint64_t n) {
-		if (this->useExceptions && this->bufferPos + sizeof(T) * n > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
-
-		if (!n) {
-			return *this;
-		}
-
 		if (obj.empty()) {
-			obj = std::span<T>{reinterpret_cast<T*>(this->buffer + this->bufferPos), n};
-			this->bufferPos += sizeof(T) * n;
+			obj = this->read_span<T>(n);
 		} else {
-			if constexpr (BufferStreamPODByteType<T>) {
-				std::memcpy(obj.data(), this->buffer + this->bufferPos, n);
-				this->bufferPos += n;
-			} else {
-				for (int i = 0; i < n; i++) {
-					obj[i] = this->read<T>();
-				}
-			}
+			this->read_elements(obj.data(), n);
 		}
 		return *this;
 	}
 
 	template<BufferStreamPODType T>
 	BufferStream& write(const std::span<T>& obj) {
-		if (this->bufferPos + sizeof(T) * obj.size() > this->bufferLen && !this->resize_buffer(this->bufferPos + sizeof(T) * obj.size()) && this->useExceptions) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
-		}
-
-		if (obj.empty()) {
-			return *this;
-		}
-
-		if constexpr (BufferStreamPODByteType<T>) {
-			std::memcpy(this->buffer + this->bufferPos, obj.data(), obj.size());
-			this->bufferPos += obj.size();
-		} else {
-			for (int i = 0; i < obj.size(); i++) {
-				this->write(obj[i]);
-			}
-		}
+		this->write_elements(obj.data(), obj.size());
 		return *this;
 	}
 
@@ -583,12 +734,7 @@ public:
 	}
 
 	BufferStream& read(std::string& obj) {
-		obj.clear();
-		char temp = this->read<char>();
-		while (temp != '\0') {
-			obj += temp;
-			temp = this->read<char>();
-		}
+		obj.assign(this->read_string_view());
 		return *this;
 	}
 
@@ -607,17 +753,11 @@ public:
 			// Add false, bundled false - no null terminator
 			maxSize = obj.size() + addNullTerminator - bundledTerminator;
 		}
-		if (this->bufferPos + maxSize > this->bufferLen && !this->resize_buffer(this->bufferPos + maxSize) && this->useExceptions) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_WRITE_ERROR_MESSAGE};
-		}
-
-		for (std::uint64_t i = 0; i < maxSize; i++) {
-			if (i < obj.size()) {
-				this->write(obj[i]);
-			} else {
-				this->write('\0');
-			}
-		}
+		this->reserve_for_write(maxSize);
+		const std::uint64_t copied = std::min<std::uint64_t>(obj.size(), maxSize);
+		std::memcpy(this->buffer + this->bufferPos, obj.data(), copied);
+		std::memset(this->buffer + this->bufferPos + copied, 0, maxSize - copied);
+		this->bufferPos += maxSize;
 		return *this;
 	}
 
@@ -634,25 +774,7 @@ public:
 	}
 
 	BufferStream& read(std::string& obj, std::uint64_t n, bool stopOnNullTerminator = true) {
-		if (this->useExceptions && this->bufferPos + sizeof(typename std::string::value_type) * n > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
-
-		obj.clear();
-		if (!n) {
-			return *this;
-		}
-
-		obj.reserve(n);
-		for (int i = 0; i < n; i++) {
-			char temp = this->read<char>();
-			if (temp == '\0' && stopOnNullTerminator) {
-				// Read the required number of characters and exit
-				this->skip_u<char>(n - i - 1);
-				break;
-			}
-			obj += temp;
-		}
+		obj.assign(this->read_string_view(n, stopOnNullTerminator));
 		return *this;
 	}
 
@@ -677,11 +799,18 @@ public:
 		return obj;
 	}
 
+	/// Same as read<T>(n), with the container's storage coming from the given allocator.
+	/// For std::pmr containers, a std::pmr::memory_resource* can be passed directly.
+	template<BufferStreamPossiblyNonContiguousResizableContainer T>
+	[[nodiscard]] T read(std::uint64_t n, const typename T::allocator_type& allocator) {
+		T obj{allocator};
+		this->read(obj, n);
+		return obj;
+	}
+
 	template<BufferStreamPODType T>
 	[[nodiscard]] std::span<T> read_span(std::uint64_t n) {
-		if (this->useExceptions && this->bufferPos + sizeof(T) * n > this->bufferLen) {
-			throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
-		}
+		this->check_read(n, sizeof(T));
 
 		if (!n) {
 			return {};
@@ -704,6 +833,73 @@ public:
 		return out;
 	}
 
+	[[nodiscard]] std::pmr::string read_string(const std::pmr::polymorphic_allocator<char>& allocator) {
+		return std::pmr::string{this->read_string_view(), allocator};
+	}
+
+	[[nodiscard]] std::pmr::string read_string(std::uint64_t n, bool stopOnNullTerminator, const std::pmr::polymorphic_allocator<char>& allocator) {
+		return std::pmr::string{this->read_string_view(n, stopOnNullTerminator), allocator};
+	}
+
+	/// Returns a view of the string up to the null terminator and skips past the terminator.
+	/// The view points into the stream's buffer, so it is invalidated if the buffer is resized.
+	[[nodiscard]] std::string_view read_string_view() {
+		const auto* start = reinterpret_cast<const char*>(this->buffer + this->bufferPos);
+		const auto remaining = this->bufferLen - this->bufferPos;
+		const auto* terminator = static_cast<const char*>(std::memchr(start, '\0', remaining));
+		if (!terminator) {
+			if (this->useExceptions) {
+				BufferStreamThrow::overflow_read();
+			}
+			this->bufferPos = this->bufferLen;
+			return {start, remaining};
+		}
+		const std::string_view out{start, static_cast<std::uint64_t>(terminator - start)};
+		this->bufferPos += out.size() + 1;
+		return out;
+	}
+
+	/// Returns a view of the next n chars, cut short at the first null terminator if requested.
+	/// The view points into the stream's buffer, so it is invalidated if the buffer is resized.
+	[[nodiscard]] std::string_view read_string_view(std::uint64_t n, bool stopOnNullTerminator = true) {
+		this->check_read(n);
+
+		const auto* start = reinterpret_cast<const char*>(this->buffer + this->bufferPos);
+		std::uint64_t length = n;
+		if (stopOnNullTerminator) {
+			if (const auto* terminator = static_cast<const char*>(std::memchr(start, '\0', n))) {
+				length = terminator - start;
+			}
+		}
+		this->bufferPos += n;
+		return {start, length};
+	}
+
+	/// Reads the string up to the null terminator into inline storage, without allocating.
+	/// Strings longer than N chars are an overflow, and are cut short if exceptions are disabled.
+	template<std::uint64_t N>
+	[[nodiscard]] BufferStreamFixedString<N> read_fixed_string() {
+		const std::uint64_t pos = this->tell();
+		const std::string_view view = this->read_string_view();
+		if (this->useExceptions && view.size() > N) {
+			this->bufferPos = pos;
+			BufferStreamThrow::overflow_read();
+		}
+		return BufferStreamFixedString<N>{view};
+	}
+
+	/// Reads the next n chars into inline storage, with the same rules as read_string(n).
+	template<std::uint64_t N>
+	[[nodiscard]] BufferStreamFixedString<N> read_fixed_string(std::uint64_t n, bool stopOnNullTerminator = true) {
+		const std::uint64_t pos = this->tell();
+		const std::string_view view = this->read_string_view(n, stopOnNullTerminator);
+		if (this->useExceptions && view.size() > N) {
+			this->bufferPos = pos;
+			BufferStreamThrow::overflow_read();
+		}
+		return BufferStreamFixedString<N>{view};
+	}
+
 	template<std::uint64_t L>
 	[[nodiscard]] std::array<std::byte, L> read_bytes() {
 		return this->read<std::byte, L>();
@@ -715,21 +911,30 @@ public:
 		return out;
 	}
 
+	[[nodiscard]] std::pmr::vector<std::byte> read_bytes(std::uint64_t length, const std::pmr::polymorphic_allocator<std::byte>& allocator) {
+		return this->read<std::pmr::vector<std::byte>>(length, allocator);
+	}
+
+	/// Fills the given storage with the next bytes of the stream.
+	BufferStream& read_bytes_into(std::span<std::byte> out) {
+		return this->read(out.data(), out.size());
+	}
+
 	[[nodiscard]] std::byte at(std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) const {
 		switch (offsetFrom) {
 			case std::ios::beg:
 				if (this->useExceptions && (std::cmp_greater(offset, this->bufferLen) || offset < 0)) {
-					throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
+					BufferStreamThrow::overflow_read();
 				}
 				return this->buffer[offset];
 			case std::ios::cur:
-				if (this->useExceptions && (std::cmp_greater(this->bufferPos + offset, this->bufferLen) || this->bufferPos + offset < 0)) {
-					throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
+				if (this->useExceptions && !this->fits_offset(offset)) {
+					BufferStreamThrow::overflow_read();
 				}
 				return this->buffer[this->bufferPos + offset];
 			case std::ios::end:
 				if (this->useExceptions && (std::cmp_greater(offset, this->bufferLen) || offset <= 0)) {
-					throw std::overflow_error{BUFFERSTREAM_OVERFLOW_READ_ERROR_MESSAGE};
+					BufferStreamThrow::overflow_read();
 				}
 				return this->buffer[this->bufferLen - offset];
 			default:
@@ -816,6 +1021,54 @@ public:
 		return this->at_string(n, stopOnNullTerminator, static_cast<std::int64_t>(offset), offsetFrom);
 	}
 
+	[[nodiscard]] std::string_view at_string_view(std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		const std::uint64_t pos = this->tell();
+		const std::string_view val = this->seek(offset, offsetFrom).read_string_view();
+		this->seek_u(pos);
+		return val;
+	}
+
+	[[nodiscard]] std::string_view at_string_view_u(std::uint64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		return this->at_string_view(static_cast<std::int64_t>(offset), offsetFrom);
+	}
+
+	[[nodiscard]] std::string_view at_string_view(std::uint64_t n, bool stopOnNullTerminator, std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		const std::uint64_t pos = this->tell();
+		const std::string_view val = this->seek(offset, offsetFrom).read_string_view(n, stopOnNullTerminator);
+		this->seek_u(pos);
+		return val;
+	}
+
+	[[nodiscard]] std::string_view at_string_view_u(std::uint64_t n, bool stopOnNullTerminator, std::uint64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		return this->at_string_view(n, stopOnNullTerminator, static_cast<std::int64_t>(offset), offsetFrom);
+	}
+
+	template<std::uint64_t N>
+	[[nodiscard]] BufferStreamFixedString<N> at_fixed_string(std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		const std::uint64_t pos = this->tell();
+		const auto val = this->seek(offset, offsetFrom).template read_fixed_string<N>();
+		this->seek_u(pos);
+		return val;
+	}
+
+	template<std::uint64_t N>
+	[[nodiscard]] BufferStreamFixedString<N> at_fixed_string_u(std::uint64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		return this->at_fixed_string<N>(static_cast<std::int64_t>(offset), offsetFrom);
+	}
+
+	template<std::uint64_t N>
+	[[nodiscard]] BufferStreamFixedString<N> at_fixed_string(std::uint64_t n, bool stopOnNullTerminator, std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		const std::uint64_t pos = this->tell();
+		const auto val = this->seek(offset, offsetFrom).template read_fixed_string<N>(n, stopOnNullTerminator);
+		this->seek_u(pos);
+		return val;
+	}
+
+	template<std::uint64_t N>
+	[[nodiscard]] BufferStreamFixedString<N> at_fixed_string_u(std::uint64_t n, bool stopOnNullTerminator, std::uint64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		return this->at_fixed_string<N>(n, stopOnNullTerminator, static_cast<std::int64_t>(offset), offsetFrom);
+	}
+
 	template<std::uint64_t L>
 	[[nodiscard]] std::array<std::byte, L> at_bytes(std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
 		const std::uint64_t pos = this->tell();
@@ -840,6 +1093,17 @@ public:
 		return this->at_bytes(length, static_cast<std::int64_t>(offset), offsetFrom);
 	}
 
+	[[nodiscard]] std::pmr::vector<std::byte> at_bytes(std::uint64_t length, std::int64_t offset, const std::pmr::polymorphic_allocator<std::byte>& allocator, std::ios::seekdir offsetFrom = std::ios::beg) {
+		const std::uint64_t pos = this->tell();
+		std::pmr::vector<std::byte> val = this->seek(offset, offsetFrom).read_bytes(length, allocator);
+		this->seek_u(pos);
+		return val;
+	}
+
+	[[nodiscard]] std::pmr::vector<std::byte> at_bytes_u(std::uint64_t length, std::uint64_t offset, const std::pmr::polymorphic_allocator<std::byte>& allocator, std::ios::seekdir offsetFrom = std::ios::beg) {
+		return this->at_bytes(length, static_cast<std::int64_t>(offset), allocator, offsetFrom);
+	}
+
 	[[nodiscard]] std::byte peek() const {
 		return this->at(0, std::ios::cur);
 	}
@@ -850,17 +1114,54 @@ public:
 	}
 
 	template<BufferStreamPODType T>
-	static constexpr void swap_endian(T* t) {
-		union {
-			T t;
-			std::byte bytes[sizeof(T)];
-		} source{}, dest{};
-		source.t = *t;
-		for (std::uint64_t k = 0; k < sizeof(T); k++) {
-			dest.bytes[k] = source.bytes[sizeof(T) - k - 1];
-		}
-		*t = dest.t;
-	};
+	static void swap_endian(T* t) {
+		swap_endian(t, 1);
+	}
+
+	/// Reverses the bytes of each of the given elements.
+	/// This is the one byte swapping kernel, every endian conversion in BufferStream and FileStream goes through it.
+	/// Long runs of 2, 4 and 8 byte elements go to the SIMD kernels for this CPU.
+	template<BufferStreamPODType T>
+	static void swap_endian(T* t, std::uint64_t n) {
+		auto* bytes = reinterpret_cast<std::byte*>(t);
+		if constexpr (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8) {
+			if (n * sizeof(T) < SWAP_ENDIAN_DISPATCH_THRESHOLD) {
+				BufferStreamKernels::swap_scalar<sizeof(T)>(bytes, n);
+			} else if constexpr (sizeof(T) == 2) {
+				BufferStreamDispatch::kernels().swap16(bytes, n);
+			} else if constexpr (sizeof(T) == 4) {
+				BufferStreamDispatch::kernels().swap32(bytes, n);
+			} else {
+				BufferStreamDispatch::kernels().swap64(bytes, n);
+			}
+		} else {
+			for (std::uint64_t i = 0; i < n; i++) {
+				for (std::uint64_t k = 0; k < sizeof(T) / 2; k++) {
+					std::swap(bytes[i * sizeof(T) + k], bytes[i * sizeof(T) + sizeof(T) - k - 1]);
+				}
+			}
+		}
+	}
+
+	/// Converts n elements between native endianness and the given endianness, in place.
+	/// Complex POD types can't be converted, which is an error if exceptions are enabled.
+	template<BufferStreamPODType T>
+	static void convert_endian(T* obj, std::uint64_t n, bool bigEndian, bool useExceptions) {
+		static_assert(std::endian::native == std::endian::little || std::endian::native == std::endian::big, "Need to investigate what the proper endianness of this platform is!");
+		if constexpr (sizeof(T) > 1) {
+			if (bigEndian == (std::endian::native == std::endian::big)) {
+				return;
+			}
+			if constexpr (std::is_integral_v<T> || std::floating_point<T> || std::is_enum_v<T>) {
+				swap_endian(obj, n);
+			} else {
+				// Just don't swap the bytes...
+				if (useExceptions) {
+					BufferStreamThrow::big_endian_pod_type();
+				}
+			}
+		}
+	}
 
 protected:
 	std::byte* buffer;
@@ -870,6 +1171,93 @@ protected:
 	bool useExceptions;
 	bool bigEndian;
 
+	/// Converts n elements between native endianness and the stream's endianness, in place.
+	template<BufferStreamPODType T>
+	void swap_endian_if_needed(T* obj, std::uint64_t n) {
+		convert_endian(obj, n, this->bigEndian, this->useExceptions);
+	}
+
+	/// Whether the shuffles should reverse the byte groups of T, which is how they convert endianness.
+	/// Same rules as convert_endian(): complex POD types can't be converted.
+	template<BufferStreamPODType T>
+	[[nodiscard]] bool swap_groups() const {
+		if constexpr (sizeof(T) > 1) {
+			if (this->bigEndian != (std::endian::native == std::endian::big)) {
+				if constexpr (std::is_integral_v<T> || std::floating_point<T> || std::is_enum_v<T>) {
+					return true;
+				} else if (this->useExceptions) {
+					BufferStreamThrow::big_endian_pod_type();
+				}
+			}
+		}
+		return false;
+	}
+
+	/// Elements per chunk of the bit shuffles: a multiple of 8 whose byte groups fit in 16 KiB.
+	template<BufferStreamPODType T>
+	[[nodiscard]] static constexpr std::uint64_t bitshuffle_chunk() {
+		return std::max<std::uint64_t>(16384 / sizeof(T) / 8 * 8, 8);
+	}
+
+	/// Whether n elements of the given size fit between the current position and the end of the buffer.
+	/// Divides instead of multiplying, so a huge count read from a corrupt file can't wrap around and pass.
+	[[nodiscard]] bool fits(std::uint64_t n, std::uint64_t size = 1) const {
+		return this->bufferPos <= this->bufferLen && n <= (this->bufferLen - this->bufferPos) / size;
+	}
+
+	/// Whether moving the current position by the given offset keeps it within the buffer.
+	[[nodiscard]] bool fits_offset(std::int64_t offset) const {
+		if (offset < 0) {
+			return static_cast<std::uint64_t>(-(offset + 1)) < this->bufferPos;
+		}
+		return this->fits(static_cast<std::uint64_t>(offset));
+	}
+
+	void check_read(std::uint64_t n, std::uint64_t size = 1) const {
+		if (this->useExceptions && !this->fits(n, size)) [[unlikely]] {
+			BufferStreamThrow::overflow_read();
+		}
+	}
+
+	void reserve_for_write(std::uint64_t n, std::uint64_t size = 1) {
+		if (!this->fits(n, size)) [[unlikely]] {
+			this->grow_for_write(n, size);
+		}
+	}
+
+	/// Kept out of line, buffers grow by powers of two so this is rarely called.
+	BUFFERSTREAM_NOINLINE void grow_for_write(std::uint64_t n, std::uint64_t size) {
+		// The new length must be representable, or there's nothing to resize to
+		const bool representable = n <= (UINT64_MAX - this->bufferPos) / size;
+		if ((!representable || !this->resize_buffer(this->bufferPos + n * size)) && this->useExceptions) {
+			BufferStreamThrow::overflow_write();
+		}
+	}
+
+	/// Every typed read ends up here: one bounds check, one copy, one endian conversion.
+	template<BufferStreamPODType T>
+	void read_elements(T* obj, std::uint64_t n) {
+		this->check_read(n, sizeof(T));
+		if (!n) {
+			return;
+		}
+		std::memcpy(obj, this->buffer + this->bufferPos, sizeof(T) * n);
+		this->swap_endian_if_needed(obj, n);
+		this->bufferPos += sizeof(T) * n;
+	}
+
+	/// Every typed write ends up here: one bounds check, one copy, one endian conversion.
+	template<BufferStreamPODType T>
+	void write_elements(const T* obj, std::uint64_t n) {
+		this->reserve_for_write(n, sizeof(T));
+		if (!n) {
+			return;
+		}
+		std::memcpy(this->buffer + this->bufferPos, obj, sizeof(T) * n);
+		this->swap_endian_if_needed(reinterpret_cast<T*>(this->buffer + this->bufferPos), n);
+		this->bufferPos += sizeof(T) * n;
+	}
+
 	[[nodiscard]] bool resize_buffer(std::uint64_t newLen) {
 		if (!this->bufferResizeCallback) {
 			return false;
@@ -888,21 +1276,40 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t N>
 	explicit BufferStreamReadOnly(T(&buffer)[N])
-			: BufferStreamReadOnly(const_cast<const T*>(buffer), sizeof(T) * N) {}
+			: BufferStreamReadOnly(const_cast<const T*>(buffer), N) {}
 
 	template<BufferStreamPODType T, std::uint64_t M, std::uint64_t N>
 	explicit BufferStreamReadOnly(T(&buffer)[M][N])
-			: BufferStreamReadOnly(const_cast<const T*>(buffer), sizeof(T) * M * N) {}
+			: BufferStreamReadOnly(const_cast<const T*>(&buffer[0][0]), M * N) {}
 
 	template<BufferStreamNonResizableContiguousContainer T>
 	explicit BufferStreamReadOnly(T& buffer)
-			: BufferStreamReadOnly(const_cast<const typename T::value_type*>(buffer.data()), buffer.size() * sizeof(typename T::value_type)) {}
+			: BufferStreamReadOnly(const_cast<const typename T::value_type*>(buffer.data()), buffer.size()) {}
 
 	template<BufferStreamResizableContiguousContainer T>
 	explicit BufferStreamReadOnly(T& buffer)
-			: BufferStreamReadOnly(const_cast<const typename T::value_type*>(buffer.data()), buffer.size() * sizeof(typename T::value_type)) {}
+			: BufferStreamReadOnly(const_cast<const typename T::value_type*>(buffer.data()), buffer.size()) {}
 
 private:
 	using BufferStream::write;
 	using BufferStream::operator<<;
 };
+
+/// The POD types almost every parser reads and writes.
+#define BUFFERSTREAM_COMMON_TYPES(X) \
+	X(std::int8_t) X(std::uint8_t) X(std::int16_t) X(std::uint16_t) X(std::int32_t) X(std::uint32_t) \
+	X(std::int64_t) X(std::uint64_t) X(float) X(double) X(char) X(std::byte)
+
+#define BUFFERSTREAM_INSTANTIATE(PREFIX, T) \
+	PREFIX template BufferStream& BufferStream::read<T>(T&); \
+	PREFIX template BufferStream& BufferStream::write<T>(const T&); \
+	PREFIX template T BufferStream::read<T>(); \
+	PREFIX template BufferStream& BufferStream::read<T>(T*, std::uint64_t); \
+	PREFIX template BufferStream& BufferStream::write<T>(const T*, std::uint64_t);
+
+// Link against bufferstream_compiled to use instantiations for the common types compiled once, instead of in every translation unit
+#ifdef BUFFERSTREAM_COMPILED_INSTANTIATIONS
+#define BUFFERSTREAM_EXTERN_INSTANTIATION(T) BUFFERSTREAM_INSTANTIATE(extern, T)
+BUFFERSTREAM_COMMON_TYPES(BUFFERSTREAM_EXTERN_INSTANTIATION)
+#undef BUFFERSTREAM_EXTERN_INSTANTIATION
+#endif
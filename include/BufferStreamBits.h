@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#include "BufferStream.h"
+
+/// Writes bit fields to a stream, most significant bit first, filling a 64-bit register before writing it out.
+/// The bits held in the register only reach the stream on flush(), which pads them to a whole byte.
+class BufferStreamBitWriter {
+public:
+	explicit BufferStreamBitWriter(BufferStream& stream_)
+			: stream(stream_)
+			, pending(0)
+			, used(0) {}
+
+	/// Appends the low count bits of value, for a count from 0 to 64.
+	BufferStreamBitWriter& write(std::uint64_t value, std::uint32_t count) {
+		if (!count) {
+			return *this;
+		}
+		if (count < 64) {
+			value &= (std::uint64_t{1} << count) - 1;
+		}
+		const std::uint32_t free = 64 - this->used;
+		if (count < free) {
+			this->pending |= value << (free - count);
+			this->used += count;
+			return *this;
+		}
+		// Top the register up, write it out, and start the next one with whatever didn't fit
+		this->pending |= value >> (count - free);
+		this->emit(8);
+		this->used = count - free;
+		this->pending = this->used ? value << (64 - this->used) : 0;
+		return *this;
+	}
+
+	BufferStreamBitWriter& write_bit(bool bit) {
+		return this->write(bit, 1);
+	}
+
+	/// Writes out the bits still held, padded with zeros to a whole byte.
+	BufferStream& flush() {
+		this->emit((this->used + 7) / 8);
+		this->pending = 0;
+		this->used = 0;
+		return this->stream;
+	}
+
+private:
+	void emit(std::uint32_t bytes) {
+		std::array<std::byte, 8> word;
+		for (std::uint32_t i = 0; i < word.size(); i++) {
+			word[i] = static_cast<std::byte>(this->pending >> (56 - 8 * i));
+		}
+		this->stream.write(word.data(), bytes);
+	}
+
+	BufferStream& stream;
+	std::uint64_t pending;
+	std::uint32_t used;
+};
+
+/// Reads bit fields written by BufferStreamBitWriter, starting at the current position of a stream.
+/// Refills a 64-bit register 8 bytes at a time while there are 8 bytes left, and a byte at a time after that.
+/// The stream's buffer must not change while the reader is in use; the stream only moves on sync().
+class BufferStreamBitReader {
+public:
+	/// The most bits read() takes at once. A refill always leaves at least this many when the data has them.
+	static constexpr std::uint32_t MAX_READ = 56;
+
+	explicit BufferStreamBitReader(BufferStream& stream_)
+			: stream(stream_)
+			, data(stream_.data())
+			, position(std::min(stream_.tell(), stream_.size()))
+			, end(stream_.size())
+			, bits(0)
+			, available(0)
+			, overran(false) {}
+
+	/// Reads count bits, for a count from 0 to MAX_READ. Reading past the end of the stream is an error
+	/// if exceptions are enabled, and reads zeros and sets overrun() otherwise.
+	[[nodiscard]] std::uint64_t read(std::uint32_t count) {
+		if (count > this->available) [[unlikely]] {
+			this->refill();
+			if (count > this->available) {
+				this->overrun_end();
+				return 0;
+			}
+		}
+		const std::uint64_t value = count ? this->bits >> (64 - count) : 0;
+		this->bits <<= count;
+		this->available -= count;
+		return value;
+	}
+
+	/// Reads count bits, for a count from 0 to 64.
+	[[nodiscard]] std::uint64_t read_long(std::uint32_t count) {
+		if (count <= MAX_READ) {
+			return this->read(count);
+		}
+		const std::uint64_t high = this->read(count - 32);
+		return (high << 32) | this->read(32);
+	}
+
+	[[nodiscard]] bool read_bit() {
+		return this->read(1);
+	}
+
+	/// Reads a unary prefix: counts one bits up to max, consuming the zero that ends them if it comes first.
+	/// max must be below MAX_READ.
+	[[nodiscard]] std::uint32_t read_ones(std::uint32_t max) {
+		if (max >= this->available) [[unlikely]] {
+			this->refill();
+		}
+		const std::uint32_t ones = std::min<std::uint32_t>(std::countl_one(this->bits), max);
+		const std::uint32_t count = ones + (ones < max);
+		if (count > this->available) [[unlikely]] {
+			this->overrun_end();
+			return 0;
+		}
+		this->bits <<= count;
+		this->available -= count;
+		return ones;
+	}
+
+	/// Whether a read went past the end of the stream, with exceptions disabled.
+	[[nodiscard]] bool overrun() const {
+		return this->overran;
+	}
+
+	/// Moves the stream to the first byte that wasn't read from, skipping the rest of a partly read byte.
+	BufferStream& sync() {
+		return this->stream.seek_u(this->position - this->available / 8);
+	}
+
+private:
+	void refill() {
+		if (this->end - this->position >= 8) {
+			std::uint64_t word = 0;
+			for (std::uint32_t i = 0; i < 8; i++) {
+				word = (word << 8) | static_cast<std::uint8_t>(this->data[this->position + i]);
+			}
+			// Only whole bytes are counted, but the bits of the next one are already in place, and OR-ing them in again is harmless
+			this->bits |= word >> this->available;
+			const std::uint32_t bytes = (63 - this->available) / 8;
+			this->position += bytes;
+			this->available += bytes * 8;
+			return;
+		}
+		while (this->available <= MAX_READ && this->position < this->end) {
+			this->bits |= static_cast<std::uint64_t>(this->data[this->position++]) << (MAX_READ - this->available);
+			this->available += 8;
+		}
+	}
+
+	void overrun_end() {
+		if (this->stream.are_exceptions_enabled()) {
+			BufferStreamThrow::overflow_read();
+		}
+		this->overran = true;
+		this->bits = 0;
+		this->available = 0;
+	}
+
+	BufferStream& stream;
+	const std::byte* data;
+	std::uint64_t position;
+	std::uint64_t end;
+	std::uint64_t bits;
+	std::uint32_t available;
+	bool overran;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "BufferStream.h"
+#include "BufferStreamVectorKernels.h"
+
+/// CRC32C (Castagnoli), as used by iSCSI, ext4 and most storage formats.
+/// Uses the crc32 instruction when the CPU has it, and slicing by 8 otherwise.
+/// Checksums of adjacent ranges can be combined without rereading either range,
+/// which is what lets compute_parallel split a large buffer across threads.
+class BufferStreamCRC32C {
+public:
+	/// Ranges shorter than this per thread aren't worth starting a thread for.
+	static constexpr std::uint64_t MIN_PARALLEL_SEGMENT = std::uint64_t{1} << 20;
+
+	/// The CRC32C of data, continuing from the CRC32C of whatever came before it.
+	[[nodiscard]] static std::uint32_t compute(std::span<const std::byte> data, std::uint32_t crc = 0) {
+		return ~BufferStreamDispatch::kernels().crc32c(~crc, data.data(), data.size());
+	}
+
+	/// The CRC32C of a range of a stream's buffer. Doesn't move the stream.
+	[[nodiscard]] static std::uint32_t compute(const BufferStream& stream, std::uint64_t offset, std::uint64_t length, std::uint32_t crc = 0) {
+		return compute(stream.bytes(offset, length), crc);
+	}
+
+	/// The CRC32C of A followed by B, given only the CRC32C of each and the length of B.
+	[[nodiscard]] static std::uint32_t combine(std::uint32_t crcA, std::uint32_t crcB, std::uint64_t lengthB) {
+		// Appending B shifts A's register along by B's length; the inversions cancel out in between
+		return BufferStreamKernels::crc32c_multiply(BufferStreamKernels::crc32c_shift(lengthB), crcA) ^ crcB;
+	}
+
+	/// Same result as compute(), but splits data into one segment per thread and combines their checksums.
+	/// Uses fewer threads than asked when the segments would be shorter than minSegment.
+	[[nodiscard]] static std::uint32_t compute_parallel(std::span<const std::byte> data, std::uint32_t crc = 0, std::uint64_t threads = 0, std::uint64_t minSegment = MIN_PARALLEL_SEGMENT) {
+		if (!threads) {
+			threads = std::max<std::uint64_t>(std::thread::hardware_concurrency(), 1);
+		}
+		threads = std::clamp<std::uint64_t>(data.size() / std::max<std::uint64_t>(minSegment, 1), 1, threads);
+		if (threads == 1) {
+			return compute(data, crc);
+		}
+
+		// The calling thread takes the first segment, which also absorbs the remainder
+		const std::uint64_t segment = data.size() / threads;
+		const std::uint64_t first = data.size() - segment * (threads - 1);
+		std::vector<std::uint32_t> crcs(threads - 1);
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		try {
+			for (std::uint64_t i = 0; i < threads - 1; i++) {
+				workers.emplace_back([&crcs, i, part = data.subspan(first + i * segment, segment)] {
+					crcs[i] = compute(part);
+				});
+			}
+		} catch (const std::system_error&) {
+			// Out of threads; the calling thread picks up the segments that didn't get one
+		}
+		crc = compute(data.first(first), crc);
+		for (std::uint64_t i = workers.size(); i < threads - 1; i++) {
+			crcs[i] = compute(data.subspan(first + i * segment, segment));
+		}
+		for (std::uint64_t i = 0; i < threads - 1; i++) {
+			if (i < workers.size()) {
+				workers[i].join();
+			}
+			crc = combine(crc, crcs[i], segment);
+		}
+		return crc;
+	}
+
+	/// compute_parallel() over a range of a stream's buffer. Doesn't move the stream.
+	[[nodiscard]] static std::uint32_t compute_parallel(const BufferStream& stream, std::uint64_t offset, std::uint64_t length, std::uint32_t crc = 0, std::uint64_t threads = 0, std::uint64_t minSegment = MIN_PARALLEL_SEGMENT) {
+		return compute_parallel(stream.bytes(offset, length), crc, threads, minSegment);
+	}
+};
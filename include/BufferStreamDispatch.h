@@ -0,0 +1,445 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BUFFERSTREAM_X86
+#if defined(__x86_64__) || defined(_M_X64)
+#define BUFFERSTREAM_X86_64
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// GCC and Clang only emit instructions for other ISAs in functions that ask for them, MSVC always can
+#if defined(__GNUC__) || defined(__clang__)
+#define BUFFERSTREAM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BUFFERSTREAM_TARGET(isa)
+#endif
+
+/// The instruction sets BufferStream has kernels for, detected once with cpuid.
+class BufferStreamCPU {
+public:
+	enum Level {
+		LEVEL_SCALAR,
+		/// SSSE3 and SSE4.2, for 128-bit byte shuffles
+		LEVEL_SSE42,
+		/// AVX2, for 256-bit byte shuffles
+		LEVEL_AVX2,
+		/// AVX-512F and AVX-512BW, for 512-bit byte shuffles
+		LEVEL_AVX512,
+	};
+
+	/// The highest level this CPU and OS support.
+	[[nodiscard]] static Level detected() {
+		static const Level level = detect();
+		return level;
+	}
+
+	/// Whether the CPU has the SHA extensions. They aren't part of any level: plenty of AVX-512 CPUs lack them,
+	/// and plenty of CPUs without AVX-512 have them. Kernels that use them also need LEVEL_SSE42.
+	[[nodiscard]] static bool has_sha() {
+		static const bool sha = detect_sha();
+		return sha;
+	}
+
+	[[nodiscard]] static constexpr const char* name(Level level) {
+		switch (level) {
+			case LEVEL_SCALAR: return "scalar";
+			case LEVEL_SSE42:  return "sse4.2";
+			case LEVEL_AVX2:   return "avx2";
+			case LEVEL_AVX512: return "avx512";
+		}
+		return "unknown";
+	}
+
+private:
+	[[nodiscard]] static Level detect() {
+#ifdef BUFFERSTREAM_X86
+		std::uint32_t leaf1[4]{};
+		std::uint32_t leaf7[4]{};
+		cpuid(1, leaf1);
+		if (cpuid(0, nullptr) >= 7) {
+			cpuid(7, leaf7);
+		}
+
+		const bool ssse3 = leaf1[2] & (1u << 9);
+		const bool sse42 = leaf1[2] & (1u << 20);
+		if (!ssse3 || !sse42) {
+			return LEVEL_SCALAR;
+		}
+
+		// The wider registers are only usable if the OS saves them on context switches
+		const bool osxsave = leaf1[2] & (1u << 27);
+		const std::uint64_t xcr0 = osxsave ? xgetbv() : 0;
+		const bool avx = (leaf1[2] & (1u << 28)) && (xcr0 & 0x6) == 0x6;
+		const bool avx2 = avx && (leaf7[1] & (1u << 5));
+		if (!avx2) {
+			return LEVEL_SSE42;
+		}
+
+		const bool avx512 = (xcr0 & 0xe6) == 0xe6 && (leaf7[1] & (1u << 16)) && (leaf7[1] & (1u << 30));
+		return avx512 ? LEVEL_AVX512 : LEVEL_AVX2;
+#else
+		return LEVEL_SCALAR;
+#endif
+	}
+
+	[[nodiscard]] static bool detect_sha() {
+#ifdef BUFFERSTREAM_X86
+		std::uint32_t leaf7[4]{};
+		if (cpuid(0, nullptr) >= 7) {
+			cpuid(7, leaf7);
+		}
+		return leaf7[1] & (1u << 29);
+#else
+		return false;
+#endif
+	}
+
+#ifdef BUFFERSTREAM_X86
+	/// Fills out with eax, ebx, ecx and edx for the given leaf (subleaf 0), and returns the highest supported leaf.
+	static std::uint32_t cpuid(std::uint32_t leaf, std::uint32_t* out) {
+		std::uint32_t registers[4]{};
+#if defined(_MSC_VER) && !defined(__clang__)
+		int msvcRegisters[4];
+		__cpuidex(msvcRegisters, static_cast<int>(leaf), 0);
+		std::memcpy(registers, msvcRegisters, sizeof(registers));
+#else
+		__cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+		if (out) {
+			std::memcpy(out, registers, sizeof(registers));
+		}
+		return registers[0];
+	}
+
+	BUFFERSTREAM_TARGET("xsave")
+	static std::uint64_t xgetbv() {
+#if defined(_MSC_VER) && !defined(__clang__)
+		return _xgetbv(0);
+#else
+		std::uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+	}
+#endif
+};
+
+/// One implementation of every dispatched kernel, all built for the same instruction set.
+/// The portable kernels are here, the vector ones in BufferStreamVectorKernels.h.
+struct BufferStreamKernels {
+	BufferStreamCPU::Level level;
+	/// Reverses the bytes of each of n 2, 4 or 8 byte elements, in place.
+	void (*swap16)(std::byte* bytes, std::uint64_t n);
+	void (*swap32)(std::byte* bytes, std::uint64_t n);
+	void (*swap64)(std::byte* bytes, std::uint64_t n);
+	/// Advances a raw CRC32C register over n bytes, without the inversions before and after.
+	std::uint32_t (*crc32c)(std::uint32_t crc, const std::byte* data, std::uint64_t n);
+	/// The index of the first of n bytes where a and b differ, or n if none do.
+	std::uint64_t (*mismatch)(const std::byte* a, const std::byte* b, std::uint64_t n);
+	/// The index of the first of n bytes where a and b are equal, or n if none are.
+	std::uint64_t (*first_equal)(const std::byte* a, const std::byte* b, std::uint64_t n);
+	/// Regroups n elements of size bytes by significance: byte 0 of every element, then byte 1, and so on.
+	/// With swap the groups come most significant first, as if every element had been byte swapped beforehand.
+	void (*shuffle)(std::byte* out, const std::byte* in, std::uint64_t n, std::uint64_t size, bool swap);
+	/// Undoes shuffle, given the same n, size and swap.
+	void (*unshuffle)(std::byte* out, const std::byte* in, std::uint64_t n, std::uint64_t size, bool swap);
+	/// Splits n bytes, a multiple of 8, into their 8 bit planes of n / 8 bytes each, lowest bit first and stride bytes apart.
+	void (*bit_transpose)(std::byte* out, std::uint64_t stride, const std::byte* in, std::uint64_t n);
+	/// Undoes bit_transpose: gathers 8 bit planes stride bytes apart back into n bytes.
+	void (*bit_untranspose)(std::byte* out, const std::byte* in, std::uint64_t stride, std::uint64_t n);
+
+	/// The CRC32C (Castagnoli) polynomial, bit reflected.
+	static constexpr std::uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+	/// Multiplies two polynomials modulo the CRC32C polynomial, both bit reflected.
+	[[nodiscard]] static constexpr std::uint32_t crc32c_multiply(std::uint32_t a, std::uint32_t b) {
+		std::uint32_t product = 0;
+		for (std::uint32_t bit = 1u << 31; bit; bit >>= 1) {
+			if (a & bit) {
+				product ^= b;
+			}
+			b = (b & 1) ? (b >> 1) ^ CRC32C_POLYNOMIAL : b >> 1;
+		}
+		return product;
+	}
+
+	/// x^(8n) modulo the CRC32C polynomial. Multiplying a raw CRC register by this is the same as feeding it n zero bytes.
+	[[nodiscard]] static constexpr std::uint32_t crc32c_shift(std::uint64_t n) {
+		// Square and multiply over the bits of 8n, starting from x^8
+		std::uint32_t result = 1u << 31;
+		std::uint32_t power = 1u << 23;
+		for (; n; n >>= 1) {
+			if (n & 1) {
+				result = crc32c_multiply(power, result);
+			}
+			power = crc32c_multiply(power, power);
+		}
+		return result;
+	}
+
+	/// Tables that multiply by a fixed polynomial a byte at a time, for when the polynomial is known up front.
+	[[nodiscard]] static constexpr std::array<std::array<std::uint32_t, 256>, 4> crc32c_multiply_table(std::uint32_t polynomial) {
+		std::array<std::array<std::uint32_t, 256>, 4> table{};
+		for (std::uint32_t i = 0; i < 256; i++) {
+			for (std::uint32_t j = 0; j < table.size(); j++) {
+				table[j][i] = crc32c_multiply(i << (8 * j), polynomial);
+			}
+		}
+		return table;
+	}
+
+	[[nodiscard]] static constexpr std::uint32_t crc32c_multiply(const std::array<std::array<std::uint32_t, 256>, 4>& table, std::uint32_t a) {
+		return table[0][a & 0xff] ^ table[1][(a >> 8) & 0xff] ^ table[2][(a >> 16) & 0xff] ^ table[3][a >> 24];
+	}
+
+	/// Tables for slicing by 8: entry k of table j is the CRC of byte k followed by j zero bytes.
+	[[nodiscard]] static constexpr std::array<std::array<std::uint32_t, 256>, 8> crc32c_table() {
+		std::array<std::array<std::uint32_t, 256>, 8> table{};
+		for (std::uint32_t i = 0; i < 256; i++) {
+			std::uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+			}
+			table[0][i] = crc;
+		}
+		for (std::uint32_t i = 0; i < 256; i++) {
+			for (std::uint64_t j = 1; j < table.size(); j++) {
+				table[j][i] = (table[j - 1][i] >> 8) ^ table[0][table[j - 1][i] & 0xff];
+			}
+		}
+		return table;
+	}
+
+	static std::uint32_t crc32c_scalar(std::uint32_t crc, const std::byte* data, std::uint64_t n) {
+		static constexpr auto table = crc32c_table();
+		if constexpr (std::endian::native == std::endian::little) {
+			for (; n >= 8; n -= 8, data += 8) {
+				std::uint64_t word;
+				std::memcpy(&word, data, sizeof(word));
+				const auto low = static_cast<std::uint32_t>(word) ^ crc;
+				const auto high = static_cast<std::uint32_t>(word >> 32);
+				crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^ table[5][(low >> 16) & 0xff] ^ table[4][low >> 24]
+					^ table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^ table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+			}
+		}
+		for (; n; n--, data++) {
+			crc = (crc >> 8) ^ table[0][(crc ^ static_cast<std::uint32_t>(*data)) & 0xff];
+		}
+		return crc;
+	}
+
+	/// The portable implementation, also used for short tails by the others.
+	template<std::uint64_t Size>
+	static void swap_scalar(std::byte* bytes, std::uint64_t n) {
+		using U = std::conditional_t<Size == 2, std::uint16_t, std::conditional_t<Size == 4, std::uint32_t, std::uint64_t>>;
+		// Shifts on unsigned integers are recognized as byte swaps, and vectorized into byte shuffles
+		for (std::uint64_t i = 0; i < n; i++) {
+			U value;
+			std::memcpy(&value, bytes + i * Size, Size);
+			U swapped = 0;
+			for (std::uint64_t k = 0; k < Size; k++) {
+				swapped |= ((value >> (k * 8)) & 0xff) << ((Size - k - 1) * 8);
+			}
+			std::memcpy(bytes + i * Size, &swapped, Size);
+		}
+	}
+
+	[[nodiscard]] static std::uint64_t load64(const std::byte* p) {
+		std::uint64_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	static std::uint64_t mismatch_scalar(const std::byte* a, const std::byte* b, std::uint64_t n) {
+		std::uint64_t i = 0;
+		if constexpr (std::endian::native == std::endian::little) {
+			for (; i + 8 <= n; i += 8) {
+				if (const std::uint64_t difference = load64(a + i) ^ load64(b + i)) {
+					return i + std::countr_zero(difference) / 8;
+				}
+			}
+		}
+		while (i < n && a[i] == b[i]) {
+			i++;
+		}
+		return i;
+	}
+
+	static std::uint64_t first_equal_scalar(const std::byte* a, const std::byte* b, std::uint64_t n) {
+		std::uint64_t i = 0;
+		if constexpr (std::endian::native == std::endian::little) {
+			constexpr std::uint64_t LOW = 0x0101010101010101;
+			constexpr std::uint64_t HIGH = 0x8080808080808080;
+			for (; i + 8 <= n; i += 8) {
+				// Flags the zero bytes of the difference; borrows can flag bytes above a zero byte, but never below one
+				const std::uint64_t difference = load64(a + i) ^ load64(b + i);
+				if (const std::uint64_t zeros = (difference - LOW) & ~difference & HIGH) {
+					return i + std::countr_zero(zeros) / 8;
+				}
+			}
+		}
+		while (i < n && a[i] != b[i]) {
+			i++;
+		}
+		return i;
+	}
+
+	template<bool Unshuffle>
+	static void shuffle_scalar(std::byte* out, const std::byte* in, std::uint64_t n, std::uint64_t size, bool swap) {
+		shuffle_from<Unshuffle>(out, in, n, size, swap, 0);
+	}
+
+	/// Shuffles or unshuffles elements first to n of the whole array, which is how the vector kernels finish their tails.
+	template<bool Unshuffle>
+	static void shuffle_from(std::byte* out, const std::byte* in, std::uint64_t n, std::uint64_t size, bool swap, std::uint64_t first) {
+		for (std::uint64_t b = 0; b < size; b++) {
+			const std::uint64_t group = (swap ? size - 1 - b : b) * n;
+			for (std::uint64_t i = first; i < n; i++) {
+				if constexpr (Unshuffle) {
+					out[i * size + b] = in[group + i];
+				} else {
+					out[group + i] = in[i * size + b];
+				}
+			}
+		}
+	}
+
+	/// Transposes the 8x8 bit matrix with a row in each byte, in three rounds of swapping blocks across the diagonal.
+	[[nodiscard]] static constexpr std::uint64_t transpose_bits(std::uint64_t x) {
+		std::uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AA;
+		x ^= t ^ (t << 7);
+		t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCC;
+		x ^= t ^ (t << 14);
+		t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0;
+		x ^= t ^ (t << 28);
+		return x;
+	}
+
+	static void bit_transpose_scalar(std::byte* out, std::uint64_t stride, const std::byte* in, std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; i += 8) {
+			std::uint64_t rows = 0;
+			for (std::uint64_t k = 0; k < 8; k++) {
+				rows |= static_cast<std::uint64_t>(in[i + k]) << (8 * k);
+			}
+			const std::uint64_t planes = transpose_bits(rows);
+			for (std::uint64_t j = 0; j < 8; j++) {
+				out[j * stride + i / 8] = static_cast<std::byte>(planes >> (8 * j));
+			}
+		}
+	}
+
+	static void bit_untranspose_scalar(std::byte* out, const std::byte* in, std::uint64_t stride, std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; i += 8) {
+			std::uint64_t planes = 0;
+			for (std::uint64_t j = 0; j < 8; j++) {
+				planes |= static_cast<std::uint64_t>(in[j * stride + i / 8]) << (8 * j);
+			}
+			const std::uint64_t rows = transpose_bits(planes);
+			for (std::uint64_t k = 0; k < 8; k++) {
+				out[i + k] = static_cast<std::byte>(rows >> (8 * k));
+			}
+		}
+	}
+};
+
+/// Picks the kernels for the detected instruction set the first time they're used.
+/// Tests can force a lower level to exercise every implementation on one host.
+///
+/// Only the portable kernels are built into every translation unit. The vector kernels live in
+/// BufferStreamVectorKernels.h, so that code which only reads and writes values doesn't parse the
+/// intrinsics headers. Once any translation unit of a program includes it, the vector kernels are
+/// used throughout that program. The CMake target adds one that does to everything that links it;
+/// builds that don't use it must include the header in one of their own files.
+class BufferStreamDispatch {
+public:
+	/// Returns the kernels for a level, or null if they aren't available.
+	using Tables = const BufferStreamKernels* (*)(BufferStreamCPU::Level level);
+
+	[[nodiscard]] static const BufferStreamKernels& kernels() {
+		return *active().load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] static BufferStreamCPU::Level level() {
+		return kernels().level;
+	}
+
+	/// False if no translation unit of the program includes BufferStreamVectorKernels.h, in which case
+	/// level() stays at LEVEL_SCALAR whatever the CPU supports.
+	[[nodiscard]] static bool vector_kernels_installed() {
+		return vector_tables().load(std::memory_order_acquire);
+	}
+
+	/// Uses the kernels for the given level from now on, or the highest level below it that the CPU supports
+	/// and that has kernels available. Returns the level actually in use.
+	/// Not meant to be called while other threads use the kernels.
+	static BufferStreamCPU::Level force(BufferStreamCPU::Level level) {
+		if (level > BufferStreamCPU::detected()) {
+			level = BufferStreamCPU::detected();
+		}
+		const BufferStreamKernels& kernels = table(level);
+		active().store(&kernels, std::memory_order_relaxed);
+		return kernels.level;
+	}
+
+	/// Goes back to the kernels for the detected level.
+	static void reset() {
+		force(BufferStreamCPU::detected());
+	}
+
+	/// The kernels for the given level, whether or not this CPU can run them,
+	/// or the highest level below it that has kernels available.
+	[[nodiscard]] static const BufferStreamKernels& table(BufferStreamCPU::Level level) {
+		static constexpr BufferStreamKernels SCALAR{
+			BufferStreamCPU::LEVEL_SCALAR,
+			&BufferStreamKernels::swap_scalar<2>,
+			&BufferStreamKernels::swap_scalar<4>,
+			&BufferStreamKernels::swap_scalar<8>,
+			&BufferStreamKernels::crc32c_scalar,
+			&BufferStreamKernels::mismatch_scalar,
+			&BufferStreamKernels::first_equal_scalar,
+			&BufferStreamKernels::shuffle_scalar<false>,
+			&BufferStreamKernels::shuffle_scalar<true>,
+			&BufferStreamKernels::bit_transpose_scalar,
+			&BufferStreamKernels::bit_untranspose_scalar,
+		};
+		if (const Tables tables = vector_tables().load(std::memory_order_acquire)) {
+			for (; level > BufferStreamCPU::LEVEL_SCALAR; level = static_cast<BufferStreamCPU::Level>(level - 1)) {
+				if (const BufferStreamKernels* kernels = tables(level)) {
+					return *kernels;
+				}
+			}
+		}
+		return SCALAR;
+	}
+
+	/// Makes the vector kernels available and switches to the detected level's.
+	/// Called once by BufferStreamVectorKernels.h as the program starts.
+	static bool install(Tables tables) {
+		vector_tables().store(tables, std::memory_order_release);
+		reset();
+		return true;
+	}
+
+private:
+	[[nodiscard]] static std::atomic<const BufferStreamKernels*>& active() {
+		static std::atomic<const BufferStreamKernels*> kernels{&table(BufferStreamCPU::detected())};
+		return kernels;
+	}
+
+	[[nodiscard]] static std::atomic<Tables>& vector_tables() {
+		static std::atomic<Tables> tables{nullptr};
+		return tables;
+	}
+};
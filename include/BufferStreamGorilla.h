@@ -0,0 +1,239 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+
+#include "BufferStreamBits.h"
+
+constexpr auto BUFFERSTREAM_GORILLA_SIZE_ERROR_MESSAGE = "Timestamps and values must be the same length!";
+constexpr auto BUFFERSTREAM_GORILLA_CORRUPT_ERROR_MESSAGE = "Gorilla encoded value overruns its 64 bits!";
+
+/// The bit codes shared by the Gorilla writer and reader, after Facebook's Gorilla time series database.
+///
+/// Each sample is a timestamp code followed by a value code, most significant bit first. A timestamp is
+/// coded as its delta of delta: the difference between its distance from the previous timestamp and the
+/// distance before that. Regular sampling makes that 0, a single bit. Otherwise a unary prefix picks the width
+/// of the two's complement delta of delta that follows:
+///     0        delta of delta is 0
+///     10       7 bits
+///     110      9 bits
+///     1110     12 bits
+///     11110    32 bits
+///     111110   64 bits
+///     111111   end of the series
+/// A value is XOR-ed with the previous value. Slowly changing doubles share their sign, exponent and high
+/// mantissa bits, leaving a short run of meaningful bits in the middle:
+///     0        same as the previous value
+///     10       the meaningful bits, at the position and length of the last 11 code
+///     11       5 bits of leading zeros, 6 bits of length - 1, then the meaningful bits
+/// Both start from a previous timestamp, distance and value of 0, so the first sample needs no special case.
+struct BufferStreamGorilla {
+	/// The widths of the delta of delta for each prefix length.
+	static constexpr std::array<std::uint32_t, 6> TIMESTAMP_WIDTHS{0, 7, 9, 12, 32, 64};
+	/// The prefix length marking the end of the series, which is all ones.
+	static constexpr std::uint32_t END_PREFIX = 6;
+	/// The most leading zeros that fit in the 5 bits for them; more leading zeros are sent as meaningful bits.
+	static constexpr std::uint32_t MAX_LEADING = 31;
+};
+
+/// Encodes (timestamp, double) samples into a stream with the Gorilla codes, see BufferStreamGorilla.
+/// The series ends with finish(), which the destructor calls if it hasn't been already.
+class BufferStreamGorillaWriter {
+public:
+	explicit BufferStreamGorillaWriter(BufferStream& stream_)
+			: stream(stream_)
+			, bits(stream_)
+			, previousTimestamp(0)
+			, previousDelta(0)
+			, previousValue(0)
+			, leading(64)
+			, trailing(64)
+			, count(0)
+			, finished(false) {}
+
+	BufferStreamGorillaWriter(const BufferStreamGorillaWriter&) = delete;
+	BufferStreamGorillaWriter& operator=(const BufferStreamGorillaWriter&) = delete;
+
+	~BufferStreamGorillaWriter() {
+		try {
+			this->finish();
+		} catch (...) {}
+	}
+
+	BufferStreamGorillaWriter& write(std::int64_t timestamp, double value) {
+		this->write_timestamp(static_cast<std::uint64_t>(timestamp));
+		this->write_value(std::bit_cast<std::uint64_t>(value));
+		this->count++;
+		return *this;
+	}
+
+	BufferStreamGorillaWriter& write(std::span<const std::int64_t> timestamps, std::span<const double> values) {
+		if (timestamps.size() != values.size()) {
+			if (this->stream.are_exceptions_enabled()) {
+				BufferStreamThrow::invalid_argument(BUFFERSTREAM_GORILLA_SIZE_ERROR_MESSAGE);
+			}
+			return *this;
+		}
+		for (std::uint64_t i = 0; i < timestamps.size(); i++) {
+			this->write(timestamps[i], values[i]);
+		}
+		return *this;
+	}
+
+	/// Writes the end of the series and the bits still held. Nothing more can be written after this.
+	BufferStream& finish() {
+		if (!this->finished) {
+			this->finished = true;
+			this->bits.write((std::uint64_t{1} << BufferStreamGorilla::END_PREFIX) - 1, BufferStreamGorilla::END_PREFIX);
+			this->bits.flush();
+		}
+		return this->stream;
+	}
+
+	/// How many samples have been written.
+	[[nodiscard]] std::uint64_t size() const {
+		return this->count;
+	}
+
+private:
+	void write_timestamp(std::uint64_t timestamp) {
+		// Unsigned arithmetic wraps the same way on both ends, so any pair of timestamps round trips
+		const std::uint64_t delta = timestamp - this->previousTimestamp;
+		const auto deltaOfDelta = static_cast<std::int64_t>(delta - this->previousDelta);
+		this->previousTimestamp = timestamp;
+		this->previousDelta = delta;
+		if (!deltaOfDelta) {
+			this->bits.write_bit(false);
+			return;
+		}
+		std::uint32_t prefix = 1;
+		for (; prefix < BufferStreamGorilla::TIMESTAMP_WIDTHS.size() - 1; prefix++) {
+			const std::int64_t limit = std::int64_t{1} << (BufferStreamGorilla::TIMESTAMP_WIDTHS[prefix] - 1);
+			if (deltaOfDelta >= -limit && deltaOfDelta < limit) {
+				break;
+			}
+		}
+		// The prefix is that many ones and a zero
+		this->bits.write(((std::uint64_t{1} << prefix) - 1) << 1, prefix + 1);
+		this->bits.write(static_cast<std::uint64_t>(deltaOfDelta), BufferStreamGorilla::TIMESTAMP_WIDTHS[prefix]);
+	}
+
+	void write_value(std::uint64_t value) {
+		const std::uint64_t difference = value ^ this->previousValue;
+		this->previousValue = value;
+		if (!difference) {
+			this->bits.write_bit(false);
+			return;
+		}
+		const auto leadingZeros = std::min<std::uint32_t>(std::countl_zero(difference), BufferStreamGorilla::MAX_LEADING);
+		const auto trailingZeros = static_cast<std::uint32_t>(std::countr_zero(difference));
+		if (leadingZeros >= this->leading && trailingZeros >= this->trailing) {
+			this->bits.write(0b10, 2);
+			this->bits.write(difference >> this->trailing, 64 - this->leading - this->trailing);
+			return;
+		}
+		this->leading = leadingZeros;
+		this->trailing = trailingZeros;
+		const std::uint32_t length = 64 - leadingZeros - trailingZeros;
+		// 2 + 5 + 6 bits of header fit in one write
+		this->bits.write((std::uint64_t{0b11} << 11) | (leadingZeros << 6) | (length - 1), 13);
+		this->bits.write(difference >> trailingZeros, length);
+	}
+
+	BufferStream& stream;
+	BufferStreamBitWriter bits;
+	std::uint64_t previousTimestamp;
+	std::uint64_t previousDelta;
+	std::uint64_t previousValue;
+	std::uint32_t leading;
+	std::uint32_t trailing;
+	std::uint64_t count;
+	bool finished;
+};
+
+/// Decodes a series written by BufferStreamGorillaWriter, in batches.
+class BufferStreamGorillaReader {
+public:
+	explicit BufferStreamGorillaReader(BufferStream& stream_)
+			: stream(stream_)
+			, bits(stream_)
+			, previousTimestamp(0)
+			, previousDelta(0)
+			, previousValue(0)
+			, leading(0)
+			, trailing(0)
+			, finished(false) {}
+
+	/// Decodes samples until timestamps or values is full or the series ends, and returns how many it decoded.
+	/// Once the series ends, the stream is left just past it and later calls return 0.
+	/// With exceptions disabled, corrupt or cut off data ends the series early.
+	std::uint64_t read(std::span<std::int64_t> timestamps, std::span<double> values) {
+		const std::uint64_t n = std::min(timestamps.size(), values.size());
+		std::uint64_t i = 0;
+		for (; i < n && !this->finished; i++) {
+			const std::uint32_t prefix = this->bits.read_ones(BufferStreamGorilla::END_PREFIX);
+			if (prefix == BufferStreamGorilla::END_PREFIX) {
+				this->end();
+				break;
+			}
+			if (prefix) {
+				// Sign extend the delta of delta from its width
+				const std::uint32_t width = BufferStreamGorilla::TIMESTAMP_WIDTHS[prefix];
+				const std::uint64_t deltaOfDelta = this->bits.read_long(width) << (64 - width);
+				this->previousDelta += static_cast<std::uint64_t>(static_cast<std::int64_t>(deltaOfDelta) >> (64 - width));
+			}
+			this->previousTimestamp += this->previousDelta;
+
+			if (this->bits.read_bit()) {
+				if (this->bits.read_bit()) {
+					const auto header = static_cast<std::uint32_t>(this->bits.read(11));
+					this->leading = header >> 6;
+					const std::uint32_t length = (header & 0x3f) + 1;
+					if (this->leading + length > 64) {
+						this->corrupt();
+						break;
+					}
+					this->trailing = 64 - this->leading - length;
+				}
+				this->previousValue ^= this->bits.read_long(64 - this->leading - this->trailing) << this->trailing;
+			}
+			if (this->bits.overrun()) [[unlikely]] {
+				this->end();
+				break;
+			}
+			timestamps[i] = static_cast<std::int64_t>(this->previousTimestamp);
+			values[i] = std::bit_cast<double>(this->previousValue);
+		}
+		return i;
+	}
+
+	/// Whether the end of the series has been reached.
+	[[nodiscard]] bool done() const {
+		return this->finished;
+	}
+
+private:
+	void end() {
+		this->finished = true;
+		this->bits.sync();
+	}
+
+	void corrupt() {
+		if (this->stream.are_exceptions_enabled()) {
+			BufferStreamThrow::invalid_argument(BUFFERSTREAM_GORILLA_CORRUPT_ERROR_MESSAGE);
+		}
+		this->end();
+	}
+
+	BufferStream& stream;
+	BufferStreamBitReader bits;
+	std::uint64_t previousTimestamp;
+	std::uint64_t previousDelta;
+	std::uint64_t previousValue;
+	std::uint32_t leading;
+	std::uint32_t trailing;
+	bool finished;
+};
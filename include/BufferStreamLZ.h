@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+/// A small, fast LZ77 codec in the style of LZ4, for compressing independent blocks of up to 4 GiB.
+/// Each sequence is a token byte (literal length in the high nibble, match length - 4 in the low nibble),
+/// extra length bytes for either length when its nibble is 15, the literals, and a 2-byte little-endian
+/// match offset. The last sequence of a block is literals only.
+/// Compressed data is untrusted: decompression checks every length and offset against the buffers.
+class BufferStreamLZ {
+public:
+	static constexpr std::uint64_t MIN_MATCH = 4;
+	static constexpr std::uint64_t MAX_OFFSET = 65535;
+
+	/// The most compress() can append for an input of the given size, when nothing in it matches.
+	[[nodiscard]] static constexpr std::uint64_t max_compressed_size(std::uint64_t size) {
+		return size + size / 255 + 16;
+	}
+
+	/// Appends the compressed form of in to out.
+	static void compress(std::span<const std::byte> in, std::vector<std::byte>& out) {
+		const std::uint64_t start = out.size();
+		out.resize(start + max_compressed_size(in.size()));
+		std::byte* op = out.data() + start;
+
+		const std::byte* const base = in.data();
+		const std::uint64_t n = in.size();
+		std::uint64_t anchor = 0;
+		if (n > LAST_LITERALS + MIN_MATCH) {
+			std::array<std::uint32_t, std::uint64_t{1} << HASH_BITS> table{};
+			const std::uint64_t matchLimit = n - LAST_LITERALS;
+			std::uint64_t i = 0;
+			while (i + MIN_MATCH <= matchLimit) {
+				const std::uint32_t sequence = load32(base + i);
+				auto& slot = table[hash(sequence)];
+				const std::uint64_t candidate = slot;
+				slot = static_cast<std::uint32_t>(i);
+				if (candidate >= i || i - candidate > MAX_OFFSET || load32(base + candidate) != sequence) {
+					// Step faster through data that isn't matching, so incompressible input stays cheap
+					i += 1 + ((i - anchor) >> 6);
+					continue;
+				}
+
+				// Extend backwards over literals that also match, then forwards as far as possible
+				std::uint64_t matchStart = i;
+				std::uint64_t matchSource = candidate;
+				while (matchStart > anchor && matchSource > 0 && base[matchStart - 1] == base[matchSource - 1]) {
+					matchStart--;
+					matchSource--;
+				}
+				const std::uint64_t length = (i - matchStart) + MIN_MATCH + match_length(base + i + MIN_MATCH, base + candidate + MIN_MATCH, base + matchLimit);
+
+				op = write_sequence(op, base + anchor, matchStart - anchor, matchStart - matchSource, length);
+				i = matchStart + length;
+				anchor = i;
+				if (i >= 2 && i - 2 + MIN_MATCH <= n) {
+					table[hash(load32(base + i - 2))] = static_cast<std::uint32_t>(i - 2);
+				}
+			}
+		}
+		op = write_literals(op, base + anchor, n - anchor);
+		out.resize(op - out.data());
+	}
+
+	/// Decompresses in, which must decompress to exactly out.size() bytes.
+	/// Returns false if the compressed data is malformed.
+	[[nodiscard]] static bool decompress(std::span<const std::byte> in, std::span<std::byte> out) {
+		const std::byte* ip = in.data();
+		const std::byte* const inEnd = ip + in.size();
+		std::byte* op = out.data();
+		std::byte* const outEnd = op + out.size();
+
+		while (ip < inEnd) {
+			const auto token = static_cast<std::uint8_t>(*ip++);
+
+			std::uint64_t literals = token >> 4;
+			if (literals == 15 && !read_length(ip, inEnd, literals)) {
+				return false;
+			}
+			if (literals > static_cast<std::uint64_t>(inEnd - ip) || literals > static_cast<std::uint64_t>(outEnd - op)) {
+				return false;
+			}
+			if (literals <= 16 && inEnd - ip >= 16 && outEnd - op >= 16) {
+				// Short runs are copied with one fixed-size copy, which may write past them into space that's overwritten next
+				std::memcpy(op, ip, 16);
+			} else if (literals) {
+				std::memcpy(op, ip, literals);
+			}
+			ip += literals;
+			op += literals;
+			if (ip == inEnd) {
+				// The last sequence has no match
+				break;
+			}
+
+			if (inEnd - ip < 2) {
+				return false;
+			}
+			const std::uint64_t offset = static_cast<std::uint64_t>(ip[0]) | (static_cast<std::uint64_t>(ip[1]) << 8);
+			ip += 2;
+			std::uint64_t length = token & 15;
+			if (length == 15 && !read_length(ip, inEnd, length)) {
+				return false;
+			}
+			length += MIN_MATCH;
+			if (!offset || offset > static_cast<std::uint64_t>(op - out.data()) || length > static_cast<std::uint64_t>(outEnd - op)) {
+				return false;
+			}
+			copy_match(op, outEnd, offset, length);
+			op += length;
+		}
+		return op == outEnd;
+	}
+
+private:
+	static constexpr std::uint64_t HASH_BITS = 12;
+	/// Matches never reach into the last few bytes, which keeps the match search free of bounds checks.
+	static constexpr std::uint64_t LAST_LITERALS = 8;
+
+	[[nodiscard]] static std::uint32_t load32(const std::byte* p) {
+		std::uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	[[nodiscard]] static std::uint64_t load64(const std::byte* p) {
+		std::uint64_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	[[nodiscard]] static std::uint32_t hash(std::uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	/// Counts matching bytes from a and b, stopping at limit (which a is before).
+	[[nodiscard]] static std::uint64_t match_length(const std::byte* a, const std::byte* b, const std::byte* limit) {
+		const std::byte* const start = a;
+		while (limit - a >= 8) {
+			if (const std::uint64_t difference = load64(a) ^ load64(b)) {
+				const int bits = std::endian::native == std::endian::little ? std::countr_zero(difference) : std::countl_zero(difference);
+				return (a - start) + bits / 8;
+			}
+			a += 8;
+			b += 8;
+		}
+		while (a < limit && *a == *b) {
+			a++;
+			b++;
+		}
+		return a - start;
+	}
+
+	static std::byte* write_length(std::byte* op, std::uint64_t length) {
+		for (; length >= 255; length -= 255) {
+			*op++ = std::byte{255};
+		}
+		*op++ = static_cast<std::byte>(length);
+		return op;
+	}
+
+	static std::byte* write_sequence(std::byte* op, const std::byte* literals, std::uint64_t literalCount, std::uint64_t offset, std::uint64_t length) {
+		const std::uint64_t matchCode = length - MIN_MATCH;
+		std::byte* token = op++;
+		*token = static_cast<std::byte>((std::min<std::uint64_t>(literalCount, 15) << 4) | std::min<std::uint64_t>(matchCode, 15));
+		if (literalCount >= 15) {
+			op = write_length(op, literalCount - 15);
+		}
+		std::memcpy(op, literals, literalCount);
+		op += literalCount;
+		*op++ = static_cast<std::byte>(offset & 0xff);
+		*op++ = static_cast<std::byte>(offset >> 8);
+		if (matchCode >= 15) {
+			op = write_length(op, matchCode - 15);
+		}
+		return op;
+	}
+
+	static std::byte* write_literals(std::byte* op, const std::byte* literals, std::uint64_t literalCount) {
+		*op++ = static_cast<std::byte>(std::min<std::uint64_t>(literalCount, 15) << 4);
+		if (literalCount >= 15) {
+			op = write_length(op, literalCount - 15);
+		}
+		if (literalCount) {
+			std::memcpy(op, literals, literalCount);
+		}
+		return op + literalCount;
+	}
+
+	[[nodiscard]] static bool read_length(const std::byte*& ip, const std::byte* inEnd, std::uint64_t& length) {
+		for (;;) {
+			if (ip == inEnd) {
+				return false;
+			}
+			const auto extra = static_cast<std::uint8_t>(*ip++);
+			length += extra;
+			if (extra != 255) {
+				return true;
+			}
+		}
+	}
+
+	/// Copies a match that may overlap its own output, as runs do when the offset is shorter than the length.
+	static void copy_match(std::byte* op, const std::byte* outEnd, std::uint64_t offset, std::uint64_t length) {
+		const std::byte* source = op - offset;
+		if (offset >= 8 && length <= 16 && outEnd - op >= 16) {
+			std::memcpy(op, source, 8);
+			std::memcpy(op + 8, source + 8, 8);
+			return;
+		}
+		if (offset >= length) {
+			std::memcpy(op, source, length);
+			return;
+		}
+		if (offset >= 8) {
+			for (; length >= 8; length -= 8, op += 8, source += 8) {
+				std::memcpy(op, source, 8);
+			}
+		}
+		for (; length; length--) {
+			*op++ = *source++;
+		}
+	}
+};
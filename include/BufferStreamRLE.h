@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include "BufferStream.h"
+#include "BufferStreamVectorKernels.h"
+
+constexpr auto BUFFERSTREAM_RLE_OVERRUN_ERROR_MESSAGE = "Run-length encoded data overruns its output!";
+constexpr auto BUFFERSTREAM_RLE_ELEMENT_SIZE_ERROR_MESSAGE = "Run-length encoded data must be a whole number of elements!";
+
+/// Run-length codecs for PackBits and TGA, reading packets from a stream and writing them to one.
+/// Runs and literals are of elements of elementSize bytes: 1 for PackBits in TIFF, the pixel size
+/// for TGA, and whatever else an ad-hoc format repeats.
+///
+/// Decoding checks each packet against the input and the output once, fills runs with memset or
+/// doubling copies, and copies literals with memcpy. Encoding finds where runs start and end with
+/// the dispatched byte compares, rather than comparing an element at a time.
+class BufferStreamRLE {
+public:
+	/// Packets hold at most this many elements, in both formats.
+	static constexpr std::uint64_t MAX_PACKET = 128;
+
+	/// The most encoding size bytes can take, in either format.
+	[[nodiscard]] static constexpr std::uint64_t max_encoded_size(std::uint64_t size, std::uint64_t elementSize = 1) {
+		// Every run saves at least a byte, which pays for the header of the literal after it
+		return size + (size / std::max<std::uint64_t>(elementSize, 1) + MAX_PACKET - 1) / MAX_PACKET + 1;
+	}
+
+	/// PackBits: a signed header byte n, followed by n + 1 literal elements when n >= 0,
+	/// or by one element repeated 1 - n times when n < 0. A header of -128 is skipped.
+	/// Decodes until out is full, and returns how many bytes were decoded: all of them unless
+	/// exceptions are disabled, in which case decoding stops before the first bad packet.
+	static std::uint64_t decode_packbits(BufferStream& in, std::span<std::byte> out, std::uint64_t elementSize = 1) {
+		return decode<false>(in, out, elementSize);
+	}
+
+	static BufferStream& encode_packbits(BufferStream& out, std::span<const std::byte> in, std::uint64_t elementSize = 1) {
+		return encode<false>(out, in, elementSize);
+	}
+
+	/// TGA (image types 9 to 11): a header byte holding the element count - 1 in its low 7 bits, followed
+	/// by that many literal elements when the high bit is clear, or by one element repeated when it's set.
+	static std::uint64_t decode_tga(BufferStream& in, std::span<std::byte> out, std::uint64_t elementSize) {
+		return decode<true>(in, out, elementSize);
+	}
+
+	static BufferStream& encode_tga(BufferStream& out, std::span<const std::byte> in, std::uint64_t elementSize) {
+		return encode<true>(out, in, elementSize);
+	}
+
+private:
+	template<bool Tga>
+	static std::uint64_t decode(BufferStream& in, std::span<std::byte> out, std::uint64_t elementSize) {
+		if (!elementSize || out.size() % elementSize) {
+			if (in.are_exceptions_enabled()) {
+				BufferStreamThrow::invalid_argument(BUFFERSTREAM_RLE_ELEMENT_SIZE_ERROR_MESSAGE);
+			}
+			return 0;
+		}
+
+		const std::byte* const base = in.data();
+		const std::uint64_t end = in.size();
+		std::uint64_t pos = std::min(in.tell(), end);
+		std::byte* op = out.data();
+		std::byte* const outEnd = op + out.size();
+		while (op != outEnd) {
+			if (pos == end) {
+				if (in.are_exceptions_enabled()) {
+					BufferStreamThrow::overflow_read();
+				}
+				break;
+			}
+			const auto header = static_cast<std::uint8_t>(base[pos]);
+			bool run;
+			std::uint64_t count;
+			if constexpr (Tga) {
+				run = header & 0x80;
+				count = (header & 0x7f) + 1;
+			} else {
+				if (header == 0x80) {
+					pos++;
+					continue;
+				}
+				run = header > 0x80;
+				count = run ? 257 - header : header + 1;
+			}
+
+			const std::uint64_t payload = run ? elementSize : count * elementSize;
+			if (payload > end - pos - 1) {
+				if (in.are_exceptions_enabled()) {
+					BufferStreamThrow::overflow_read();
+				}
+				break;
+			}
+			if (count > static_cast<std::uint64_t>(outEnd - op) / elementSize) {
+				if (in.are_exceptions_enabled()) {
+					BufferStreamThrow::invalid_argument(BUFFERSTREAM_RLE_OVERRUN_ERROR_MESSAGE);
+				}
+				break;
+			}
+			const std::byte* const source = base + pos + 1;
+			if (run) {
+				fill(op, source, elementSize, count);
+			} else {
+				std::memcpy(op, source, payload);
+			}
+			op += count * elementSize;
+			pos += 1 + payload;
+		}
+		in.seek_u(pos);
+		return op - out.data();
+	}
+
+	/// Repeats the element at source count times from op.
+	static void fill(std::byte* op, const std::byte* source, std::uint64_t elementSize, std::uint64_t count) {
+		if (elementSize == 1) {
+			std::memset(op, static_cast<int>(*source), count);
+			return;
+		}
+		// Copy what's been filled so far onto the end of itself, doubling it each time
+		const std::uint64_t total = count * elementSize;
+		std::memcpy(op, source, elementSize);
+		for (std::uint64_t filled = elementSize; filled < total;) {
+			const std::uint64_t chunk = std::min(filled, total - filled);
+			std::memcpy(op + filled, op, chunk);
+			filled += chunk;
+		}
+	}
+
+	template<bool Tga>
+	static BufferStream& encode(BufferStream& out, std::span<const std::byte> in, std::uint64_t elementSize) {
+		if (!elementSize || in.size() % elementSize) {
+			if (out.are_exceptions_enabled()) {
+				BufferStreamThrow::invalid_argument(BUFFERSTREAM_RLE_ELEMENT_SIZE_ERROR_MESSAGE);
+			}
+			return out;
+		}
+
+		// A run packet costs a header and an element, and splits the literal around it in two.
+		// Single bytes break even at 3, wider elements at 2
+		const std::uint64_t minRun = elementSize == 1 ? 3 : 2;
+		const BufferStreamKernels& kernels = BufferStreamDispatch::kernels();
+		const std::byte* const data = in.data();
+		const std::uint64_t n = in.size();
+		std::uint64_t i = 0;
+		while (i < n) {
+			const std::uint64_t run = run_length(kernels, data, i, n, elementSize);
+			if (run >= minRun) {
+				out.write(static_cast<std::uint8_t>(Tga ? 0x80 | (run - 1) : 257 - run));
+				out.write(data + i, elementSize);
+				i += run * elementSize;
+				continue;
+			}
+
+			// Extend the literal up to the next run that's worth a packet of its own
+			const std::uint64_t limit = std::min(n, i + MAX_PACKET * elementSize);
+			std::uint64_t literalEnd = i + run * elementSize;
+			while (literalEnd < limit) {
+				const std::uint64_t scanEnd = std::min(limit, n - elementSize);
+				if (literalEnd >= scanEnd) {
+					literalEnd = limit;
+					break;
+				}
+				const std::uint64_t equal = literalEnd + kernels.first_equal(data + literalEnd, data + literalEnd + elementSize, scanEnd - literalEnd);
+				if (equal == scanEnd) {
+					literalEnd = limit;
+					break;
+				}
+				const std::uint64_t element = equal - equal % elementSize;
+				const std::uint64_t elementRun = run_length(kernels, data, element, n, elementSize);
+				if (elementRun >= minRun) {
+					literalEnd = element;
+					break;
+				}
+				literalEnd = element + elementRun * elementSize;
+			}
+			literalEnd = std::min(literalEnd, limit);
+
+			const std::uint64_t count = (literalEnd - i) / elementSize;
+			out.write(static_cast<std::uint8_t>(count - 1));
+			out.write(data + i, literalEnd - i);
+			i = literalEnd;
+		}
+		return out;
+	}
+
+	/// How many times the element at i repeats from there, up to MAX_PACKET.
+	[[nodiscard]] static std::uint64_t run_length(const BufferStreamKernels& kernels, const std::byte* data, std::uint64_t i, std::uint64_t n, std::uint64_t elementSize) {
+		if (n - i <= elementSize) {
+			return 1;
+		}
+		// Element i repeats m more times exactly when the bytes after it match the bytes one element further on
+		const std::uint64_t limit = std::min(n - i - elementSize, (MAX_PACKET - 1) * elementSize);
+		return 1 + kernels.mismatch(data + i, data + i + elementSize, limit) / elementSize;
+	}
+};
@@ -0,0 +1,526 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include "BufferStreamDispatch.h"
+
+#ifdef BUFFERSTREAM_X86
+#include <immintrin.h>
+#endif
+
+/// The SSE4.2, AVX2 and AVX-512 kernels, and the tables BufferStreamDispatch picks between.
+/// The portable kernels they fall back on for short tails are inherited from BufferStreamKernels.
+struct BufferStreamVectorKernels : BufferStreamKernels {
+	/// The kernels for the given level, or null if there are none for it on this architecture.
+	[[nodiscard]] static const BufferStreamKernels* table(BufferStreamCPU::Level level) {
+#ifdef BUFFERSTREAM_X86
+		// Every level from SSE4.2 up has the crc32 instruction, but only 64-bit mode has its 8-byte form
+#ifdef BUFFERSTREAM_X86_64
+		constexpr auto CRC32C_HARDWARE = &BufferStreamVectorKernels::crc32c_sse42;
+#else
+		constexpr auto CRC32C_HARDWARE = &BufferStreamKernels::crc32c_scalar;
+#endif
+		static constexpr BufferStreamKernels SSE42{
+			BufferStreamCPU::LEVEL_SSE42,
+			&BufferStreamVectorKernels::swap_sse42<2>,
+			&BufferStreamVectorKernels::swap_sse42<4>,
+			&BufferStreamVectorKernels::swap_sse42<8>,
+			CRC32C_HARDWARE,
+			&BufferStreamVectorKernels::compare_sse42<false>,
+			&BufferStreamVectorKernels::compare_sse42<true>,
+			&BufferStreamVectorKernels::shuffle_sse42<false>,
+			&BufferStreamVectorKernels::shuffle_sse42<true>,
+			&BufferStreamVectorKernels::bit_transpose_sse42,
+			&BufferStreamVectorKernels::bit_untranspose_sse42,
+		};
+		static constexpr BufferStreamKernels AVX2{
+			BufferStreamCPU::LEVEL_AVX2,
+			&BufferStreamVectorKernels::swap_avx2<2>,
+			&BufferStreamVectorKernels::swap_avx2<4>,
+			&BufferStreamVectorKernels::swap_avx2<8>,
+			CRC32C_HARDWARE,
+			&BufferStreamVectorKernels::compare_avx2<false>,
+			&BufferStreamVectorKernels::compare_avx2<true>,
+			&BufferStreamVectorKernels::shuffle_avx2<false>,
+			&BufferStreamVectorKernels::shuffle_avx2<true>,
+			&BufferStreamVectorKernels::bit_transpose_avx2,
+			&BufferStreamVectorKernels::bit_untranspose_avx2,
+		};
+		static constexpr BufferStreamKernels AVX512{
+			BufferStreamCPU::LEVEL_AVX512,
+			&BufferStreamVectorKernels::swap_avx512<2>,
+			&BufferStreamVectorKernels::swap_avx512<4>,
+			&BufferStreamVectorKernels::swap_avx512<8>,
+			CRC32C_HARDWARE,
+			&BufferStreamVectorKernels::compare_avx512<false>,
+			&BufferStreamVectorKernels::compare_avx512<true>,
+			// The shuffles are bound by loads and stores well before AVX2 runs out of shuffle throughput
+			&BufferStreamVectorKernels::shuffle_avx2<false>,
+			&BufferStreamVectorKernels::shuffle_avx2<true>,
+			&BufferStreamVectorKernels::bit_transpose_avx512,
+			&BufferStreamVectorKernels::bit_untranspose_avx2,
+		};
+		switch (level) {
+			case BufferStreamCPU::LEVEL_SCALAR: return nullptr;
+			case BufferStreamCPU::LEVEL_SSE42:  return &SSE42;
+			case BufferStreamCPU::LEVEL_AVX2:   return &AVX2;
+			case BufferStreamCPU::LEVEL_AVX512: return &AVX512;
+		}
+#else
+		(void) level;
+#endif
+		return nullptr;
+	}
+
+#ifdef BUFFERSTREAM_X86
+	/// A byte shuffle reversing each Size byte group, repeated across a 512-bit register.
+	/// The 256 and 512-bit shuffles work within 128-bit lanes, so the same pattern serves every width.
+	template<std::uint64_t Size>
+	static constexpr std::array<char, 64> SWAP_SHUFFLE = [] {
+		std::array<char, 64> shuffle{};
+		for (std::uint64_t i = 0; i < shuffle.size(); i++) {
+			shuffle[i] = static_cast<char>((i % 16) / Size * Size + Size - 1 - i % Size);
+		}
+		return shuffle;
+	}();
+
+	template<std::uint64_t Size>
+	BUFFERSTREAM_TARGET("ssse3,sse4.2")
+	static void swap_sse42(std::byte* bytes, std::uint64_t n) {
+		const auto shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(SWAP_SHUFFLE<Size>.data()));
+		const std::uint64_t length = n * Size;
+		std::uint64_t i = 0;
+		for (; i + 16 <= length; i += 16) {
+			auto* p = reinterpret_cast<__m128i*>(bytes + i);
+			_mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), shuffle));
+		}
+		swap_scalar<Size>(bytes + i, (length - i) / Size);
+	}
+
+	template<std::uint64_t Size>
+	BUFFERSTREAM_TARGET("avx2")
+	static void swap_avx2(std::byte* bytes, std::uint64_t n) {
+		const auto shuffle = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(SWAP_SHUFFLE<Size>.data()));
+		const std::uint64_t length = n * Size;
+		std::uint64_t i = 0;
+		for (; i + 64 <= length; i += 64) {
+			auto* p = reinterpret_cast<__m256i*>(bytes + i);
+			const auto a = _mm256_loadu_si256(p);
+			const auto b = _mm256_loadu_si256(p + 1);
+			_mm256_storeu_si256(p, _mm256_shuffle_epi8(a, shuffle));
+			_mm256_storeu_si256(p + 1, _mm256_shuffle_epi8(b, shuffle));
+		}
+		for (; i + 32 <= length; i += 32) {
+			auto* p = reinterpret_cast<__m256i*>(bytes + i);
+			_mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), shuffle));
+		}
+		swap_scalar<Size>(bytes + i, (length - i) / Size);
+	}
+
+#ifdef BUFFERSTREAM_X86_64
+	/// Bytes per stream in crc32c_sse42. Three streams run side by side, so this only kicks in from three times this size.
+	static constexpr std::uint64_t CRC32C_STREAM_SIZE = 4096;
+
+	/// The crc32 instruction takes 3 cycles but can start one every cycle, so three independent streams
+	/// are computed at once and merged by shifting the first two over the bytes that follow them.
+	BUFFERSTREAM_TARGET("sse4.2")
+	static std::uint32_t crc32c_sse42(std::uint32_t crc, const std::byte* data, std::uint64_t n) {
+		static constexpr auto SHIFT_ONE = crc32c_multiply_table(crc32c_shift(CRC32C_STREAM_SIZE));
+		static constexpr auto SHIFT_TWO = crc32c_multiply_table(crc32c_shift(2 * CRC32C_STREAM_SIZE));
+		for (; n >= 3 * CRC32C_STREAM_SIZE; n -= 3 * CRC32C_STREAM_SIZE, data += 3 * CRC32C_STREAM_SIZE) {
+			std::uint64_t a = crc;
+			std::uint64_t b = 0;
+			std::uint64_t c = 0;
+			for (std::uint64_t i = 0; i < CRC32C_STREAM_SIZE; i += 8) {
+				std::uint64_t words[3];
+				std::memcpy(&words[0], data + i, 8);
+				std::memcpy(&words[1], data + CRC32C_STREAM_SIZE + i, 8);
+				std::memcpy(&words[2], data + 2 * CRC32C_STREAM_SIZE + i, 8);
+				a = _mm_crc32_u64(a, words[0]);
+				b = _mm_crc32_u64(b, words[1]);
+				c = _mm_crc32_u64(c, words[2]);
+			}
+			crc = crc32c_multiply(SHIFT_TWO, static_cast<std::uint32_t>(a)) ^ crc32c_multiply(SHIFT_ONE, static_cast<std::uint32_t>(b)) ^ static_cast<std::uint32_t>(c);
+		}
+		std::uint64_t wide = crc;
+		for (; n >= 8; n -= 8, data += 8) {
+			std::uint64_t word;
+			std::memcpy(&word, data, sizeof(word));
+			wide = _mm_crc32_u64(wide, word);
+		}
+		crc = static_cast<std::uint32_t>(wide);
+		for (; n; n--, data++) {
+			crc = _mm_crc32_u8(crc, static_cast<std::uint8_t>(*data));
+		}
+		return crc;
+	}
+#endif
+
+	template<std::uint64_t Size>
+	BUFFERSTREAM_TARGET("avx512f,avx512bw")
+	static void swap_avx512(std::byte* bytes, std::uint64_t n) {
+		const auto shuffle = _mm512_loadu_si512(SWAP_SHUFFLE<Size>.data());
+		const std::uint64_t length = n * Size;
+		std::uint64_t i = 0;
+		for (; i + 64 <= length; i += 64) {
+			_mm512_storeu_si512(bytes + i, _mm512_shuffle_epi8(_mm512_loadu_si512(bytes + i), shuffle));
+		}
+		// The tail is always whole elements, so a masked load and store finishes it without a scalar loop
+		if (const std::uint64_t tail = length - i) {
+			const __mmask64 mask = (1ull << tail) - 1;
+			_mm512_mask_storeu_epi8(bytes + i, mask, _mm512_shuffle_epi8(_mm512_maskz_loadu_epi8(mask, bytes + i), shuffle));
+		}
+	}
+
+	/// Byte compares of a and b, 16, 32 or 64 at a time. Equal picks whether the first equal byte
+	/// or the first different byte is wanted; the tail after the last whole vector is left to the scalar code.
+	template<bool Equal>
+	BUFFERSTREAM_TARGET("sse4.2")
+	static std::uint64_t compare_sse42(const std::byte* a, const std::byte* b, std::uint64_t n) {
+		std::uint64_t i = 0;
+		for (; i + 16 <= n; i += 16) {
+			const auto equal = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)))));
+			if (const std::uint32_t found = Equal ? equal : ~equal & 0xffff) {
+				return i + std::countr_zero(found);
+			}
+		}
+		return i + (Equal ? first_equal_scalar : mismatch_scalar)(a + i, b + i, n - i);
+	}
+
+	template<bool Equal>
+	BUFFERSTREAM_TARGET("avx2")
+	static std::uint64_t compare_avx2(const std::byte* a, const std::byte* b, std::uint64_t n) {
+		std::uint64_t i = 0;
+		for (; i + 32 <= n; i += 32) {
+			const auto equal = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)))));
+			if (const std::uint32_t found = Equal ? equal : ~equal) {
+				return i + std::countr_zero(found);
+			}
+		}
+		return i + compare_sse42<Equal>(a + i, b + i, n - i);
+	}
+
+	/// Byte shuffles gathering byte b of every Size byte element of a 128-bit lane into the b-th of Size groups,
+	/// or with Ungroup scattering the groups back into elements. Repeated for both lanes of a 256-bit register.
+	template<std::uint64_t Size, bool Ungroup>
+	static constexpr std::array<char, 32> GROUP_SHUFFLE = [] {
+		constexpr std::uint64_t perLane = 16 / Size;
+		std::array<char, 32> shuffle{};
+		for (std::uint64_t i = 0; i < shuffle.size(); i++) {
+			// Position b * perLane + e of a grouped lane holds byte b of element e
+			const std::uint64_t p = i % 16;
+			shuffle[i] = static_cast<char>(Ungroup ? p % Size * perLane + p / Size : p % perLane * Size + p / perLane);
+		}
+		return shuffle;
+	}();
+
+	/// Swaps group b of vector k with group k of vector b, within each 128-bit lane. After grouping Size vectors
+	/// of elements this leaves one vector per byte significance; being its own inverse, it also takes them back.
+	template<std::uint64_t Size>
+	BUFFERSTREAM_TARGET("sse4.2")
+	static void transpose_groups_sse42(__m128i* v) {
+		if constexpr (Size == 2) {
+			const auto a = v[0];
+			v[0] = _mm_unpacklo_epi64(a, v[1]);
+			v[1] = _mm_unpackhi_epi64(a, v[1]);
+		} else if constexpr (Size == 4) {
+			const auto a = _mm_unpacklo_epi32(v[0], v[1]);
+			const auto b = _mm_unpackhi_epi32(v[0], v[1]);
+			const auto c = _mm_unpacklo_epi32(v[2], v[3]);
+			const auto d = _mm_unpackhi_epi32(v[2], v[3]);
+			v[0] = _mm_unpacklo_epi64(a, c);
+			v[1] = _mm_unpackhi_epi64(a, c);
+			v[2] = _mm_unpacklo_epi64(b, d);
+			v[3] = _mm_unpackhi_epi64(b, d);
+		} else {
+			__m128i a[8], b[8];
+			for (std::uint64_t k = 0; k < 8; k += 2) {
+				a[k] = _mm_unpacklo_epi16(v[k], v[k + 1]);
+				a[k + 1] = _mm_unpackhi_epi16(v[k], v[k + 1]);
+			}
+			for (std::uint64_t k = 0; k < 8; k += 4) {
+				b[k] = _mm_unpacklo_epi32(a[k], a[k + 2]);
+				b[k + 1] = _mm_unpackhi_epi32(a[k], a[k + 2]);
+				b[k + 2] = _mm_unpacklo_epi32(a[k + 1], a[k + 3]);
+				b[k + 3] = _mm_unpackhi_epi32(a[k + 1], a[k + 3]);
+			}
+			for (std::uint64_t k = 0; k < 4; k++) {
+				v[2 * k] = _mm_unpacklo_epi64(b[k], b[k + 4]);
+				v[2 * k + 1] = _mm_unpackhi_epi64(b[k], b[k + 4]);
+			}
+		}
+	}
+
+	template<std::uint64_t Size>
+	BUFFERSTREAM_TARGET("avx2")
+	static void transpose_groups_avx2(__m256i* v) {
+		if constexpr (Size == 2) {
+			const auto a = v[0];
+			v[0] = _mm256_unpacklo_epi64(a, v[1]);
+			v[1] = _mm256_unpackhi_epi64(a, v[1]);
+		} else if constexpr (Size == 4) {
+			const auto a = _mm256_unpacklo_epi32(v[0], v[1]);
+			const auto b = _mm256_unpackhi_epi32(v[0], v[1]);
+			const auto c = _mm256_unpacklo_epi32(v[2], v[3]);
+			const auto d = _mm256_unpackhi_epi32(v[2], v[3]);
+			v[0] = _mm256_unpacklo_epi64(a, c);
+			v[1] = _mm256_unpackhi_epi64(a, c);
+			v[2] = _mm256_unpacklo_epi64(b, d);
+			v[3] = _mm256_unpackhi_epi64(b, d);
+		} else {
+			__m256i a[8], b[8];
+			for (std::uint64_t k = 0; k < 8; k += 2) {
+				a[k] = _mm256_unpacklo_epi16(v[k], v[k + 1]);
+				a[k + 1] = _mm256_unpackhi_epi16(v[k], v[k + 1]);
+			}
+			for (std::uint64_t k = 0; k < 8; k += 4) {
+				b[k] = _mm256_unpacklo_epi32(a[k], a[k + 2]);
+				b[k + 1] = _mm256_unpackhi_epi32(a[k], a[k + 2]);
+				b[k + 2] = _mm256_unpacklo_epi32(a[k + 1], a[k + 3]);
+				b[k + 3] = _mm256_unpackhi_epi32(a[k + 1], a[k + 3]);
+			}
+			for (std::uint64_t k = 0; k < 4; k++) {
+				v[2 * k] = _mm256_unpacklo_epi64(b[k], b[k + 4]);
+				v[2 * k + 1] = _mm256_unpackhi_epi64(b[k], b[k + 4]);
+			}
+		}
+	}
+
+	/// 16 elements at a time: Size loads, a byte shuffle each, one transpose, and Size stores.
+	/// Starts at element first and returns where it stopped; the groups are n bytes apart.
+	template<bool Unshuffle, std::uint64_t Size>
+	BUFFERSTREAM_TARGET("ssse3,sse4.2")
+	static std::uint64_t shuffle_sse42_sized(std::byte* out, const std::byte* in, std::uint64_t n, bool swap, std::uint64_t first) {
+		const auto pattern = _mm_loadu_si128(reinterpret_cast<const __m128i*>(GROUP_SHUFFLE<Size, Unshuffle>.data()));
+		std::uint64_t i = first;
+		for (; i + 16 <= n; i += 16) {
+			__m128i v[Size];
+			if constexpr (Unshuffle) {
+				for (std::uint64_t k = 0; k < Size; k++) {
+					v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (swap ? Size - 1 - k : k) * n + i));
+				}
+				transpose_groups_sse42<Size>(v);
+				for (std::uint64_t k = 0; k < Size; k++) {
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * Size + k * 16), _mm_shuffle_epi8(v[k], pattern));
+				}
+			} else {
+				for (std::uint64_t k = 0; k < Size; k++) {
+					v[k] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * Size + k * 16)), pattern);
+				}
+				transpose_groups_sse42<Size>(v);
+				for (std::uint64_t k = 0; k < Size; k++) {
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + (swap ? Size - 1 - k : k) * n + i), v[k]);
+				}
+			}
+		}
+		return i;
+	}
+
+	/// 32 elements at a time. The lanes are loaded from the two halves of the elements, so after
+	/// the in-lane shuffles and transpose each vector holds 32 consecutive bytes of a group.
+	template<bool Unshuffle, std::uint64_t Size>
+	BUFFERSTREAM_TARGET("avx2")
+	static std::uint64_t shuffle_avx2_sized(std::byte* out, const std::byte* in, std::uint64_t n, bool swap) {
+		const auto pattern = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(GROUP_SHUFFLE<Size, Unshuffle>.data()));
+		std::uint64_t i = 0;
+		for (; i + 32 <= n; i += 32) {
+			__m256i v[Size];
+			if constexpr (Unshuffle) {
+				for (std::uint64_t k = 0; k < Size; k++) {
+					v[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + (swap ? Size - 1 - k : k) * n + i));
+				}
+				transpose_groups_avx2<Size>(v);
+				for (std::uint64_t k = 0; k < Size; k++) {
+					const auto elements = _mm256_shuffle_epi8(v[k], pattern);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * Size + k * 16), _mm256_castsi256_si128(elements));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + (i + 16) * Size + k * 16), _mm256_extracti128_si256(elements, 1));
+				}
+			} else {
+				for (std::uint64_t k = 0; k < Size; k++) {
+					const auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * Size + k * 16));
+					const auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (i + 16) * Size + k * 16));
+					v[k] = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), pattern);
+				}
+				transpose_groups_avx2<Size>(v);
+				for (std::uint64_t k = 0; k < Size; k++) {
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (swap ? Size - 1 - k : k) * n + i), v[k]);
+				}
+			}
+		}
+		return shuffle_sse42_sized<Unshuffle, Size>(out, in, n, swap, i);
+	}
+
+	/// Elements of 2, 4 and 8 bytes are vectorized, any other size is left to the scalar code.
+	template<bool Unshuffle>
+	BUFFERSTREAM_TARGET("ssse3,sse4.2")
+	static void shuffle_sse42(std::byte* out, const std::byte* in, std::uint64_t n, std::uint64_t size, bool swap) {
+		std::uint64_t done = 0;
+		switch (size) {
+			case 2: done = shuffle_sse42_sized<Unshuffle, 2>(out, in, n, swap, 0); break;
+			case 4: done = shuffle_sse42_sized<Unshuffle, 4>(out, in, n, swap, 0); break;
+			case 8: done = shuffle_sse42_sized<Unshuffle, 8>(out, in, n, swap, 0); break;
+			default: break;
+		}
+		shuffle_from<Unshuffle>(out, in, n, size, swap, done);
+	}
+
+	template<bool Unshuffle>
+	BUFFERSTREAM_TARGET("avx2")
+	static void shuffle_avx2(std::byte* out, const std::byte* in, std::uint64_t n, std::uint64_t size, bool swap) {
+		std::uint64_t done = 0;
+		switch (size) {
+			case 2: done = shuffle_avx2_sized<Unshuffle, 2>(out, in, n, swap); break;
+			case 4: done = shuffle_avx2_sized<Unshuffle, 4>(out, in, n, swap); break;
+			case 8: done = shuffle_avx2_sized<Unshuffle, 8>(out, in, n, swap); break;
+			default: break;
+		}
+		shuffle_from<Unshuffle>(out, in, n, size, swap, done);
+	}
+
+	/// movemask collects the top bit of every byte, so each plane is one movemask away,
+	/// highest plane first, doubling the bytes in between to bring the next bit up.
+	BUFFERSTREAM_TARGET("sse4.2")
+	static void bit_transpose_sse42(std::byte* out, std::uint64_t stride, const std::byte* in, std::uint64_t n) {
+		std::uint64_t i = 0;
+		for (; i + 16 <= n; i += 16) {
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			for (std::uint64_t j = 8; j--;) {
+				const auto bits = static_cast<std::uint16_t>(_mm_movemask_epi8(v));
+				std::memcpy(out + j * stride + i / 8, &bits, sizeof(bits));
+				v = _mm_add_epi8(v, v);
+			}
+		}
+		bit_transpose_scalar(out + i / 8, stride, in + i, n - i);
+	}
+
+	/// transpose_bits() on every 64-bit lane.
+	BUFFERSTREAM_TARGET("sse4.2")
+	static __m128i transpose_bits_sse42(__m128i x) {
+		auto t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 7)), _mm_set1_epi64x(0x00AA00AA00AA00AA));
+		x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 7)));
+		t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 14)), _mm_set1_epi64x(0x0000CCCC0000CCCC));
+		x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 14)));
+		t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 28)), _mm_set1_epi64x(0x00000000F0F0F0F0));
+		return _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 28)));
+	}
+
+	/// 16 bytes of each plane make 128 bytes of output. Interleaving the planes a byte, word and dword
+	/// at a time lines up each group of 8 bytes' bit matrix in a 64-bit lane, which transpose_bits() undoes.
+	BUFFERSTREAM_TARGET("sse4.2")
+	static void bit_untranspose_sse42(std::byte* out, const std::byte* in, std::uint64_t stride, std::uint64_t n) {
+		std::uint64_t i = 0;
+		for (; i + 128 <= n; i += 128) {
+			__m128i a[8], b[8];
+			for (std::uint64_t j = 0; j < 8; j += 2) {
+				const auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + j * stride + i / 8));
+				const auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (j + 1) * stride + i / 8));
+				a[j] = _mm_unpacklo_epi8(low, high);
+				a[j + 1] = _mm_unpackhi_epi8(low, high);
+			}
+			for (std::uint64_t k = 0; k < 8; k += 4) {
+				b[k] = _mm_unpacklo_epi16(a[k], a[k + 2]);
+				b[k + 1] = _mm_unpackhi_epi16(a[k], a[k + 2]);
+				b[k + 2] = _mm_unpacklo_epi16(a[k + 1], a[k + 3]);
+				b[k + 3] = _mm_unpackhi_epi16(a[k + 1], a[k + 3]);
+			}
+			for (std::uint64_t k = 0; k < 4; k++) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 32 * k), transpose_bits_sse42(_mm_unpacklo_epi32(b[k], b[k + 4])));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 32 * k + 16), transpose_bits_sse42(_mm_unpackhi_epi32(b[k], b[k + 4])));
+			}
+		}
+		bit_untranspose_scalar(out + i, in + i / 8, stride, n - i);
+	}
+
+	BUFFERSTREAM_TARGET("avx2")
+	static void bit_transpose_avx2(std::byte* out, std::uint64_t stride, const std::byte* in, std::uint64_t n) {
+		std::uint64_t i = 0;
+		for (; i + 32 <= n; i += 32) {
+			auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+			for (std::uint64_t j = 8; j--;) {
+				const auto bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(v));
+				std::memcpy(out + j * stride + i / 8, &bits, sizeof(bits));
+				v = _mm256_add_epi8(v, v);
+			}
+		}
+		bit_transpose_sse42(out + i / 8, stride, in + i, n - i);
+	}
+
+	BUFFERSTREAM_TARGET("avx2")
+	static __m256i transpose_bits_avx2(__m256i x) {
+		auto t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 7)), _mm256_set1_epi64x(0x00AA00AA00AA00AA));
+		x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 7)));
+		t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 14)), _mm256_set1_epi64x(0x0000CCCC0000CCCC));
+		x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 14)));
+		t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 28)), _mm256_set1_epi64x(0x00000000F0F0F0F0));
+		return _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 28)));
+	}
+
+	/// As bit_untranspose_sse42(), with the high lanes working on the second 128 bytes of output.
+	BUFFERSTREAM_TARGET("avx2")
+	static void bit_untranspose_avx2(std::byte* out, const std::byte* in, std::uint64_t stride, std::uint64_t n) {
+		std::uint64_t i = 0;
+		for (; i + 256 <= n; i += 256) {
+			__m256i a[8], b[8];
+			for (std::uint64_t j = 0; j < 8; j += 2) {
+				const auto low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + j * stride + i / 8));
+				const auto high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + (j + 1) * stride + i / 8));
+				a[j] = _mm256_unpacklo_epi8(low, high);
+				a[j + 1] = _mm256_unpackhi_epi8(low, high);
+			}
+			for (std::uint64_t k = 0; k < 8; k += 4) {
+				b[k] = _mm256_unpacklo_epi16(a[k], a[k + 2]);
+				b[k + 1] = _mm256_unpackhi_epi16(a[k], a[k + 2]);
+				b[k + 2] = _mm256_unpacklo_epi16(a[k + 1], a[k + 3]);
+				b[k + 3] = _mm256_unpackhi_epi16(a[k + 1], a[k + 3]);
+			}
+			for (std::uint64_t k = 0; k < 4; k++) {
+				const auto even = transpose_bits_avx2(_mm256_unpacklo_epi32(b[k], b[k + 4]));
+				const auto odd = transpose_bits_avx2(_mm256_unpackhi_epi32(b[k], b[k + 4]));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 32 * k), _mm256_castsi256_si128(even));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 32 * k + 16), _mm256_castsi256_si128(odd));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 128 + 32 * k), _mm256_extracti128_si256(even, 1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 128 + 32 * k + 16), _mm256_extracti128_si256(odd, 1));
+			}
+		}
+		bit_untranspose_sse42(out + i, in + i / 8, stride, n - i);
+	}
+
+	template<bool Equal>
+	BUFFERSTREAM_TARGET("avx512f,avx512bw")
+	static std::uint64_t compare_avx512(const std::byte* a, const std::byte* b, std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; i += 64) {
+			// Masked loads finish the tail too, and never touch the bytes past it
+			const __mmask64 mask = n - i >= 64 ? ~0ull : (1ull << (n - i)) - 1;
+			const __m512i va = _mm512_maskz_loadu_epi8(mask, a + i);
+			const __m512i vb = _mm512_maskz_loadu_epi8(mask, b + i);
+			const __mmask64 found = (Equal ? _mm512_cmpeq_epi8_mask(va, vb) : _mm512_cmpneq_epi8_mask(va, vb)) & mask;
+			if (found) {
+				return i + std::countr_zero(found);
+			}
+		}
+		return n;
+	}
+
+	BUFFERSTREAM_TARGET("avx512f,avx512bw")
+	static void bit_transpose_avx512(std::byte* out, std::uint64_t stride, const std::byte* in, std::uint64_t n) {
+		std::uint64_t i = 0;
+		for (; i + 64 <= n; i += 64) {
+			auto v = _mm512_loadu_si512(in + i);
+			for (std::uint64_t j = 8; j--;) {
+				const std::uint64_t bits = _mm512_movepi8_mask(v);
+				std::memcpy(out + j * stride + i / 8, &bits, sizeof(bits));
+				v = _mm512_add_epi8(v, v);
+			}
+		}
+		bit_transpose_avx2(out + i / 8, stride, in + i, n - i);
+	}
+#endif
+};
+
+/// Hands the vector kernels to BufferStreamDispatch when the program starts.
+inline const bool bufferStreamVectorKernelsInstalled = BufferStreamDispatch::install(&BufferStreamVectorKernels::table);
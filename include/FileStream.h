@@ -1,15 +1,59 @@
 #pragma once
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
 
 #include "BufferStream.h"
+#include "FileStreamAccessPattern.h"
+#include "FileStreamBlockCache.h"
+#include "FileStreamHistogram.h"
+
+constexpr auto FILESTREAM_READ_ONLY_SEGMENT_ERROR_MESSAGE = "Cannot read into a segment of const data!";
+
+/// A typed buffer for FileStream::read_vectored and FileStream::write_vectored.
+/// Remembers its element type, so the stream's endianness can be applied to each segment separately.
+class FileStreamSegment {
+public:
+	template<BufferStreamPODType T, std::size_t Extent>
+	FileStreamSegment(std::span<T, Extent> span) // NOLINT(*-explicit-constructor)
+			: data(reinterpret_cast<std::byte*>(const_cast<std::remove_const_t<T>*>(span.data())))
+			, size(span.size_bytes())
+			, readOnly(std::is_const_v<T>)
+			, swapEndian(nullptr)
+			, complex(false) {
+		using U = std::remove_const_t<T>;
+		if constexpr (sizeof(U) > 1) {
+			if constexpr (std::is_integral_v<U> || std::floating_point<U>) {
+				this->swapEndian = &swap_endian_elements<U>;
+			} else if constexpr (std::is_enum_v<U>) {
+				this->swapEndian = &swap_endian_elements<std::underlying_type_t<U>>;
+			} else {
+				this->complex = true;
+			}
+		}
+	}
+
+	std::byte* data;
+	std::uint64_t size;
+	bool readOnly;
+	void(*swapEndian)(std::byte* data, std::uint64_t size);
+	bool complex;
+
+private:
+	template<BufferStreamPODType T>
+	static void swap_endian_elements(std::byte* data, std::uint64_t size) {
+		BufferStream::swap_endian(reinterpret_cast<T*>(data), size / sizeof(T));
+	}
+};
 
 /**
  * This class is provided for convenience, but use BufferStream if you can.
  * It has more features, like reading an object at a given location without
- * seeking, reading to a std::span, etc. This class also has no tests because
- * I was lazy.
+ * seeking, reading to a std::span, etc.
  */
 class FileStream {
 public:
@@ -21,9 +65,30 @@ public:
 		OPT_CREATE_IF_NONEXISTENT = 1 << 4,
 	};
 
+	enum AccessHint {
+		HINT_NONE,       // Don't track reads or advise the kernel
+		HINT_AUTO,       // Detect sequential, strided and random reads, and prefetch ahead of strided ones
+		HINT_SEQUENTIAL, // Always prefetch the readahead window
+		HINT_RANDOM,     // Never prefetch
+	};
+
+	static constexpr std::uint64_t DEFAULT_READAHEAD_WINDOW = 8 * 1024 * 1024;
+
 	explicit FileStream(const std::string& path, int options = OPT_READ)
-			: useExceptions(true)
-			, bigEndian(false) {
+			: filePath(path)
+			, writable(options & (OPT_WRITE | OPT_APPEND | OPT_TRUNCATE))
+			, appending(options & OPT_APPEND)
+			, truncated(options & OPT_TRUNCATE)
+			, useExceptions(true)
+			, bigEndian(false)
+			, latencyHistograms(nullptr)
+			, blockCacheFileID(0)
+			, blockCacheReadPos(0)
+			, accessHint(HINT_NONE)
+			, readaheadWindow(DEFAULT_READAHEAD_WINDOW)
+			, readaheadUntil(0)
+			, accessReadPos(0)
+			, accessReadPosKnown(false) {
 		if ((options & OPT_CREATE_IF_NONEXISTENT) && !std::filesystem::exists(path)) {
 			if (!std::filesystem::exists(std::filesystem::path{path}.parent_path())) {
 				std::error_code ec;
@@ -55,6 +120,12 @@ public:
 		return static_cast<bool>(this->file);
 	}
 
+	/// Clears the error state left by a failed read or write, so the stream can be used again.
+	FileStream& clear() {
+		this->file.clear();
+		return *this;
+	}
+
 	[[nodiscard]] bool are_exceptions_enabled() const {
 		return this->useExceptions;
 	}
@@ -73,11 +144,102 @@ public:
 		return *this;
 	}
 
+	[[nodiscard]] FileStreamLatencyHistograms* get_latency_histograms() const {
+		return this->latencyHistograms;
+	}
+
+	/// Opt-in latency recording. The histograms must outlive the stream, pass nullptr to stop recording.
+	FileStream& set_latency_histograms(FileStreamLatencyHistograms* histograms) {
+		this->latencyHistograms = histograms;
+		return *this;
+	}
+
+	[[nodiscard]] const std::shared_ptr<FileStreamBlockCache>& get_block_cache() const {
+		return this->blockCache;
+	}
+
+	/// Serve reads from the given block cache, which may be shared with other streams. Pass nullptr to read from the file directly.
+	/// While a cache is set, seeking and reading only touch the file when a block isn't cached yet.
+	/// If the stream truncated the file when it was opened, blocks cached from its old contents are dropped.
+	FileStream& set_block_cache(std::shared_ptr<FileStreamBlockCache> cache) {
+		if (this->blockCache && !cache) {
+			this->file.seekg(static_cast<std::streamoff>(this->blockCacheReadPos));
+		} else if (!this->blockCache && cache) {
+			const auto pos = this->file.tellg();
+			this->blockCacheReadPos = pos < 0 ? 0 : static_cast<std::uint64_t>(pos);
+		}
+		this->blockCache = std::move(cache);
+		if (this->blockCache) {
+			this->blockCacheFileID = this->blockCache->register_file(this->filePath);
+			if (this->truncated) {
+				this->blockCache->invalidate(this->blockCacheFileID);
+			}
+		}
+		return *this;
+	}
+
+	[[nodiscard]] AccessHint get_access_hint() const {
+		return this->accessHint;
+	}
+
+	/// Sets how the stream advises the kernel about upcoming reads (HINT_NONE by default).
+	/// The readahead window is how far ahead of sequential reads the kernel is asked to prefetch.
+	/// Prefetching goes through a second descriptor, opened on the first prefetch, into the page cache the stream reads from.
+	FileStream& set_access_hint(AccessHint hint, std::uint64_t readaheadWindow_ = DEFAULT_READAHEAD_WINDOW) {
+		this->accessHint = hint;
+		this->readaheadWindow = readaheadWindow_;
+		this->readaheadUntil = 0;
+		this->accessDetector.reset();
+		return *this;
+	}
+
+	/// The access pattern reads are currently being treated as, either detected or forced by the hint.
+	[[nodiscard]] FileStreamAccessPatternDetector::Pattern get_access_pattern() const {
+		switch (this->accessHint) {
+			case HINT_AUTO:
+				return this->accessDetector.get_pattern();
+			case HINT_SEQUENTIAL:
+				return FileStreamAccessPatternDetector::PATTERN_SEQUENTIAL;
+			case HINT_RANDOM:
+				return FileStreamAccessPatternDetector::PATTERN_RANDOM;
+			default:
+				return FileStreamAccessPatternDetector::PATTERN_UNKNOWN;
+		}
+	}
+
 	FileStream& seek_in(std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
 		// Match behavior in BufferStream::seek
 		if (offsetFrom == std::ios::end) {
 			offset *= -1;
 		}
+		const FileStreamLatencyTimer timer{this->latencyHistograms, FileStreamLatencyHistograms::OP_SEEK, 0};
+		if (offsetFrom == std::ios::beg) {
+			this->accessReadPos = offset;
+			this->accessReadPosKnown = true;
+		} else if (offsetFrom == std::ios::cur) {
+			this->accessReadPos += offset;
+		} else {
+			this->accessReadPosKnown = false;
+		}
+		if (this->blockCache) {
+			switch (offsetFrom) {
+				case std::ios::beg:
+					this->blockCacheReadPos = offset;
+					break;
+				case std::ios::cur:
+					this->blockCacheReadPos += offset;
+					break;
+				case std::ios::end: {
+					this->file.flush();
+					std::error_code ec;
+					this->blockCacheReadPos = std::filesystem::file_size(this->filePath, ec) + offset;
+					break;
+				}
+				default:
+					break;
+			}
+			return *this;
+		}
 		this->file.seekg(offset, offsetFrom);
 		return *this;
 	}
@@ -91,6 +253,8 @@ public:
 		if (offsetFrom == std::ios::end) {
 			offset *= -1;
 		}
+		const FileStreamLatencyTimer timer{this->latencyHistograms, FileStreamLatencyHistograms::OP_SEEK, 0};
+		this->accessReadPosKnown = false;
 		this->file.seekp(offset, offsetFrom);
 		return *this;
 	}
@@ -104,12 +268,12 @@ public:
 		if (!n) {
 			return *this;
 		}
-		return this->seek_in(sizeof(T) * n, std::ios::cur);
+		return this->seek_in(static_cast<std::int64_t>(sizeof(T)) * n, std::ios::cur);
 	}
 
 	template<BufferStreamPODType T = std::byte>
 	FileStream& skip_in_u(std::uint64_t n = 1) {
-		return this->skip_in(static_cast<std::int64_t>(n));
+		return this->skip_in<T>(static_cast<std::int64_t>(n));
 	}
 
 	template<BufferStreamPODType T = std::byte>
@@ -117,15 +281,18 @@ public:
 		if (!n) {
 			return *this;
 		}
-		return this->seek_out(sizeof(T) * n, std::ios::cur);
+		return this->seek_out(static_cast<std::int64_t>(sizeof(T)) * n, std::ios::cur);
 	}
 
 	template<BufferStreamPODType T = std::byte>
 	FileStream& skip_out_u(std::uint64_t n = 1) {
-		return this->skip_out(static_cast<std::int64_t>(n));
+		return this->skip_out<T>(static_cast<std::int64_t>(n));
 	}
 
 	[[nodiscard]] std::uint64_t tell_in() {
+		if (this->blockCache) {
+			return this->blockCacheReadPos;
+		}
 		return this->file.tellg();
 	}
 
@@ -134,6 +301,13 @@ public:
 	}
 
 	[[nodiscard]] std::byte peek() {
+		if (this->blockCache) {
+			std::byte out{};
+			if (this->read_cached(&out, 1)) {
+				this->blockCacheReadPos--;
+			}
+			return out;
+		}
 		return static_cast<std::byte>(this->file.peek());
 	}
 
@@ -144,38 +318,8 @@ public:
 
 	template<BufferStreamPODType T>
 	FileStream& read(T& obj) {
-		this->file.read(reinterpret_cast<char*>(&obj), sizeof(T));
-		if constexpr (sizeof(T) > 1) {
-			if constexpr (std::endian::native == std::endian::little) {
-				if (this->bigEndian) {
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						BufferStream::swap_endian(&obj);
-					} else if constexpr (std::is_enum_v<T>) {
-						BufferStream::swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&obj));
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-				}
-			} else if constexpr (std::endian::native == std::endian::big) {
-				if (!this->bigEndian) {
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						BufferStream::swap_endian(&obj);
-					} else if constexpr (std::is_enum_v<T>) {
-						BufferStream::swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&obj));
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-				}
-			} else {
-				static_assert("Need to investigate what the proper endianness of this platform is!");
-			}
-		}
+		this->read_raw(&obj, sizeof(T));
+		BufferStream::convert_endian(&obj, 1, this->bigEndian, this->useExceptions);
 		return *this;
 	}
 
@@ -186,48 +330,7 @@ public:
 
 	template<BufferStreamPODType T>
 	FileStream& write(const T& obj) {
-		if constexpr (sizeof(T) > 1) {
-			if constexpr (std::endian::native == std::endian::little) {
-				if (this->bigEndian) {
-					T objCopy = obj;
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						BufferStream::swap_endian(&objCopy);
-					} else if constexpr (std::is_enum_v<T>) {
-						BufferStream::swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&objCopy));
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-					this->file.write(reinterpret_cast<const char*>(&objCopy), sizeof(T));
-				} else {
-					this->file.write(reinterpret_cast<const char*>(&obj), sizeof(T));
-				}
-			} else if constexpr (std::endian::native == std::endian::big) {
-				if (!this->bigEndian) {
-					T objCopy = obj;
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						BufferStream::swap_endian(&objCopy);
-					} else if constexpr (std::is_enum_v<T>) {
-						BufferStream::swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&objCopy));
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-					this->file.write(reinterpret_cast<const char*>(&objCopy), sizeof(T));
-				} else {
-					this->file.write(reinterpret_cast<const char*>(&obj), sizeof(T));
-				}
-			} else {
-				static_assert("Need to investigate what the proper endianness of this platform is!");
-			}
-		} else {
-			this->file.write(reinterpret_cast<const char*>(&obj), sizeof(T));
-		}
-		return *this;
+		return this->write(&obj, 1);
 	}
 
 	template<BufferStreamPODType T>
@@ -258,12 +361,7 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t M, std::uint64_t N>
 	FileStream& read(T(&obj)[M][N]) {
-		for (int i = 0; i < M; i++) {
-			for (int j = 0; j < N; j++) {
-				this->read(obj[i][j]);
-			}
-		}
-		return *this;
+		return this->read(&obj[0][0], M * N);
 	}
 
 	template<BufferStreamPODType T, std::uint64_t M, std::uint64_t N>
@@ -273,12 +371,7 @@ public:
 
 	template<BufferStreamPODType T, std::uint64_t M, std::uint64_t N>
 	FileStream& write(const T(&obj)[M][N]) {
-		for (int i = 0; i < M; i++) {
-			for (int j = 0; j < N; j++) {
-				this->write(obj[i][j]);
-			}
-		}
-		return *this;
+		return this->write(&obj[0][0], M * N);
 	}
 
 	template<BufferStreamPODType T, std::uint64_t M, std::uint64_t N>
@@ -286,6 +379,53 @@ public:
 		return this->write(obj);
 	}
 
+	/// Copies the region with the given layout, starting at the current read position, into out packed in row-major order.
+	/// Dense regions are read with one read and gathered in memory, sparse ones with one read per contiguous run.
+	/// The read position is left just past the last element of the region.
+	template<BufferStreamPODType T, std::uint64_t Extent, std::uint64_t Rank>
+	FileStream& read_strided(std::span<T, Extent> out, const BufferStreamStridedLayout<Rank>& layout) {
+		if (layout.overflows(sizeof(T))) {
+			if (this->useExceptions) {
+				BufferStreamThrow::overflow_read();
+			}
+			return *this;
+		}
+		if (out.size() < layout.size()) {
+			if (this->useExceptions) {
+				BufferStreamThrow::invalid_argument(BUFFERSTREAM_STRIDED_DESTINATION_ERROR_MESSAGE);
+			}
+			return *this;
+		}
+		const std::uint64_t spanSize = layout.required_span_size();
+		if (!spanSize) {
+			return *this;
+		}
+
+		if (spanSize / 2 <= layout.size()) {
+			std::vector<std::byte> region(sizeof(T) * spanSize);
+			this->read_raw(region.data(), region.size());
+			BufferStreamReadOnly stream{region};
+			stream.set_big_endian(this->bigEndian).set_exceptions_enabled(this->useExceptions).read_strided(out, layout);
+			return *this;
+		}
+
+		const auto start = this->tell_in();
+		auto* destination = reinterpret_cast<std::byte*>(out.data());
+		layout.for_each_run([this, start, destination](std::uint64_t sourceOffset, std::uint64_t destinationOffset, std::uint64_t count) {
+			this->seek_in_u(start + sourceOffset * sizeof(T));
+			this->read_raw(destination + destinationOffset * sizeof(T), count * sizeof(T));
+		});
+		this->seek_in_u(start + spanSize * sizeof(T));
+		BufferStream::convert_endian(out.data(), layout.size(), this->bigEndian, this->useExceptions);
+		return *this;
+	}
+
+	/// Copies a rows by columns block of a larger row-major matrix, starting at the current read position.
+	template<BufferStreamPODType T, std::uint64_t Extent>
+	FileStream& read_strided(std::span<T, Extent> out, std::uint64_t rows, std::uint64_t columns, std::uint64_t rowStride) {
+		return this->read_strided(out, BufferStreamStridedLayout<2>{{rows, columns}, {rowStride, 1}});
+	}
+
 	template<BufferStreamPODType T, std::uint64_t N>
 	FileStream& read(std::array<T, N>& obj) {
 		return this->read(obj.data(), obj.size());
@@ -313,9 +453,9 @@ public:
 			return *this;
 		}
 
-		if constexpr (BufferStreamPODByteType<typename T::value_type> && BufferStreamResizableContiguousContainer<T>) {
+		if constexpr (BufferStreamResizableContiguousContainer<T>) {
 			obj.resize(n);
-			this->file.read(reinterpret_cast<char*>(obj.data()), sizeof(typename T::value_type) * n);
+			this->read(obj.data(), n);
 		} else {
 			// BufferStreamPossiblyNonContiguousResizableContainer doesn't guarantee T::reserve(std::uint64_t) exists!
 			if constexpr (requires([[maybe_unused]] T& t) {
@@ -323,7 +463,7 @@ public:
 			}) {
 				obj.reserve(n);
 			}
-			for (int i = 0; i < n; i++) {
+			for (std::uint64_t i = 0; i < n; i++) {
 				obj.push_back(this->read<typename T::value_type>());
 			}
 		}
@@ -345,8 +485,8 @@ public:
 		if constexpr (BufferStreamNonResizableContiguousContainer<T> || BufferStreamResizableContiguousContainer<T>) {
 			this->write(obj.data(), obj.size());
 		} else {
-			for (int i = 0; i < obj.size(); i++) {
-				this->write(obj[i]);
+			for (const auto& value : obj) {
+				this->write(value);
 			}
 		}
 		return *this;
@@ -363,46 +503,8 @@ public:
 			return *this;
 		}
 
-		this->file.read(reinterpret_cast<char*>(obj), sizeof(T) * n);
-		if constexpr (sizeof(T) > 1) {
-			if constexpr (std::endian::native == std::endian::little) {
-				if (this->bigEndian) {
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						for (std::uint64_t i = 0; i < n; i++) {
-							BufferStream::swap_endian(&obj[i]);
-						}
-					} else if constexpr (std::is_enum_v<T>) {
-						for (std::uint64_t i = 0; i < n; i++) {
-							BufferStream::swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&obj[i]));
-						}
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-				}
-			} else if constexpr (std::endian::native == std::endian::big) {
-				if (!this->bigEndian) {
-					if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-						for (std::uint64_t i = 0; i < n; i++) {
-							BufferStream::swap_endian(&obj[i]);
-						}
-					} else if constexpr (std::is_enum_v<T>) {
-						for (std::uint64_t i = 0; i < n; i++) {
-							BufferStream::swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&obj[i]));
-						}
-					} else {
-						// Just don't swap the bytes...
-						if (this->useExceptions) {
-							throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-						}
-					}
-				}
-			} else {
-				static_assert("Need to investigate what the proper endianness of this platform is!");
-			}
-		}
+		this->read_raw(obj, sizeof(T) * n);
+		BufferStream::convert_endian(obj, n, this->bigEndian, this->useExceptions);
 		return *this;
 	}
 
@@ -412,50 +514,19 @@ public:
 			return *this;
 		}
 
-		if constexpr (sizeof(T) > 1) {
-			if constexpr (std::endian::native == std::endian::little) {
-				if (this->bigEndian) {
-					for (std::uint64_t i = 0; i < n; i++) {
-						T objCopy = obj[i];
-						if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-							BufferStream::swap_endian(&objCopy);
-						} else if constexpr (std::is_enum_v<T>) {
-							BufferStream::swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&objCopy));
-						} else {
-							// Just don't swap the bytes...
-							if (this->useExceptions) {
-								throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-							}
-						}
-						this->file.write(reinterpret_cast<const char*>(&objCopy), sizeof(T));
-					}
-				} else {
-					this->file.write(reinterpret_cast<const char*>(obj), sizeof(T) * n);
-				}
-			} else if constexpr (std::endian::native == std::endian::big) {
-				if (!this->bigEndian) {
-					for (std::uint64_t i = 0; i < n; i++) {
-						T objCopy = obj[i];
-						if constexpr (std::is_integral_v<T> || std::floating_point<T>) {
-							BufferStream::swap_endian(&objCopy);
-						} else if constexpr (std::is_enum_v<T>) {
-							BufferStream::swap_endian(reinterpret_cast<std::underlying_type_t<T>*>(&objCopy));
-						} else {
-							// Just don't swap the bytes...
-							if (this->useExceptions) {
-								throw std::invalid_argument{BUFFERSTREAM_BIG_ENDIAN_POD_TYPE_ERROR_MESSAGE};
-							}
-						}
-						this->file.write(reinterpret_cast<const char*>(&objCopy), sizeof(T));
-					}
-				} else {
-					this->file.write(reinterpret_cast<const char*>(obj), sizeof(T) * n);
-				}
-			} else {
-				static_assert("Need to investigate what the proper endianness of this platform is!");
-			}
-		} else {
-			this->file.write(reinterpret_cast<const char*>(obj), sizeof(T) * n);
+		if (sizeof(T) == 1 || this->bigEndian == (std::endian::native == std::endian::big)) {
+			this->write_raw(obj, sizeof(T) * n);
+			return *this;
+		}
+
+		// Swap a chunk at a time on the stack, the caller's data is never modified
+		constexpr std::uint64_t CHUNK_SIZE = std::max<std::uint64_t>(4096 / sizeof(T), 1);
+		alignas(T) std::byte chunk[CHUNK_SIZE * sizeof(T)];
+		for (std::uint64_t i = 0; i < n; i += CHUNK_SIZE) {
+			const std::uint64_t count = std::min(n - i, CHUNK_SIZE);
+			std::memcpy(chunk, obj + i, sizeof(T) * count);
+			BufferStream::convert_endian(reinterpret_cast<T*>(chunk), count, this->bigEndian, this->useExceptions);
+			this->write_raw(chunk, sizeof(T) * count);
 		}
 		return *this;
 	}
@@ -471,12 +542,7 @@ public:
 	}
 
 	FileStream& read(std::string& obj) {
-		obj.clear();
-		char temp = this->read<char>();
-		while (temp != '\0') {
-			obj += temp;
-			temp = this->read<char>();
-		}
+		this->read_string_into(obj);
 		return *this;
 	}
 
@@ -518,21 +584,7 @@ public:
 	}
 
 	FileStream& read(std::string& obj, std::uint64_t n, bool stopOnNullTerminator = true) {
-		obj.clear();
-		if (!n) {
-			return *this;
-		}
-
-		obj.reserve(n);
-		for (int i = 0; i < n; i++) {
-			char temp = this->read<char>();
-			if (temp == '\0' && stopOnNullTerminator) {
-				// Read the required number of characters and exit
-				this->skip_in_u<char>(n - i - 1);
-				break;
-			}
-			obj += temp;
-		}
+		this->read_string_into(obj, n, stopOnNullTerminator);
 		return *this;
 	}
 
@@ -557,6 +609,15 @@ public:
 		return obj;
 	}
 
+	/// Same as read<T>(n), with the container's storage coming from the given allocator.
+	/// For std::pmr containers, a std::pmr::memory_resource* can be passed directly.
+	template<BufferStreamPossiblyNonContiguousResizableContainer T>
+	[[nodiscard]] T read(std::uint64_t n, const typename T::allocator_type& allocator) {
+		T obj{allocator};
+		this->read(obj, n);
+		return obj;
+	}
+
 	[[nodiscard]] std::string read_string() {
 		std::string out;
 		this->read(out);
@@ -569,6 +630,18 @@ public:
 		return out;
 	}
 
+	[[nodiscard]] std::pmr::string read_string(const std::pmr::polymorphic_allocator<char>& allocator) {
+		std::pmr::string out{allocator};
+		this->read_string_into(out);
+		return out;
+	}
+
+	[[nodiscard]] std::pmr::string read_string(std::uint64_t n, bool stopOnNullTerminator, const std::pmr::polymorphic_allocator<char>& allocator) {
+		std::pmr::string out{allocator};
+		this->read_string_into(out, n, stopOnNullTerminator);
+		return out;
+	}
+
 	template<std::uint64_t L>
 	[[nodiscard]] std::array<std::byte, L> read_bytes() {
 		return this->read<std::array<std::byte, L>>();
@@ -580,12 +653,375 @@ public:
 		return out;
 	}
 
+	[[nodiscard]] std::pmr::vector<std::byte> read_bytes(std::uint64_t length, const std::pmr::polymorphic_allocator<std::byte>& allocator) {
+		return this->read<std::pmr::vector<std::byte>>(length, allocator);
+	}
+
+	/// Fills the given storage with the next bytes of the file.
+	FileStream& read_bytes_into(std::span<std::byte> out) {
+		return this->read(out.data(), out.size());
+	}
+
+	/// Reads into every segment in order with a single preadv call where available, then fixes the endianness of each segment.
+	FileStream& read_vectored(std::span<const FileStreamSegment> segments) {
+		std::uint64_t total = 0;
+		for (const auto& segment : segments) {
+			if (segment.readOnly) {
+				// Nothing is read at all, rather than reading into the segments before it
+				if (this->useExceptions) {
+					BufferStreamThrow::invalid_argument(FILESTREAM_READ_ONLY_SEGMENT_ERROR_MESSAGE);
+				}
+				return *this;
+			}
+			total += segment.size;
+		}
+		if (!total) {
+			return *this;
+		}
+
+		bool done = false;
+#ifdef BUFFERSTREAM_HAS_POSIX_IO
+		if (!this->blockCache && this->nativeFile.open(this->filePath, this->writable)) {
+			const FileStreamLatencyTimer timer{this->latencyHistograms, FileStreamLatencyHistograms::OP_READ, total};
+			if (this->accessHint != HINT_NONE) {
+				this->track_read(total);
+			}
+			this->file.flush();
+			const auto pos = this->file.tellg();
+			if (pos >= 0) {
+				std::vector<iovec> iov;
+				iov.reserve(segments.size());
+				for (const auto& segment : segments) {
+					iov.push_back({segment.data, static_cast<std::size_t>(segment.size)});
+				}
+				const auto transferred = transfer_vectored(iov, static_cast<std::uint64_t>(pos), false);
+				this->file.seekg(pos + static_cast<std::streamoff>(transferred));
+				if (transferred < total) {
+					this->file.setstate(std::ios::eofbit | std::ios::failbit);
+				}
+				done = true;
+			}
+		}
+#endif
+		if (!done) {
+			for (const auto& segment : segments) {
+				this->read_raw(segment.data, segment.size);
+			}
+		}
+
+		if (this->bigEndian != (std::endian::native == std::endian::big)) {
+			for (const auto& segment : segments) {
+				if (segment.swapEndian) {
+					segment.swapEndian(segment.data, segment.size);
+				} else if (segment.complex && this->useExceptions) {
+					BufferStreamThrow::big_endian_pod_type();
+				}
+			}
+		}
+		return *this;
+	}
+
+	FileStream& read_vectored(std::initializer_list<FileStreamSegment> segments) {
+		return this->read_vectored(std::span{segments.begin(), segments.size()});
+	}
+
+	FileStream& read_vectored(std::span<const std::span<std::byte>> buffers) {
+		std::vector<FileStreamSegment> segments{buffers.begin(), buffers.end()};
+		return this->read_vectored(std::span<const FileStreamSegment>{segments});
+	}
+
+	/// Writes every segment in order with a single pwritev call where available.
+	/// Segments that need their endianness changed are swapped in a copy, the caller's buffers are never modified.
+	FileStream& write_vectored(std::span<const FileStreamSegment> segments) {
+		const bool swap = this->bigEndian != (std::endian::native == std::endian::big);
+		std::uint64_t total = 0;
+		for (const auto& segment : segments) {
+			if (swap && segment.complex && this->useExceptions) {
+				BufferStreamThrow::big_endian_pod_type();
+			}
+			total += segment.size;
+		}
+		if (!total) {
+			return *this;
+		}
+
+		std::vector<std::vector<std::byte>> swapped;
+		std::vector<std::pair<const std::byte*, std::uint64_t>> buffers;
+		buffers.reserve(segments.size());
+		for (const auto& segment : segments) {
+			if (swap && segment.swapEndian) {
+				auto& copy = swapped.emplace_back(segment.data, segment.data + segment.size);
+				segment.swapEndian(copy.data(), copy.size());
+				buffers.emplace_back(copy.data(), copy.size());
+			} else {
+				buffers.emplace_back(segment.data, segment.size);
+			}
+		}
+
+#ifdef BUFFERSTREAM_HAS_POSIX_IO
+		if (this->nativeFile.open(this->filePath, this->writable)) {
+			const FileStreamLatencyTimer timer{this->latencyHistograms, FileStreamLatencyHistograms::OP_WRITE, total};
+			this->accessReadPosKnown = false;
+			this->file.flush();
+			std::streamoff pos = this->file.tellp();
+			if (pos >= 0 && this->appending) {
+				this->file.seekp(0, std::ios::end);
+				pos = this->file.tellp();
+			}
+			if (pos >= 0) {
+				std::vector<iovec> iov;
+				iov.reserve(buffers.size());
+				for (const auto& [data, size] : buffers) {
+					iov.push_back({const_cast<std::byte*>(data), static_cast<std::size_t>(size)});
+				}
+				const auto transferred = transfer_vectored(iov, static_cast<std::uint64_t>(pos), true);
+				this->file.seekp(pos + static_cast<std::streamoff>(transferred));
+				if (transferred < total) {
+					this->file.setstate(std::ios::badbit);
+				}
+				if (this->blockCache) {
+					for (auto offset = static_cast<std::uint64_t>(pos); const auto& [data, size] : buffers) {
+						this->blockCache->write(this->blockCacheFileID, offset, data, size);
+						offset += size;
+					}
+				}
+				return *this;
+			}
+		}
+#endif
+		for (const auto& [data, size] : buffers) {
+			this->write_raw(data, size);
+		}
+		return *this;
+	}
+
+	FileStream& write_vectored(std::initializer_list<FileStreamSegment> segments) {
+		return this->write_vectored(std::span{segments.begin(), segments.size()});
+	}
+
+	FileStream& write_vectored(std::span<const std::span<const std::byte>> buffers) {
+		std::vector<FileStreamSegment> segments{buffers.begin(), buffers.end()};
+		return this->write_vectored(std::span<const FileStreamSegment>{segments});
+	}
+
 	void flush() {
+		const FileStreamLatencyTimer timer{this->latencyHistograms, FileStreamLatencyHistograms::OP_FLUSH, 0};
 		this->file.flush();
 	}
 
 protected:
 	std::fstream file;
+	std::filesystem::path filePath;
+	bool writable;
+	bool appending;
+	bool truncated;
 	bool useExceptions;
 	bool bigEndian;
+	FileStreamLatencyHistograms* latencyHistograms;
+	std::shared_ptr<FileStreamBlockCache> blockCache;
+	std::uint64_t blockCacheFileID;
+	std::uint64_t blockCacheReadPos;
+	AccessHint accessHint;
+	FileStreamAccessPatternDetector accessDetector;
+	FileStreamNativeFile nativeFile;
+	std::uint64_t readaheadWindow;
+	std::uint64_t readaheadUntil;
+	std::uint64_t accessReadPos;
+	bool accessReadPosKnown;
+
+	void read_raw(void* data, std::uint64_t n) {
+		const FileStreamLatencyTimer timer{this->latencyHistograms, FileStreamLatencyHistograms::OP_READ, n};
+		if (this->accessHint != HINT_NONE) {
+			this->track_read(n);
+		}
+		if (this->blockCache) {
+			if (!this->read_cached(static_cast<std::byte*>(data), n)) {
+				this->file.setstate(std::ios::eofbit | std::ios::failbit);
+			}
+			return;
+		}
+		this->file.read(static_cast<char*>(data), static_cast<std::streamsize>(n));
+	}
+
+	void write_raw(const void* data, std::uint64_t n) {
+		const FileStreamLatencyTimer timer{this->latencyHistograms, FileStreamLatencyHistograms::OP_WRITE, n};
+		// std::fstream shares one position between reading and writing
+		this->accessReadPosKnown = false;
+		if (this->blockCache) {
+			const auto pos = this->file.tellp();
+			this->file.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+			if (pos >= 0) {
+				this->blockCache->write(this->blockCacheFileID, static_cast<std::uint64_t>(pos), static_cast<const std::byte*>(data), n);
+			}
+			return;
+		}
+		this->file.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+	}
+
+	/// Feeds the upcoming read into the access pattern detector and asks the kernel to prefetch what comes next.
+	void track_read(std::uint64_t n) {
+		std::uint64_t pos = this->accessReadPos;
+		if (this->blockCache) {
+			pos = this->blockCacheReadPos;
+		} else if (!this->accessReadPosKnown) {
+			const auto tell = this->file.tellg();
+			pos = tell < 0 ? 0 : static_cast<std::uint64_t>(tell);
+		}
+		this->accessReadPos = pos + n;
+		this->accessReadPosKnown = true;
+
+		if (this->accessHint == HINT_AUTO && this->accessDetector.record(pos, n)) {
+			this->readaheadUntil = 0;
+		}
+
+		switch (this->get_access_pattern()) {
+			case FileStreamAccessPatternDetector::PATTERN_SEQUENTIAL:
+				// The kernel already reads ahead of sequential reads on the stream's own descriptor,
+				// so only prefetch further when asked to. Top the window back up once half of it has been consumed
+				if (this->accessHint == HINT_SEQUENTIAL && pos + n + this->readaheadWindow / 2 > this->readaheadUntil) {
+					const std::uint64_t start = std::max(pos, this->readaheadUntil);
+					this->readaheadUntil = pos + n + this->readaheadWindow;
+					this->prefetch(start, this->readaheadUntil - start);
+				}
+				break;
+			case FileStreamAccessPatternDetector::PATTERN_STRIDED: {
+				// Prefetch the reads a few strides ahead
+				static constexpr std::uint64_t STRIDES_AHEAD = 8;
+				const std::int64_t stride = this->accessDetector.get_stride();
+				if (stride > 0) {
+					for (std::uint64_t i = 1; i <= STRIDES_AHEAD; i++) {
+						const std::uint64_t next = pos + i * stride;
+						if (next >= this->readaheadUntil) {
+							this->prefetch(next, n);
+							this->readaheadUntil = next + 1;
+						}
+					}
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	template<typename String>
+	void read_string_into(String& obj) {
+		obj.clear();
+		char temp = this->read<char>();
+		while (temp != '\0') {
+			obj += temp;
+			temp = this->read<char>();
+		}
+	}
+
+	/// Reads all n chars at once, then cuts the string short at the first null terminator if requested.
+	template<typename String>
+	void read_string_into(String& obj, std::uint64_t n, bool stopOnNullTerminator) {
+		obj.clear();
+		if (!n) {
+			return;
+		}
+
+		obj.resize(n);
+		this->read_raw(obj.data(), n);
+		if (stopOnNullTerminator) {
+			if (const auto* terminator = static_cast<const char*>(std::memchr(obj.data(), '\0', n))) {
+				obj.resize(terminator - obj.data());
+			}
+		}
+	}
+
+#ifdef BUFFERSTREAM_HAS_POSIX_IO
+	/// Reads or writes all of the given buffers at the given offset, resuming after partial transfers.
+	/// Returns the number of bytes transferred, which is only short at the end of the file or on an error.
+	std::uint64_t transfer_vectored(std::vector<iovec>& iov, std::uint64_t offset, bool write) {
+		std::uint64_t transferred = 0;
+		std::uint64_t first = 0;
+		while (first < iov.size()) {
+			const int count = static_cast<int>(std::min<std::uint64_t>(iov.size() - first, IOV_MAX));
+			const auto result = write
+					? ::pwritev(this->nativeFile.get(), iov.data() + first, count, static_cast<off_t>(offset + transferred))
+					: ::preadv(this->nativeFile.get(), iov.data() + first, count, static_cast<off_t>(offset + transferred));
+			if (result < 0 && errno == EINTR) {
+				continue;
+			}
+			if (result <= 0) {
+				break;
+			}
+			transferred += result;
+
+			// Skip past the buffers that were completed, and trim the one that was partially transferred
+			auto remaining = static_cast<std::uint64_t>(result);
+			while (first < iov.size() && remaining >= iov[first].iov_len) {
+				remaining -= iov[first].iov_len;
+				first++;
+			}
+			if (remaining) {
+				iov[first].iov_base = static_cast<std::byte*>(iov[first].iov_base) + remaining;
+				iov[first].iov_len -= remaining;
+			}
+		}
+		return transferred;
+	}
+#endif
+
+	/// Asks the kernel to read the given range into the page cache. Readahead policy is kept per descriptor, so only
+	/// this has any effect on the stream's own reads; the pages it brings in are shared by every descriptor.
+	void prefetch(std::uint64_t offset, std::uint64_t length) {
+		if (this->nativeFile.open(this->filePath, this->writable)) {
+			this->nativeFile.advise_will_need(offset, length);
+		}
+	}
+
+	/// Reads n bytes at the cached read position through the block cache, filling missing blocks from the file.
+	/// Returns false if the end of the file was reached first.
+	[[nodiscard]] bool read_cached(std::byte* data, std::uint64_t n) {
+		const std::uint64_t blockSize = this->blockCache->block_size();
+		while (n) {
+			const std::uint64_t blockIndex = this->blockCacheReadPos / blockSize;
+			const std::uint64_t offsetInBlock = this->blockCacheReadPos % blockSize;
+
+			auto copied = this->blockCache->read(this->blockCacheFileID, blockIndex, offsetInBlock, data, n);
+			if (!copied) {
+				std::vector<std::byte> block(blockSize);
+				const auto putPos = this->writable ? this->file.tellp() : std::fstream::pos_type{-1};
+				this->file.clear();
+				this->file.seekg(static_cast<std::streamoff>(blockIndex * blockSize));
+				this->file.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(blockSize));
+				block.resize(static_cast<std::uint64_t>(this->file.gcount()));
+				this->file.clear();
+				if (putPos >= 0) {
+					this->file.seekp(putPos);
+				}
+
+				copied = 0;
+				if (offsetInBlock < block.size()) {
+					copied = std::min(n, block.size() - offsetInBlock);
+					std::memcpy(data, block.data() + offsetInBlock, *copied);
+				}
+				this->blockCache->insert(this->blockCacheFileID, blockIndex, std::move(block));
+			}
+			if (!*copied) {
+				return false;
+			}
+
+			this->blockCacheReadPos += *copied;
+			data += *copied;
+			n -= *copied;
+		}
+		return true;
+	}
 };
+
+#define FILESTREAM_INSTANTIATE(PREFIX, T) \
+	PREFIX template FileStream& FileStream::read<T>(T&); \
+	PREFIX template FileStream& FileStream::write<T>(const T&); \
+	PREFIX template T FileStream::read<T>(); \
+	PREFIX template FileStream& FileStream::read<T>(T*, std::uint64_t); \
+	PREFIX template FileStream& FileStream::write<T>(const T*, std::uint64_t);
+
+#ifdef BUFFERSTREAM_COMPILED_INSTANTIATIONS
+#define FILESTREAM_EXTERN_INSTANTIATION(T) FILESTREAM_INSTANTIATE(extern, T)
+BUFFERSTREAM_COMMON_TYPES(FILESTREAM_EXTERN_INSTANTIATION)
+#undef FILESTREAM_EXTERN_INSTANTIATION
+#endif
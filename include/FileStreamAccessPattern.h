@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+
+#if __has_include(<fcntl.h>) && __has_include(<unistd.h>) && __has_include(<sys/uio.h>)
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define BUFFERSTREAM_HAS_POSIX_IO
+#endif
+
+/// Classifies a stream of reads as sequential, strided or random.
+/// A new pattern is only reported after it has been observed several reads in a row,
+/// so a single out-of-order read doesn't flip the classification back and forth.
+class FileStreamAccessPatternDetector {
+public:
+	enum Pattern {
+		PATTERN_UNKNOWN,
+		PATTERN_SEQUENTIAL,
+		PATTERN_STRIDED,
+		PATTERN_RANDOM,
+	};
+
+	static constexpr std::uint64_t CONFIRMATIONS = 4;
+
+	/// Records a read and returns true if it changed the detected pattern.
+	bool record(std::uint64_t offset, std::uint64_t size) {
+		Pattern observed = PATTERN_RANDOM;
+		std::int64_t distance = 0;
+		if (this->readCount) {
+			distance = static_cast<std::int64_t>(offset - this->lastOffset);
+			if (offset == this->lastOffset + this->lastSize) {
+				observed = PATTERN_SEQUENTIAL;
+			} else if (distance != 0 && distance == this->lastDistance) {
+				observed = PATTERN_STRIDED;
+			}
+		}
+		this->readCount++;
+		this->lastOffset = offset;
+		this->lastSize = size;
+		this->lastDistance = distance;
+
+		if (observed == this->candidate) {
+			this->candidateCount++;
+		} else {
+			this->candidate = observed;
+			this->candidateCount = 1;
+		}
+		if (this->candidateCount >= CONFIRMATIONS && this->candidate != this->pattern) {
+			this->pattern = this->candidate;
+			return true;
+		}
+		return false;
+	}
+
+	void reset() {
+		*this = {};
+	}
+
+	[[nodiscard]] Pattern get_pattern() const {
+		return this->pattern;
+	}
+
+	/// Distance between the starts of the last two reads, the stride when the pattern is strided.
+	[[nodiscard]] std::int64_t get_stride() const {
+		return this->lastDistance;
+	}
+
+private:
+	Pattern pattern = PATTERN_UNKNOWN;
+	Pattern candidate = PATTERN_UNKNOWN;
+	std::uint64_t candidateCount = 0;
+	std::uint64_t readCount = 0;
+	std::uint64_t lastOffset = 0;
+	std::uint64_t lastSize = 0;
+	std::int64_t lastDistance = 0;
+};
+
+/// A native file descriptor opened alongside a FileStream's std::fstream, for the operations
+/// std::fstream has no interface for. Does nothing on platforms without POSIX I/O.
+class FileStreamNativeFile {
+public:
+	FileStreamNativeFile() = default;
+
+	FileStreamNativeFile(const FileStreamNativeFile&) = delete;
+	FileStreamNativeFile& operator=(const FileStreamNativeFile&) = delete;
+
+	FileStreamNativeFile(FileStreamNativeFile&& other) noexcept
+			: fd(std::exchange(other.fd, -1)) {}
+
+	FileStreamNativeFile& operator=(FileStreamNativeFile&& other) noexcept {
+		if (this != &other) {
+			this->close();
+			this->fd = std::exchange(other.fd, -1);
+		}
+		return *this;
+	}
+
+	~FileStreamNativeFile() {
+		this->close();
+	}
+
+	/// Opens the file if it isn't open yet, returns false if it can't be.
+	bool open(const std::filesystem::path& path, bool writable) {
+#ifdef BUFFERSTREAM_HAS_POSIX_IO
+		if (this->fd < 0) {
+			this->fd = ::open(path.c_str(), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+		}
+#else
+		(void) path;
+		(void) writable;
+#endif
+		return this->fd >= 0;
+	}
+
+	void close() {
+#ifdef BUFFERSTREAM_HAS_POSIX_IO
+		if (this->fd >= 0) {
+			::close(this->fd);
+		}
+#endif
+		this->fd = -1;
+	}
+
+	[[nodiscard]] int get() const {
+		return this->fd;
+	}
+
+	/// Asks the kernel to start reading the given range into the page cache.
+	void advise_will_need(std::uint64_t offset, std::uint64_t length) const {
+#if defined(BUFFERSTREAM_HAS_POSIX_IO) && defined(POSIX_FADV_WILLNEED)
+		if (this->fd >= 0) {
+			::posix_fadvise(this->fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+		}
+#else
+		(void) offset;
+		(void) length;
+#endif
+	}
+
+private:
+	int fd = -1;
+};
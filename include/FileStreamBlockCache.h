@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// A user-space cache of aligned file blocks, shared by any number of FileStream instances.
+/// The cache is split into shards, each with its own lock and CLOCK eviction, so streams on
+/// different threads rarely contend. Writes through a FileStream are written through to the
+/// file and update the cached copy of the blocks they touch.
+///
+/// Blocks are kept by path, and outlive the streams that read them. Writes that bypass the cache,
+/// from a stream without it or from outside the process, leave its copies stale until the file's
+/// blocks are dropped with invalidate(). A stream that truncates its file on opening does that itself.
+class FileStreamBlockCache {
+public:
+	struct Stats {
+		std::uint64_t hits;
+		std::uint64_t misses;
+		std::uint64_t evictions;
+	};
+
+	static constexpr std::uint64_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+	static constexpr std::uint64_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+	static constexpr std::uint64_t DEFAULT_SHARD_COUNT = 16;
+
+	explicit FileStreamBlockCache(std::uint64_t capacity = DEFAULT_CAPACITY, std::uint64_t blockSize_ = DEFAULT_BLOCK_SIZE, std::uint64_t shardCount = DEFAULT_SHARD_COUNT)
+			: blockSize(blockSize_ ? blockSize_ : DEFAULT_BLOCK_SIZE)
+			, shards(shardCount ? shardCount : 1) {
+		const std::uint64_t blocksPerShard = std::max<std::uint64_t>(capacity / this->blockSize / this->shards.size(), 1);
+		for (auto& shard : this->shards) {
+			shard.slots.resize(blocksPerShard);
+		}
+	}
+
+	FileStreamBlockCache(const FileStreamBlockCache&) = delete;
+	FileStreamBlockCache& operator=(const FileStreamBlockCache&) = delete;
+
+	[[nodiscard]] std::uint64_t block_size() const {
+		return this->blockSize;
+	}
+
+	/// Returns the ID blocks of the given file are cached under. Every path to the same file gets the same ID.
+	[[nodiscard]] std::uint64_t register_file(const std::filesystem::path& path) {
+		std::error_code ec;
+		auto canonical = std::filesystem::weakly_canonical(path, ec);
+		if (ec) {
+			canonical = std::filesystem::absolute(path);
+		}
+
+		const std::scoped_lock lock{this->filesMutex};
+		const auto [it, inserted] = this->files.try_emplace(canonical.string(), this->files.size());
+		return it->second;
+	}
+
+	/// Copies up to n bytes at the given offset within a cached block.
+	/// Returns the number of bytes copied (less than n if the block is the short last block of the file), or nothing on a miss.
+	[[nodiscard]] std::optional<std::uint64_t> read(std::uint64_t fileId, std::uint64_t blockIndex, std::uint64_t offsetInBlock, std::byte* out, std::uint64_t n) {
+		auto& shard = this->get_shard(fileId, blockIndex);
+		const std::scoped_lock lock{shard.mutex};
+		const auto it = shard.index.find({fileId, blockIndex});
+		if (it == shard.index.end()) {
+			this->misses.fetch_add(1, std::memory_order_relaxed);
+			return std::nullopt;
+		}
+		this->hits.fetch_add(1, std::memory_order_relaxed);
+
+		auto& slot = shard.slots[it->second];
+		slot.referenced = true;
+		if (offsetInBlock >= slot.data.size()) {
+			return 0;
+		}
+		n = std::min(n, slot.data.size() - offsetInBlock);
+		std::memcpy(out, slot.data.data() + offsetInBlock, n);
+		return n;
+	}
+
+	/// Adds a block read from the file. Blocks shorter than the block size mark the end of the file.
+	void insert(std::uint64_t fileId, std::uint64_t blockIndex, std::vector<std::byte> data) {
+		if (data.size() < this->blockSize) {
+			const std::uint64_t end = blockIndex * this->blockSize + data.size();
+			const std::scoped_lock lock{this->filesMutex};
+			const auto [it, inserted] = this->cachedEnds.try_emplace(fileId, end);
+			it->second = std::min(it->second, end);
+		}
+
+		auto& shard = this->get_shard(fileId, blockIndex);
+		const std::scoped_lock lock{shard.mutex};
+		if (const auto it = shard.index.find({fileId, blockIndex}); it != shard.index.end()) {
+			shard.slots[it->second].data = std::move(data);
+			return;
+		}
+
+		// CLOCK: sweep past recently referenced slots, giving each a second chance
+		for (;;) {
+			auto& slot = shard.slots[shard.hand];
+			if (!slot.used || !slot.referenced) {
+				break;
+			}
+			slot.referenced = false;
+			shard.hand = (shard.hand + 1) % shard.slots.size();
+		}
+
+		auto& slot = shard.slots[shard.hand];
+		if (slot.used) {
+			shard.index.erase(slot.key);
+			this->evictions.fetch_add(1, std::memory_order_relaxed);
+		}
+		slot.key = {fileId, blockIndex};
+		slot.data = std::move(data);
+		slot.used = true;
+		slot.referenced = true;
+		shard.index[slot.key] = shard.hand;
+		shard.hand = (shard.hand + 1) % shard.slots.size();
+	}
+
+	/// Applies a write to any cached blocks it touches. Blocks the write would grow are dropped
+	/// instead, so they're reread from the file next time. If the write ends past the end of the file
+	/// as a short cached block has it, every short block of the file is dropped too, since the file
+	/// no longer ends where they say it does.
+	void write(std::uint64_t fileId, std::uint64_t offset, const std::byte* data, std::uint64_t n) {
+		bool grows = false;
+		{
+			const std::scoped_lock lock{this->filesMutex};
+			if (const auto it = this->cachedEnds.find(fileId); it != this->cachedEnds.end() && offset + n > it->second) {
+				this->cachedEnds.erase(it);
+				grows = true;
+			}
+		}
+		if (grows) {
+			this->drop_blocks(fileId, true);
+		}
+
+		while (n) {
+			const std::uint64_t blockIndex = offset / this->blockSize;
+			const std::uint64_t offsetInBlock = offset % this->blockSize;
+			const std::uint64_t count = std::min(n, this->blockSize - offsetInBlock);
+
+			auto& shard = this->get_shard(fileId, blockIndex);
+			{
+				const std::scoped_lock lock{shard.mutex};
+				if (const auto it = shard.index.find({fileId, blockIndex}); it != shard.index.end()) {
+					auto& slot = shard.slots[it->second];
+					if (offsetInBlock + count <= slot.data.size()) {
+						std::memcpy(slot.data.data() + offsetInBlock, data, count);
+					} else {
+						shard.index.erase(it);
+						slot = {};
+					}
+				}
+			}
+
+			offset += count;
+			data += count;
+			n -= count;
+		}
+	}
+
+	/// Drops every cached block of the given file.
+	void invalidate(std::uint64_t fileId) {
+		{
+			const std::scoped_lock lock{this->filesMutex};
+			this->cachedEnds.erase(fileId);
+		}
+		this->drop_blocks(fileId, false);
+	}
+
+	[[nodiscard]] Stats stats() const {
+		return {
+			this->hits.load(std::memory_order_relaxed),
+			this->misses.load(std::memory_order_relaxed),
+			this->evictions.load(std::memory_order_relaxed),
+		};
+	}
+
+private:
+	struct Key {
+		std::uint64_t fileId;
+		std::uint64_t blockIndex;
+
+		[[nodiscard]] bool operator==(const Key&) const = default;
+	};
+
+	struct KeyHash {
+		[[nodiscard]] std::size_t operator()(const Key& key) const {
+			return static_cast<std::size_t>(mix(key.fileId * 0x9E3779B97F4A7C15ull ^ key.blockIndex));
+		}
+	};
+
+	struct Slot {
+		Key key{};
+		std::vector<std::byte> data;
+		bool used = false;
+		bool referenced = false;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+		std::vector<Slot> slots;
+		std::unordered_map<Key, std::uint64_t, KeyHash> index;
+		std::uint64_t hand = 0;
+	};
+
+	[[nodiscard]] static constexpr std::uint64_t mix(std::uint64_t x) {
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	/// Drops the given file's cached blocks, or only those shorter than the block size.
+	void drop_blocks(std::uint64_t fileId, bool shortOnly) {
+		for (auto& shard : this->shards) {
+			const std::scoped_lock lock{shard.mutex};
+			for (auto& slot : shard.slots) {
+				if (slot.used && slot.key.fileId == fileId && (!shortOnly || slot.data.size() < this->blockSize)) {
+					shard.index.erase(slot.key);
+					slot = {};
+				}
+			}
+		}
+	}
+
+	[[nodiscard]] Shard& get_shard(std::uint64_t fileId, std::uint64_t blockIndex) {
+		return this->shards[mix(fileId ^ (blockIndex * 0x9E3779B97F4A7C15ull)) % this->shards.size()];
+	}
+
+	std::uint64_t blockSize;
+	std::vector<Shard> shards;
+
+	std::mutex filesMutex;
+	std::unordered_map<std::string, std::uint64_t> files;
+	/// For files with short blocks cached, the smallest end of the file any of them marks.
+	std::unordered_map<std::uint64_t, std::uint64_t> cachedEnds;
+
+	std::atomic<std::uint64_t> hits{0};
+	std::atomic<std::uint64_t> misses{0};
+	std::atomic<std::uint64_t> evictions{0};
+};
@@ -0,0 +1,682 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "BufferStreamBits.h"
+#include "FileStream.h"
+
+constexpr auto FILESTREAM_COLUMNAR_TYPE_ERROR_MESSAGE = "Column doesn't hold values of this type!";
+constexpr auto FILESTREAM_COLUMNAR_INDEX_ERROR_MESSAGE = "Column or row group index is out of range!";
+constexpr auto FILESTREAM_COLUMNAR_ROW_COUNT_ERROR_MESSAGE = "Every column must have the same number of rows!";
+constexpr auto FILESTREAM_COLUMNAR_CORRUPT_CHUNK_ERROR_MESSAGE = "Column chunk is corrupt!";
+
+/// The value types a columnar file can hold.
+template<typename T>
+concept FileStreamColumnarType = std::is_same_v<T, std::int32_t> || std::is_same_v<T, std::int64_t> || std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+/// The layout of a columnar file, all little-endian:
+/// - Header: magic, version (u16), reserved (u16)
+/// - Row groups: a chunk per column, each encoded on its own
+/// - Metadata: column count (u32), then each column's type (u32), name length (u32) and name; row group count (u64),
+///   then each row group's row count (u64) followed by, for each column, its chunk's file offset (u64), size (u64),
+///   encoding (u32), and smallest and largest value (u64 each)
+/// - Trailer: metadata offset (u64), magic
+/// Readers go from the trailer to the metadata, and from there only to the chunks they want.
+///
+/// Each chunk takes whichever of these encodings comes out smallest:
+/// - Plain: the values as they are
+/// - Dictionary: the distinct values (u32 count, then the values), then each value's index, bit packed
+/// - Delta: integers only; the first value (i64) and smallest step between neighbours (i64), then each step
+///   above the smallest, bit packed
+/// - Bit packed: integers only; the smallest value (i64), then each value above it, bit packed
+/// Bit packed fields are a width (u8), then the fields most significant bit first, as BufferStreamBitWriter writes them.
+struct FileStreamColumnarFormat {
+	static constexpr std::array<std::byte, 4> MAGIC{std::byte{'B'}, std::byte{'S'}, std::byte{'C'}, std::byte{'F'}};
+	static constexpr std::uint16_t VERSION = 1;
+	static constexpr std::uint64_t HEADER_SIZE = 8;
+	static constexpr std::uint64_t TRAILER_SIZE = 12;
+	static constexpr std::uint64_t CHUNK_ENTRY_SIZE = 36;
+	static constexpr std::uint64_t DEFAULT_ROW_GROUP_SIZE = 64 * 1024;
+	/// The most rows a row group can have. Chunks of equal values decode to any number of rows from a few bytes,
+	/// so this is what bounds the memory a reader allocates for an untrusted file.
+	static constexpr std::uint64_t MAX_ROW_GROUP_SIZE = 1 << 24;
+	/// Chunks with more distinct values than this aren't dictionary encoded.
+	static constexpr std::uint64_t MAX_DICTIONARY_SIZE = 1 << 12;
+
+	enum Type {
+		TYPE_INT32,
+		TYPE_INT64,
+		TYPE_FLOAT,
+		TYPE_DOUBLE,
+		TYPE_COUNT,
+	};
+
+	enum Encoding {
+		ENCODING_PLAIN,
+		ENCODING_DICTIONARY,
+		ENCODING_DELTA,
+		ENCODING_BIT_PACKED,
+		ENCODING_COUNT,
+	};
+
+	struct Column {
+		std::string name;
+		Type type;
+	};
+
+	struct Chunk {
+		std::uint64_t offset;
+		std::uint64_t size;
+		Encoding encoding;
+		/// The bits of the smallest and largest value, as an int64 for integer columns and a double for floating point ones.
+		/// NaNs are left out, and a chunk of nothing but NaNs has NaN for both.
+		std::uint64_t min;
+		std::uint64_t max;
+	};
+
+	struct RowGroup {
+		std::uint64_t rows;
+		std::vector<Chunk> chunks;
+	};
+
+	/// What the statistics of a T column are kept as.
+	template<FileStreamColumnarType T>
+	using Statistic = std::conditional_t<std::is_integral_v<T>, std::int64_t, double>;
+
+	template<FileStreamColumnarType T>
+	[[nodiscard]] static constexpr Type type_of() {
+		if constexpr (std::is_same_v<T, std::int32_t>) {
+			return TYPE_INT32;
+		} else if constexpr (std::is_same_v<T, std::int64_t>) {
+			return TYPE_INT64;
+		} else if constexpr (std::is_same_v<T, float>) {
+			return TYPE_FLOAT;
+		} else {
+			return TYPE_DOUBLE;
+		}
+	}
+
+	[[nodiscard]] static constexpr std::uint64_t width(Type type) {
+		return type == TYPE_INT32 || type == TYPE_FLOAT ? 4 : 8;
+	}
+
+	static void write_header(FileStream& file) {
+		file.write(MAGIC);
+		file.write(VERSION).write(std::uint16_t{0});
+	}
+
+	static void write_metadata(FileStream& file, const std::vector<Column>& columns, const std::vector<RowGroup>& rowGroups, std::uint64_t metadataOffset) {
+		file.write(static_cast<std::uint32_t>(columns.size()));
+		for (const auto& column : columns) {
+			file.write(static_cast<std::uint32_t>(column.type)).write(static_cast<std::uint32_t>(column.name.size())).write(column.name, false);
+		}
+		file.write(static_cast<std::uint64_t>(rowGroups.size()));
+		for (const auto& rowGroup : rowGroups) {
+			file.write(rowGroup.rows);
+			for (const auto& chunk : rowGroup.chunks) {
+				file.write(chunk.offset).write(chunk.size).write(static_cast<std::uint32_t>(chunk.encoding)).write(chunk.min).write(chunk.max);
+			}
+		}
+		file.write(metadataOffset);
+		file.write(MAGIC);
+	}
+
+	/// Encodes values into out, replacing what was there, and fills in the chunk's encoding and statistics.
+	template<FileStreamColumnarType T>
+	static void encode_chunk(std::span<const T> values, std::vector<std::byte>& out, Chunk& chunk) {
+		using Bits = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+		const std::uint64_t n = values.size();
+
+		Statistic<T> low = std::numeric_limits<Statistic<T>>::max();
+		Statistic<T> high = std::numeric_limits<Statistic<T>>::lowest();
+		for (const T value : values) {
+			if constexpr (std::is_floating_point_v<T>) {
+				if (std::isnan(value)) {
+					continue;
+				}
+			}
+			low = std::min<Statistic<T>>(low, value);
+			high = std::max<Statistic<T>>(high, value);
+		}
+		if (low > high) {
+			low = high = std::is_integral_v<T> ? Statistic<T>{0} : std::numeric_limits<Statistic<T>>::quiet_NaN();
+		}
+		chunk.min = std::bit_cast<std::uint64_t>(low);
+		chunk.max = std::bit_cast<std::uint64_t>(high);
+
+		// Size up every encoding that applies, and keep the smallest
+		chunk.encoding = ENCODING_PLAIN;
+		std::uint64_t best = n * sizeof(T);
+		auto consider = [&best, &chunk](Encoding encoding, std::uint64_t size) {
+			if (size < best) {
+				best = size;
+				chunk.encoding = encoding;
+			}
+		};
+
+		std::uint32_t offsetWidth = 0;
+		std::uint32_t stepWidth = 0;
+		std::int64_t smallestStep = 0;
+		if constexpr (std::is_integral_v<T>) {
+			offsetWidth = std::bit_width(static_cast<std::uint64_t>(high) - static_cast<std::uint64_t>(low));
+			consider(ENCODING_BIT_PACKED, 9 + packed_size(n, offsetWidth));
+			if (n > 1) {
+				std::int64_t largestStep = std::numeric_limits<std::int64_t>::lowest();
+				smallestStep = std::numeric_limits<std::int64_t>::max();
+				for (std::uint64_t i = 1; i < n; i++) {
+					const std::int64_t step = step_at(values, i);
+					smallestStep = std::min(smallestStep, step);
+					largestStep = std::max(largestStep, step);
+				}
+				stepWidth = std::bit_width(static_cast<std::uint64_t>(largestStep) - static_cast<std::uint64_t>(smallestStep));
+				consider(ENCODING_DELTA, 17 + packed_size(n - 1, stepWidth));
+			}
+		}
+
+		// Indices by bit pattern, so NaNs and negative zeros get entries of their own
+		std::unordered_map<Bits, std::uint32_t> indices;
+		std::vector<T> dictionary;
+		for (const T value : values) {
+			if (indices.try_emplace(std::bit_cast<Bits>(value), static_cast<std::uint32_t>(dictionary.size())).second) {
+				dictionary.push_back(value);
+				if (dictionary.size() > MAX_DICTIONARY_SIZE) {
+					break;
+				}
+			}
+		}
+		const auto indexWidth = static_cast<std::uint32_t>(std::bit_width(std::max<std::uint64_t>(dictionary.size(), 1) - 1));
+		if (dictionary.size() <= MAX_DICTIONARY_SIZE) {
+			consider(ENCODING_DICTIONARY, 5 + dictionary.size() * sizeof(T) + packed_size(n, indexWidth));
+		}
+
+		out.clear();
+		BufferStream stream{out};
+		switch (chunk.encoding) {
+			case ENCODING_PLAIN:
+				stream.write(values.data(), n);
+				break;
+			case ENCODING_DICTIONARY: {
+				stream.write(static_cast<std::uint32_t>(dictionary.size())).write(dictionary.data(), dictionary.size());
+				stream.write(static_cast<std::uint8_t>(indexWidth));
+				BufferStreamBitWriter bits{stream};
+				for (const T value : values) {
+					bits.write(indices[std::bit_cast<Bits>(value)], indexWidth);
+				}
+				bits.flush();
+				break;
+			}
+			case ENCODING_DELTA: {
+				stream.write(static_cast<std::int64_t>(values[0])).write(smallestStep).write(static_cast<std::uint8_t>(stepWidth));
+				BufferStreamBitWriter bits{stream};
+				for (std::uint64_t i = 1; i < n; i++) {
+					bits.write(static_cast<std::uint64_t>(step_at(values, i)) - static_cast<std::uint64_t>(smallestStep), stepWidth);
+				}
+				bits.flush();
+				break;
+			}
+			case ENCODING_BIT_PACKED: {
+				stream.write(static_cast<std::int64_t>(low)).write(static_cast<std::uint8_t>(offsetWidth));
+				BufferStreamBitWriter bits{stream};
+				for (const T value : values) {
+					bits.write(static_cast<std::uint64_t>(static_cast<std::int64_t>(value)) - static_cast<std::uint64_t>(low), offsetWidth);
+				}
+				bits.flush();
+				break;
+			}
+			default:
+				break;
+		}
+		out.resize(stream.tell());
+	}
+
+	/// Decodes a chunk of out.size() values. Chunks are untrusted: returns false if in doesn't hold a valid one.
+	template<FileStreamColumnarType T>
+	[[nodiscard]] static bool decode_chunk(Encoding encoding, std::span<const std::byte> in, std::span<T> out) {
+		BufferStreamReadOnly stream{in.data(), in.size()};
+		try {
+			switch (encoding) {
+				case ENCODING_PLAIN:
+					if (in.size() / sizeof(T) < out.size()) {
+						return false;
+					}
+					stream.read(out.data(), out.size());
+					return true;
+				case ENCODING_DICTIONARY: {
+					const auto size = stream.read<std::uint32_t>();
+					if (size > MAX_DICTIONARY_SIZE || size > in.size() / sizeof(T) || (!size && !out.empty())) {
+						return false;
+					}
+					std::vector<T> dictionary(size);
+					stream.read(dictionary.data(), size);
+					const auto width = stream.read<std::uint8_t>();
+					if (width > 32) {
+						return false;
+					}
+					BufferStreamBitReader bits{stream};
+					for (T& value : out) {
+						const std::uint64_t index = bits.read_long(width);
+						if (index >= size) {
+							return false;
+						}
+						value = dictionary[index];
+					}
+					return true;
+				}
+				case ENCODING_DELTA:
+				case ENCODING_BIT_PACKED: {
+					if constexpr (std::is_integral_v<T>) {
+						const bool delta = encoding == ENCODING_DELTA;
+						const auto base = static_cast<std::uint64_t>(stream.read<std::int64_t>());
+						const auto step = delta ? static_cast<std::uint64_t>(stream.read<std::int64_t>()) : 0;
+						const auto width = stream.read<std::uint8_t>();
+						if (width > 64) {
+							return false;
+						}
+						BufferStreamBitReader bits{stream};
+						std::uint64_t value = base;
+						for (std::uint64_t i = 0; i < out.size(); i++) {
+							if (delta) {
+								if (i) {
+									value += step + bits.read_long(width);
+								}
+							} else {
+								value = base + bits.read_long(width);
+							}
+							out[i] = static_cast<T>(static_cast<std::int64_t>(value));
+						}
+						return true;
+					}
+					return false;
+				}
+				default:
+					return false;
+			}
+		} catch (const std::overflow_error&) {
+			return false;
+		}
+	}
+
+private:
+	[[nodiscard]] static constexpr std::uint64_t packed_size(std::uint64_t n, std::uint32_t width) {
+		return 1 + (n / 8 * width + (n % 8 * width + 7) / 8);
+	}
+
+	/// values[i] - values[i - 1], which can't overflow for 32-bit values and wraps for 64-bit ones.
+	template<FileStreamColumnarType T>
+	[[nodiscard]] static std::int64_t step_at(std::span<const T> values, std::uint64_t i) {
+		return static_cast<std::int64_t>(static_cast<std::uint64_t>(static_cast<std::int64_t>(values[i])) - static_cast<std::uint64_t>(static_cast<std::int64_t>(values[i - 1])));
+	}
+};
+
+/// Writes a columnar file. Values are appended to each column separately, and whenever every column has
+/// a row group's worth, those rows are encoded a column chunk at a time and written out.
+/// The metadata is written by finish(), or by the destructor if finish() wasn't called.
+class FileStreamColumnarWriter {
+public:
+	explicit FileStreamColumnarWriter(const std::string& path, std::vector<FileStreamColumnarFormat::Column> columns_, std::uint64_t rowGroupSize_ = FileStreamColumnarFormat::DEFAULT_ROW_GROUP_SIZE)
+			: file(path, FileStream::OPT_WRITE | FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT)
+			, columns(std::move(columns_))
+			, rowGroupSize(std::clamp<std::uint64_t>(rowGroupSize_, 1, FileStreamColumnarFormat::MAX_ROW_GROUP_SIZE))
+			, pending(this->columns.size())
+			, consumed(this->columns.size())
+			, finished(false) {
+		FileStreamColumnarFormat::write_header(this->file);
+	}
+
+	FileStreamColumnarWriter(const FileStreamColumnarWriter&) = delete;
+	FileStreamColumnarWriter& operator=(const FileStreamColumnarWriter&) = delete;
+
+	~FileStreamColumnarWriter() {
+		try {
+			this->finish();
+		} catch (...) {}
+	}
+
+	[[nodiscard]] explicit operator bool() const {
+		return static_cast<bool>(this->file);
+	}
+
+	/// Appends values to the end of a column.
+	template<FileStreamColumnarType T>
+	FileStreamColumnarWriter& write(std::uint64_t column, std::span<const T> values) {
+		if (column >= this->columns.size()) {
+			BufferStreamThrow::invalid_argument(FILESTREAM_COLUMNAR_INDEX_ERROR_MESSAGE);
+		}
+		if (this->columns[column].type != FileStreamColumnarFormat::type_of<T>()) {
+			BufferStreamThrow::invalid_argument(FILESTREAM_COLUMNAR_TYPE_ERROR_MESSAGE);
+		}
+		const auto* bytes = reinterpret_cast<const std::byte*>(values.data());
+		this->pending[column].insert(this->pending[column].end(), bytes, bytes + values.size_bytes());
+		while (this->pending_rows() >= this->rowGroupSize) {
+			this->write_row_group(this->rowGroupSize);
+		}
+		return *this;
+	}
+
+	/// The number of row groups written so far.
+	[[nodiscard]] std::uint64_t row_group_count() const {
+		return this->rowGroups.size();
+	}
+
+	/// Writes the rows left over as a last, smaller row group, then the metadata. Nothing can be written afterwards.
+	/// Every column must have had the same number of values written to it.
+	void finish() {
+		if (this->finished) {
+			return;
+		}
+		this->finished = true;
+		const std::uint64_t rows = this->pending_rows();
+		for (std::uint64_t column = 0; column < this->columns.size(); column++) {
+			if (this->pending[column].size() - this->consumed[column] != rows * FileStreamColumnarFormat::width(this->columns[column].type)) {
+				BufferStreamThrow::invalid_argument(FILESTREAM_COLUMNAR_ROW_COUNT_ERROR_MESSAGE);
+			}
+		}
+		if (rows) {
+			this->write_row_group(rows);
+		}
+		FileStreamColumnarFormat::write_metadata(this->file, this->columns, this->rowGroups, this->file.tell_out());
+		this->file.flush();
+	}
+
+protected:
+	/// How many rows every column has waiting.
+	[[nodiscard]] std::uint64_t pending_rows() const {
+		std::uint64_t rows = UINT64_MAX;
+		for (std::uint64_t column = 0; column < this->columns.size(); column++) {
+			rows = std::min(rows, (this->pending[column].size() - this->consumed[column]) / FileStreamColumnarFormat::width(this->columns[column].type));
+		}
+		return this->columns.empty() ? 0 : rows;
+	}
+
+	void write_row_group(std::uint64_t rows) {
+		auto& rowGroup = this->rowGroups.emplace_back();
+		rowGroup.rows = rows;
+		for (std::uint64_t column = 0; column < this->columns.size(); column++) {
+			switch (this->columns[column].type) {
+				case FileStreamColumnarFormat::TYPE_INT32:  rowGroup.chunks.push_back(this->write_chunk<std::int32_t>(column, rows)); break;
+				case FileStreamColumnarFormat::TYPE_INT64:  rowGroup.chunks.push_back(this->write_chunk<std::int64_t>(column, rows)); break;
+				case FileStreamColumnarFormat::TYPE_FLOAT:  rowGroup.chunks.push_back(this->write_chunk<float>(column, rows)); break;
+				case FileStreamColumnarFormat::TYPE_DOUBLE: rowGroup.chunks.push_back(this->write_chunk<double>(column, rows)); break;
+				default: break;
+			}
+		}
+	}
+
+	/// Encodes and writes the column's first rows, and drops them from what's pending.
+	template<FileStreamColumnarType T>
+	FileStreamColumnarFormat::Chunk write_chunk(std::uint64_t column, std::uint64_t rows) {
+		auto& bytes = this->pending[column];
+		auto& start = this->consumed[column];
+		std::vector<T> values(rows);
+		std::memcpy(values.data(), bytes.data() + start, rows * sizeof(T));
+		start += rows * sizeof(T);
+		// Drop the rows written once they're half of what's held, so a column written all at once isn't moved for every row group
+		if (start * 2 >= bytes.size()) {
+			bytes.erase(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(start));
+			start = 0;
+		}
+
+		FileStreamColumnarFormat::Chunk chunk{};
+		FileStreamColumnarFormat::encode_chunk<T>(values, this->encoded, chunk);
+		chunk.offset = this->file.tell_out();
+		chunk.size = this->encoded.size();
+		this->file.write(this->encoded.data(), this->encoded.size());
+		return chunk;
+	}
+
+	FileStream file;
+	std::vector<FileStreamColumnarFormat::Column> columns;
+	std::uint64_t rowGroupSize;
+	/// The raw values of each column not yet in a row group, from the consumed byte on.
+	std::vector<std::vector<std::byte>> pending;
+	std::vector<std::uint64_t> consumed;
+	std::vector<FileStreamColumnarFormat::RowGroup> rowGroups;
+	std::vector<std::byte> encoded;
+	bool finished;
+};
+
+/// Reads a columnar file a column chunk at a time. Only the metadata is read up front, so a reader that
+/// wants two columns out of twenty reads a tenth of the file, and row groups whose statistics rule them
+/// out of a query don't have to be read at all.
+class FileStreamColumnarReader {
+public:
+	explicit FileStreamColumnarReader(const std::string& path)
+			: file(path)
+			, rows(0)
+			, chunksRead(0)
+			, valid(false)
+			, useExceptions(true) {
+		this->valid = this->read_metadata();
+		if (!this->valid) {
+			this->columns_.clear();
+			this->rowGroups.clear();
+			this->rows = 0;
+		}
+	}
+
+	/// False if the file couldn't be opened or isn't a valid columnar file.
+	[[nodiscard]] explicit operator bool() const {
+		return this->valid;
+	}
+
+	[[nodiscard]] bool are_exceptions_enabled() const {
+		return this->useExceptions;
+	}
+
+	FileStreamColumnarReader& set_exceptions_enabled(bool exceptions) {
+		this->useExceptions = exceptions;
+		return *this;
+	}
+
+	[[nodiscard]] const std::vector<FileStreamColumnarFormat::Column>& columns() const {
+		return this->columns_;
+	}
+
+	/// The index of the column with the given name.
+	[[nodiscard]] std::optional<std::uint64_t> find_column(std::string_view name) const {
+		for (std::uint64_t column = 0; column < this->columns_.size(); column++) {
+			if (this->columns_[column].name == name) {
+				return column;
+			}
+		}
+		return std::nullopt;
+	}
+
+	[[nodiscard]] std::uint64_t row_count() const {
+		return this->rows;
+	}
+
+	[[nodiscard]] std::uint64_t row_group_count() const {
+		return this->rowGroups.size();
+	}
+
+	/// A row group's row count and chunk metadata, for a row group below row_group_count().
+	[[nodiscard]] const FileStreamColumnarFormat::RowGroup& row_group(std::uint64_t rowGroup) const {
+		return this->rowGroups[rowGroup];
+	}
+
+	/// How many column chunks have been read from the file.
+	[[nodiscard]] std::uint64_t chunks_read() const {
+		return this->chunksRead;
+	}
+
+	/// The smallest and largest value of a column in a row group, leaving out NaNs.
+	template<FileStreamColumnarType T>
+	[[nodiscard]] std::pair<FileStreamColumnarFormat::Statistic<T>, FileStreamColumnarFormat::Statistic<T>> statistics(std::uint64_t rowGroup, std::uint64_t column) const {
+		using Statistic = FileStreamColumnarFormat::Statistic<T>;
+		if (!this->check<T>(rowGroup, column)) {
+			return {};
+		}
+		const auto& chunk = this->rowGroups[rowGroup].chunks[column];
+		return {std::bit_cast<Statistic>(chunk.min), std::bit_cast<Statistic>(chunk.max)};
+	}
+
+	/// The row groups whose values in a column might fall between low and high, both included.
+	template<FileStreamColumnarType T>
+	[[nodiscard]] std::vector<std::uint64_t> row_groups_overlapping(std::uint64_t column, T low, T high) const {
+		std::vector<std::uint64_t> out;
+		for (std::uint64_t rowGroup = 0; rowGroup < this->rowGroups.size(); rowGroup++) {
+			const auto [min, max] = this->statistics<T>(rowGroup, column);
+			// NaN statistics compare false both ways, so those row groups are never ruled out
+			if (!(max < low) && !(min > high)) {
+				out.push_back(rowGroup);
+			}
+		}
+		return out;
+	}
+
+	/// Reads one column of one row group into out, resized to the row group's row count.
+	/// With exceptions disabled, a bad index or type leaves out empty and a corrupt chunk reads as zeros.
+	template<FileStreamColumnarType T>
+	FileStreamColumnarReader& read(std::uint64_t rowGroup, std::uint64_t column, std::vector<T>& out) {
+		out.clear();
+		if (!this->check<T>(rowGroup, column)) {
+			return *this;
+		}
+		const auto& chunk = this->rowGroups[rowGroup].chunks[column];
+		out.resize(this->rowGroups[rowGroup].rows);
+		this->encoded.resize(chunk.size);
+		this->file.seek_in_u(chunk.offset).read(this->encoded.data(), this->encoded.size());
+		this->chunksRead++;
+		if (!this->file || !FileStreamColumnarFormat::decode_chunk<T>(chunk.encoding, this->encoded, std::span{out})) {
+			this->file.clear();
+			std::fill(out.begin(), out.end(), T{});
+			if (this->useExceptions) {
+				BufferStreamThrow::invalid_argument(FILESTREAM_COLUMNAR_CORRUPT_CHUNK_ERROR_MESSAGE);
+			}
+		}
+		return *this;
+	}
+
+	/// Reads every row group of a column into out, one after the other.
+	template<FileStreamColumnarType T>
+	FileStreamColumnarReader& read(std::uint64_t column, std::vector<T>& out) {
+		out.clear();
+		std::vector<T> chunk;
+		for (std::uint64_t rowGroup = 0; rowGroup < this->rowGroups.size(); rowGroup++) {
+			this->read(rowGroup, column, chunk);
+			out.insert(out.end(), chunk.begin(), chunk.end());
+		}
+		return *this;
+	}
+
+protected:
+	template<FileStreamColumnarType T>
+	[[nodiscard]] bool check(std::uint64_t rowGroup, std::uint64_t column) const {
+		if (rowGroup >= this->rowGroups.size() || column >= this->columns_.size()) {
+			if (this->useExceptions) {
+				BufferStreamThrow::invalid_argument(FILESTREAM_COLUMNAR_INDEX_ERROR_MESSAGE);
+			}
+			return false;
+		}
+		if (this->columns_[column].type != FileStreamColumnarFormat::type_of<T>()) {
+			if (this->useExceptions) {
+				BufferStreamThrow::invalid_argument(FILESTREAM_COLUMNAR_TYPE_ERROR_MESSAGE);
+			}
+			return false;
+		}
+		return true;
+	}
+
+	/// Reads and validates the trailer and metadata. The file is untrusted, so every count and chunk is checked against the file size.
+	[[nodiscard]] bool read_metadata() {
+		if (!this->file) {
+			return false;
+		}
+		const std::uint64_t fileSize = this->file.seek_in_u(0, std::ios::end).tell_in();
+		if (!this->file || fileSize < FileStreamColumnarFormat::HEADER_SIZE + FileStreamColumnarFormat::TRAILER_SIZE) {
+			return false;
+		}
+
+		std::array<std::byte, 4> magic{};
+		this->file.seek_in_u(0).read(magic);
+		const auto version = this->file.read<std::uint16_t>();
+		if (magic != FileStreamColumnarFormat::MAGIC || version != FileStreamColumnarFormat::VERSION) {
+			return false;
+		}
+
+		this->file.seek_in_u(fileSize - FileStreamColumnarFormat::TRAILER_SIZE);
+		const auto metadataOffset = this->file.read<std::uint64_t>();
+		this->file.read(magic);
+		if (!this->file || magic != FileStreamColumnarFormat::MAGIC
+				|| metadataOffset < FileStreamColumnarFormat::HEADER_SIZE || metadataOffset > fileSize - FileStreamColumnarFormat::TRAILER_SIZE) {
+			return false;
+		}
+		std::vector<std::byte> metadata(fileSize - FileStreamColumnarFormat::TRAILER_SIZE - metadataOffset);
+		this->file.seek_in_u(metadataOffset).read(metadata.data(), metadata.size());
+		if (!this->file) {
+			return false;
+		}
+
+		BufferStreamReadOnly stream{metadata.data(), metadata.size()};
+		try {
+			// Every count is checked against the bytes left before allocating for it
+			const auto columnCount = stream.read<std::uint32_t>();
+			if (columnCount > metadata.size() / 8) {
+				return false;
+			}
+			this->columns_.resize(columnCount);
+			for (auto& column : this->columns_) {
+				const auto type = stream.read<std::uint32_t>();
+				if (type >= FileStreamColumnarFormat::TYPE_COUNT) {
+					return false;
+				}
+				column.type = static_cast<FileStreamColumnarFormat::Type>(type);
+				column.name = stream.read_string(stream.read<std::uint32_t>(), false);
+			}
+
+			const auto rowGroupCount = stream.read<std::uint64_t>();
+			if (rowGroupCount > (metadata.size() - stream.tell()) / (8 + columnCount * FileStreamColumnarFormat::CHUNK_ENTRY_SIZE)) {
+				return false;
+			}
+			this->rowGroups.resize(rowGroupCount);
+			for (auto& rowGroup : this->rowGroups) {
+				rowGroup.rows = stream.read<std::uint64_t>();
+				if (rowGroup.rows > FileStreamColumnarFormat::MAX_ROW_GROUP_SIZE) {
+					return false;
+				}
+				this->rows += rowGroup.rows;
+				rowGroup.chunks.resize(columnCount);
+				for (auto& chunk : rowGroup.chunks) {
+					chunk.offset = stream.read<std::uint64_t>();
+					chunk.size = stream.read<std::uint64_t>();
+					const auto encoding = stream.read<std::uint32_t>();
+					chunk.min = stream.read<std::uint64_t>();
+					chunk.max = stream.read<std::uint64_t>();
+					if (encoding >= FileStreamColumnarFormat::ENCODING_COUNT || chunk.offset < FileStreamColumnarFormat::HEADER_SIZE
+							|| chunk.offset > metadataOffset || chunk.size > metadataOffset - chunk.offset) {
+						return false;
+					}
+					chunk.encoding = static_cast<FileStreamColumnarFormat::Encoding>(encoding);
+				}
+			}
+			return stream.tell() == metadata.size();
+		} catch (const std::overflow_error&) {
+			return false;
+		}
+	}
+
+	FileStream file;
+	std::vector<FileStreamColumnarFormat::Column> columns_;
+	std::vector<FileStreamColumnarFormat::RowGroup> rowGroups;
+	std::vector<std::byte> encoded;
+	std::uint64_t rows;
+	std::uint64_t chunksRead;
+	bool valid;
+	bool useExceptions;
+};
@@ -0,0 +1,712 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BufferStreamLZ.h"
+#include "FileStream.h"
+
+constexpr auto FILESTREAM_COMPRESSED_CORRUPT_BLOCK_ERROR_MESSAGE = "Compressed block is corrupt!";
+
+/// The layout of a seekable compressed file, all little-endian:
+/// - Header: magic, version (u16), reserved (u16), uncompressed block size (u32), reserved (u32)
+/// - Blocks: each compressed independently with BufferStreamLZ, or stored as is if that doesn't make it smaller
+/// - Index: for each block, its file offset (u64), compressed size (u32) and flags (u32)
+/// - Footer: index offset (u64), block count (u64), uncompressed size (u64), reserved (u32), magic
+/// Every block but the last holds exactly the block size of uncompressed data, so finding the block for an
+/// uncompressed offset is a division.
+struct FileStreamCompressedFormat {
+	static constexpr std::array<std::byte, 4> MAGIC{std::byte{'B'}, std::byte{'S'}, std::byte{'C'}, std::byte{'Z'}};
+	static constexpr std::uint16_t VERSION = 1;
+	static constexpr std::uint64_t HEADER_SIZE = 16;
+	static constexpr std::uint64_t INDEX_ENTRY_SIZE = 16;
+	static constexpr std::uint64_t FOOTER_SIZE = 32;
+	static constexpr std::uint32_t FLAG_STORED = 1 << 0;
+	static constexpr std::uint64_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+	struct Block {
+		std::uint64_t offset;
+		std::uint32_t compressedSize;
+		std::uint32_t flags;
+	};
+
+	/// Compresses one block into out, falling back to storing it if it doesn't compress. Returns the block's flags.
+	static std::uint32_t encode_block(std::span<const std::byte> in, std::vector<std::byte>& out) {
+		out.clear();
+		BufferStreamLZ::compress(in, out);
+		if (out.size() >= in.size()) {
+			out.assign(in.begin(), in.end());
+			return FLAG_STORED;
+		}
+		return 0;
+	}
+
+	static void write_header(FileStream& file, std::uint64_t blockSize) {
+		file.write(MAGIC);
+		file.write(VERSION).write(std::uint16_t{0}).write(static_cast<std::uint32_t>(blockSize)).write(std::uint32_t{0});
+	}
+
+	static void write_index(FileStream& file, const std::vector<Block>& blocks, std::uint64_t indexOffset, std::uint64_t uncompressedSize) {
+		for (const auto& block : blocks) {
+			file.write(block.offset).write(block.compressedSize).write(block.flags);
+		}
+		file.write(indexOffset).write(static_cast<std::uint64_t>(blocks.size())).write(uncompressedSize).write(std::uint32_t{0});
+		file.write(MAGIC);
+	}
+};
+
+/// A block handed to FileStreamCompressedWriter's workers, with the buffers it's compressed from and into.
+/// Declared outside the writer because GCC 12 crashes building the module interface with it nested.
+struct FileStreamCompressedJob {
+	std::vector<std::byte> input;
+	std::vector<std::byte> output;
+	std::uint32_t flags = 0;
+	bool done = false;
+	std::exception_ptr error;
+};
+
+/// Writes a seekable compressed file, one block at a time as the uncompressed data fills it.
+/// The index is written by finish(), or by the destructor if finish() wasn't called.
+///
+/// With more than one thread, full blocks are handed to a pool of worker threads to compress while
+/// writing continues, and are written to the file in order as they finish. At most maxBlocksInFlight
+/// blocks are queued or being compressed at once; writing waits for the oldest one when the limit is hit.
+/// Blocks are compressed independently, so the file is identical whatever the thread count.
+class FileStreamCompressedWriter {
+public:
+	explicit FileStreamCompressedWriter(const std::string& path, std::uint64_t blockSize_ = FileStreamCompressedFormat::DEFAULT_BLOCK_SIZE, std::uint64_t threads = 1, std::uint64_t maxBlocksInFlight_ = 0)
+			: file(path, FileStream::OPT_WRITE | FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT)
+			, blockSize(std::clamp<std::uint64_t>(blockSize_, 1, UINT32_MAX))
+			, uncompressedSize(0)
+			, maxBlocksInFlight(maxBlocksInFlight_ ? maxBlocksInFlight_ : 2 * threads)
+			, stopping(false)
+			, bigEndian(false)
+			, finished(false) {
+		this->block.reserve(this->blockSize);
+		FileStreamCompressedFormat::write_header(this->file, this->blockSize);
+		if (threads > 1) {
+			this->workers.reserve(threads);
+			try {
+				for (std::uint64_t i = 0; i < threads; i++) {
+					this->workers.emplace_back([this] { this->work(); });
+				}
+			} catch (const std::system_error&) {
+				// Out of threads; carry on with the workers that started, or compress inline if none did
+			}
+		}
+	}
+
+	FileStreamCompressedWriter(const FileStreamCompressedWriter&) = delete;
+	FileStreamCompressedWriter& operator=(const FileStreamCompressedWriter&) = delete;
+
+	~FileStreamCompressedWriter() {
+		try {
+			this->finish();
+		} catch (...) {}
+		this->stop_workers();
+	}
+
+	[[nodiscard]] explicit operator bool() const {
+		return static_cast<bool>(this->file);
+	}
+
+	[[nodiscard]] bool is_big_endian() const {
+		return this->bigEndian;
+	}
+
+	FileStreamCompressedWriter& set_big_endian(bool writeBigEndian) {
+		this->bigEndian = writeBigEndian;
+		return *this;
+	}
+
+	/// The number of uncompressed bytes written so far.
+	[[nodiscard]] std::uint64_t tell() const {
+		return this->uncompressedSize;
+	}
+
+	template<BufferStreamPODType T>
+	FileStreamCompressedWriter& write(const T& obj) {
+		return this->write(&obj, 1);
+	}
+
+	template<BufferStreamPODType T>
+	FileStreamCompressedWriter& operator<<(const T& obj) {
+		return this->write(obj);
+	}
+
+	template<BufferStreamPODType T>
+	FileStreamCompressedWriter& write(const T* obj, std::uint64_t n) {
+		if (sizeof(T) == 1 || this->bigEndian == (std::endian::native == std::endian::big)) {
+			this->write_raw(reinterpret_cast<const std::byte*>(obj), sizeof(T) * n);
+			return *this;
+		}
+
+		// Swap a chunk at a time on the stack, the caller's data is never modified
+		constexpr std::uint64_t CHUNK_SIZE = std::max<std::uint64_t>(4096 / sizeof(T), 1);
+		alignas(T) std::byte chunk[CHUNK_SIZE * sizeof(T)];
+		for (std::uint64_t i = 0; i < n; i += CHUNK_SIZE) {
+			const std::uint64_t count = std::min(n - i, CHUNK_SIZE);
+			std::memcpy(chunk, obj + i, sizeof(T) * count);
+			BufferStream::convert_endian(reinterpret_cast<T*>(chunk), count, this->bigEndian, true);
+			this->write_raw(chunk, sizeof(T) * count);
+		}
+		return *this;
+	}
+
+	template<BufferStreamPODType T, std::uint64_t N>
+	FileStreamCompressedWriter& write(const std::array<T, N>& obj) {
+		return this->write(obj.data(), N);
+	}
+
+	template<BufferStreamNonResizableContiguousContainer T>
+	FileStreamCompressedWriter& write(const T& obj) {
+		return this->write(obj.data(), obj.size());
+	}
+
+	template<BufferStreamResizableContiguousContainer T>
+	FileStreamCompressedWriter& write(const T& obj) {
+		return this->write(obj.data(), obj.size());
+	}
+
+	FileStreamCompressedWriter& write(std::string_view obj, bool addNullTerminator = true) {
+		this->write_raw(reinterpret_cast<const std::byte*>(obj.data()), obj.size());
+		if (addNullTerminator && (obj.empty() || obj.back() != '\0')) {
+			this->write_raw(&NULL_TERMINATOR, 1);
+		}
+		return *this;
+	}
+
+	FileStreamCompressedWriter& write(const std::string& obj, bool addNullTerminator = true) {
+		return this->write(std::string_view{obj}, addNullTerminator);
+	}
+
+	/// Compresses the last block and writes the index. Nothing can be written afterwards.
+	void finish() {
+		if (this->finished) {
+			return;
+		}
+		this->finished = true;
+		if (!this->block.empty()) {
+			this->flush_block();
+		}
+		while (!this->inFlight.empty()) {
+			this->write_oldest_job();
+		}
+		this->stop_workers();
+		FileStreamCompressedFormat::write_index(this->file, this->blocks, this->file_offset(), this->uncompressedSize);
+		this->file.flush();
+	}
+
+protected:
+	static constexpr std::byte NULL_TERMINATOR{0};
+
+	void write_raw(const std::byte* data, std::uint64_t n) {
+		this->uncompressedSize += n;
+		while (n) {
+			const std::uint64_t count = std::min(n, this->blockSize - this->block.size());
+			this->block.insert(this->block.end(), data, data + count);
+			data += count;
+			n -= count;
+			if (this->block.size() == this->blockSize) {
+				this->flush_block();
+			}
+		}
+	}
+
+	using Job = FileStreamCompressedJob;
+
+	void flush_block() {
+		if (this->workers.empty()) {
+			const auto flags = FileStreamCompressedFormat::encode_block(this->block, this->compressed);
+			this->write_block(this->compressed, flags);
+			this->block.clear();
+			return;
+		}
+
+		while (this->inFlight.size() >= this->maxBlocksInFlight) {
+			this->write_oldest_job();
+		}
+		std::unique_ptr<Job> job;
+		if (!this->spareJobs.empty()) {
+			job = std::move(this->spareJobs.back());
+			this->spareJobs.pop_back();
+		} else {
+			job = std::make_unique<Job>();
+			job->input.reserve(this->blockSize);
+		}
+		// Hand over the filled block and keep writing into the job's old, already allocated buffer
+		std::swap(job->input, this->block);
+		this->block.clear();
+		{
+			const std::scoped_lock lock{this->mutex};
+			this->pending.push_back(job.get());
+			this->inFlight.push_back(std::move(job));
+		}
+		this->jobQueued.notify_one();
+	}
+
+	/// Waits for the oldest block in flight, writes it, and keeps its buffers for a later block.
+	void write_oldest_job() {
+		std::unique_ptr<Job> job;
+		{
+			std::unique_lock lock{this->mutex};
+			this->jobDone.wait(lock, [this] { return this->inFlight.front()->done; });
+			job = std::move(this->inFlight.front());
+			this->inFlight.pop_front();
+		}
+		if (job->error) {
+			std::rethrow_exception(job->error);
+		}
+		this->write_block(job->output, job->flags);
+		job->done = false;
+		this->spareJobs.push_back(std::move(job));
+	}
+
+	void write_block(const std::vector<std::byte>& data, std::uint32_t flags) {
+		this->blocks.push_back({this->file_offset(), static_cast<std::uint32_t>(data.size()), flags});
+		this->file.write(data.data(), data.size());
+	}
+
+	void work() {
+		for (;;) {
+			Job* job;
+			{
+				std::unique_lock lock{this->mutex};
+				this->jobQueued.wait(lock, [this] { return this->stopping || !this->pending.empty(); });
+				if (this->pending.empty()) {
+					return;
+				}
+				job = this->pending.front();
+				this->pending.pop_front();
+			}
+			try {
+				job->flags = FileStreamCompressedFormat::encode_block(job->input, job->output);
+			} catch (...) {
+				job->error = std::current_exception();
+			}
+			{
+				const std::scoped_lock lock{this->mutex};
+				job->done = true;
+			}
+			this->jobDone.notify_one();
+		}
+	}
+
+	void stop_workers() {
+		{
+			const std::scoped_lock lock{this->mutex};
+			this->stopping = true;
+		}
+		this->jobQueued.notify_all();
+		for (auto& worker : this->workers) {
+			worker.join();
+		}
+		this->workers.clear();
+	}
+
+	[[nodiscard]] std::uint64_t file_offset() {
+		return this->file.tell_out();
+	}
+
+	FileStream file;
+	std::uint64_t blockSize;
+	std::uint64_t uncompressedSize;
+	std::vector<std::byte> block;
+	std::vector<std::byte> compressed;
+	std::vector<FileStreamCompressedFormat::Block> blocks;
+
+	std::uint64_t maxBlocksInFlight;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobQueued;
+	std::condition_variable jobDone;
+	/// Every block handed to the workers and not yet written, oldest first.
+	std::deque<std::unique_ptr<Job>> inFlight;
+	/// The blocks no worker has picked up yet.
+	std::deque<Job*> pending;
+	std::vector<std::unique_ptr<Job>> spareJobs;
+	bool stopping;
+
+	bool bigEndian;
+	bool finished;
+};
+
+/// Random access to the uncompressed contents of a seekable compressed file, through the same read, at and
+/// seek functions as BufferStream. Only the blocks a read touches are decompressed, and the most recently
+/// used ones are kept around, so nearby reads don't decompress the same block again.
+class FileStreamCompressedReader {
+public:
+	static constexpr std::uint64_t DEFAULT_CACHED_BLOCKS = 8;
+
+	explicit FileStreamCompressedReader(const std::string& path, std::uint64_t cachedBlocks = DEFAULT_CACHED_BLOCKS)
+			: file(path)
+			, blockSize(0)
+			, uncompressedSize(0)
+			, pos(0)
+			, slots(std::max<std::uint64_t>(cachedBlocks, 1))
+			, lastSlot(0)
+			, useClock(0)
+			, decompressions(0)
+			, valid(false)
+			, useExceptions(true)
+			, bigEndian(false) {
+		this->valid = this->read_index();
+		if (!this->valid) {
+			this->blocks.clear();
+			this->uncompressedSize = 0;
+		}
+	}
+
+	/// False if the file couldn't be opened or isn't a valid container.
+	[[nodiscard]] explicit operator bool() const {
+		return this->valid;
+	}
+
+	[[nodiscard]] bool are_exceptions_enabled() const {
+		return this->useExceptions;
+	}
+
+	FileStreamCompressedReader& set_exceptions_enabled(bool exceptions) {
+		this->useExceptions = exceptions;
+		return *this;
+	}
+
+	[[nodiscard]] bool is_big_endian() const {
+		return this->bigEndian;
+	}
+
+	FileStreamCompressedReader& set_big_endian(bool readBigEndian) {
+		this->bigEndian = readBigEndian;
+		return *this;
+	}
+
+	/// The size of the uncompressed data.
+	[[nodiscard]] std::uint64_t size() const {
+		return this->uncompressedSize;
+	}
+
+	[[nodiscard]] std::uint64_t tell() const {
+		return this->pos;
+	}
+
+	[[nodiscard]] std::uint64_t block_size() const {
+		return this->blockSize;
+	}
+
+	[[nodiscard]] std::uint64_t block_count() const {
+		return this->blocks.size();
+	}
+
+	/// How many times a block has been decompressed, cache misses included.
+	[[nodiscard]] std::uint64_t blocks_decompressed() const {
+		return this->decompressions;
+	}
+
+	/// Seeks within the uncompressed data. Like BufferStream, an offset from the end counts backwards.
+	FileStreamCompressedReader& seek(std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		std::uint64_t target = 0;
+		bool inRange = true;
+		switch (offsetFrom) {
+			case std::ios::beg:
+				inRange = offset >= 0 && std::cmp_less_equal(offset, this->uncompressedSize);
+				target = static_cast<std::uint64_t>(offset);
+				break;
+			case std::ios::cur:
+				if (offset < 0) {
+					inRange = static_cast<std::uint64_t>(-(offset + 1)) < this->pos;
+				} else {
+					inRange = static_cast<std::uint64_t>(offset) <= this->uncompressedSize - this->pos;
+				}
+				target = this->pos + static_cast<std::uint64_t>(offset);
+				break;
+			case std::ios::end:
+				inRange = offset >= 0 && std::cmp_less_equal(offset, this->uncompressedSize);
+				target = this->uncompressedSize - static_cast<std::uint64_t>(offset);
+				break;
+			default:
+				return *this;
+		}
+		if (!inRange) {
+			if (this->useExceptions) {
+				BufferStreamThrow::overflow_read();
+			}
+			return *this;
+		}
+		this->pos = target;
+		return *this;
+	}
+
+	FileStreamCompressedReader& seek_u(std::uint64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		return this->seek(static_cast<std::int64_t>(offset), offsetFrom);
+	}
+
+	template<BufferStreamPODType T = std::byte>
+	FileStreamCompressedReader& skip(std::int64_t n = 1) {
+		return this->seek(static_cast<std::int64_t>(sizeof(T)) * n, std::ios::cur);
+	}
+
+	template<BufferStreamPODType T = std::byte>
+	FileStreamCompressedReader& skip_u(std::uint64_t n = 1) {
+		return this->skip<T>(static_cast<std::int64_t>(n));
+	}
+
+	template<BufferStreamPODType T>
+	FileStreamCompressedReader& read(T& obj) {
+		return this->read(&obj, 1);
+	}
+
+	template<BufferStreamPODType T>
+	FileStreamCompressedReader& operator>>(T& obj) {
+		return this->read(obj);
+	}
+
+	template<BufferStreamPODType T>
+	[[nodiscard]] T read() {
+		T obj{};
+		this->read(obj);
+		return obj;
+	}
+
+	template<BufferStreamPODType T>
+	FileStreamCompressedReader& read(T* obj, std::uint64_t n) {
+		if (this->useExceptions && n > (this->uncompressedSize - this->pos) / sizeof(T)) {
+			BufferStreamThrow::overflow_read();
+		}
+		this->read_raw(reinterpret_cast<std::byte*>(obj), sizeof(T) * n);
+		BufferStream::convert_endian(obj, n, this->bigEndian, this->useExceptions);
+		return *this;
+	}
+
+	template<BufferStreamPODType T, std::uint64_t N>
+	FileStreamCompressedReader& read(std::array<T, N>& obj) {
+		return this->read(obj.data(), N);
+	}
+
+	template<BufferStreamPODType T, std::uint64_t Extent>
+	FileStreamCompressedReader& read(std::span<T, Extent> obj) {
+		return this->read(obj.data(), obj.size());
+	}
+
+	template<BufferStreamResizableContiguousContainer T>
+	FileStreamCompressedReader& read(T& obj, std::uint64_t n) {
+		if (this->useExceptions && n > (this->uncompressedSize - this->pos) / sizeof(typename T::value_type)) {
+			BufferStreamThrow::overflow_read();
+		}
+		obj.resize(n);
+		return this->read(obj.data(), n);
+	}
+
+	template<BufferStreamResizableContiguousContainer T>
+	[[nodiscard]] T read(std::uint64_t n) {
+		T obj{};
+		this->read(obj, n);
+		return obj;
+	}
+
+	[[nodiscard]] std::vector<std::byte> read_bytes(std::uint64_t length) {
+		return this->read<std::vector<std::byte>>(length);
+	}
+
+	/// Reads the string up to the null terminator, which may be in a later block, and skips past the terminator.
+	[[nodiscard]] std::string read_string() {
+		std::string out;
+		while (this->pos < this->uncompressedSize) {
+			const auto& data = this->get_block(this->pos / this->blockSize);
+			const std::uint64_t offsetInBlock = this->pos % this->blockSize;
+			const auto* start = reinterpret_cast<const char*>(data.data() + offsetInBlock);
+			const std::uint64_t available = data.size() - offsetInBlock;
+			if (const auto* terminator = static_cast<const char*>(std::memchr(start, '\0', available))) {
+				out.append(start, terminator);
+				this->pos += (terminator - start) + 1;
+				return out;
+			}
+			out.append(start, available);
+			this->pos += available;
+		}
+		if (this->useExceptions) {
+			BufferStreamThrow::overflow_read();
+		}
+		return out;
+	}
+
+	[[nodiscard]] std::string read_string(std::uint64_t n, bool stopOnNullTerminator = true) {
+		auto out = this->read<std::string>(n);
+		if (stopOnNullTerminator) {
+			if (const auto terminator = out.find('\0'); terminator != std::string::npos) {
+				out.resize(terminator);
+			}
+		}
+		return out;
+	}
+
+	template<BufferStreamPODType T>
+	[[nodiscard]] T at(std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		const std::uint64_t previous = this->pos;
+		const T val = this->seek(offset, offsetFrom).template read<T>();
+		this->pos = previous;
+		return val;
+	}
+
+	template<BufferStreamPODType T>
+	[[nodiscard]] T at_u(std::uint64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		return this->at<T>(static_cast<std::int64_t>(offset), offsetFrom);
+	}
+
+	[[nodiscard]] std::vector<std::byte> at_bytes(std::uint64_t length, std::int64_t offset, std::ios::seekdir offsetFrom = std::ios::beg) {
+		const std::uint64_t previous = this->pos;
+		auto val = this->seek(offset, offsetFrom).read_bytes(length);
+		this->pos = previous;
+		return val;
+	}
+
+protected:
+	struct Slot {
+		std::uint64_t blockIndex = UINT64_MAX;
+		std::uint64_t lastUse = 0;
+		std::vector<std::byte> data;
+	};
+
+	/// Copies n bytes at the current position, decompressing whichever blocks they span.
+	/// Anything past the end of the data reads as zeros, for when exceptions are disabled.
+	void read_raw(std::byte* out, std::uint64_t n) {
+		while (n && this->pos < this->uncompressedSize) {
+			const auto& data = this->get_block(this->pos / this->blockSize);
+			const std::uint64_t offsetInBlock = this->pos % this->blockSize;
+			const std::uint64_t count = std::min(n, data.size() - offsetInBlock);
+			std::memcpy(out, data.data() + offsetInBlock, count);
+			out += count;
+			n -= count;
+			this->pos += count;
+		}
+		if (n) {
+			std::memset(out, 0, n);
+		}
+	}
+
+	/// Returns the uncompressed contents of the block, from the cache if it's there.
+	[[nodiscard]] const std::vector<std::byte>& get_block(std::uint64_t blockIndex) {
+		if (this->slots[this->lastSlot].blockIndex == blockIndex) {
+			return this->slots[this->lastSlot].data;
+		}
+
+		std::uint64_t victim = 0;
+		for (std::uint64_t i = 0; i < this->slots.size(); i++) {
+			if (this->slots[i].blockIndex == blockIndex) {
+				this->slots[i].lastUse = ++this->useClock;
+				this->lastSlot = i;
+				return this->slots[i].data;
+			}
+			if (this->slots[i].lastUse < this->slots[victim].lastUse) {
+				victim = i;
+			}
+		}
+
+		auto& slot = this->slots[victim];
+		slot.blockIndex = blockIndex;
+		slot.lastUse = ++this->useClock;
+		this->lastSlot = victim;
+		this->decompress_block(blockIndex, slot.data);
+		return slot.data;
+	}
+
+	BUFFERSTREAM_NOINLINE void decompress_block(std::uint64_t blockIndex, std::vector<std::byte>& out) {
+		this->decompressions++;
+		const auto& block = this->blocks[blockIndex];
+		const std::uint64_t uncompressedBlockSize = std::min(this->blockSize, this->uncompressedSize - blockIndex * this->blockSize);
+		out.resize(uncompressedBlockSize);
+
+		bool ok;
+		this->file.seek_in_u(block.offset);
+		if (block.flags & FileStreamCompressedFormat::FLAG_STORED) {
+			this->file.read(out.data(), out.size());
+			ok = block.compressedSize == out.size() && this->file;
+		} else {
+			this->compressed.resize(block.compressedSize);
+			this->file.read(this->compressed.data(), this->compressed.size());
+			ok = this->file && BufferStreamLZ::decompress(this->compressed, out);
+		}
+		if (!ok) {
+			this->file.clear();
+			std::fill(out.begin(), out.end(), std::byte{0});
+			if (this->useExceptions) {
+				// Don't leave the zeroed block cached as if it were good
+				this->slots[this->lastSlot].blockIndex = UINT64_MAX;
+				BufferStreamThrow::invalid_argument(FILESTREAM_COMPRESSED_CORRUPT_BLOCK_ERROR_MESSAGE);
+			}
+		}
+	}
+
+	/// Reads and validates the footer and index. The file is untrusted, so every size is checked against the file size.
+	[[nodiscard]] bool read_index() {
+		if (!this->file) {
+			return false;
+		}
+		const std::uint64_t fileSize = this->file.seek_in_u(0, std::ios::end).tell_in();
+		if (!this->file || fileSize < FileStreamCompressedFormat::HEADER_SIZE + FileStreamCompressedFormat::FOOTER_SIZE) {
+			return false;
+		}
+
+		std::array<std::byte, 4> magic{};
+		this->file.seek_in_u(0).read(magic);
+		const auto version = this->file.read<std::uint16_t>();
+		this->file.skip_in<std::uint16_t>();
+		this->blockSize = this->file.read<std::uint32_t>();
+		if (magic != FileStreamCompressedFormat::MAGIC || version != FileStreamCompressedFormat::VERSION || !this->blockSize) {
+			return false;
+		}
+
+		this->file.seek_in_u(fileSize - FileStreamCompressedFormat::FOOTER_SIZE);
+		const auto indexOffset = this->file.read<std::uint64_t>();
+		const auto blockCount = this->file.read<std::uint64_t>();
+		this->uncompressedSize = this->file.read<std::uint64_t>();
+		this->file.skip_in<std::uint32_t>();
+		this->file.read(magic);
+		if (!this->file || magic != FileStreamCompressedFormat::MAGIC) {
+			return false;
+		}
+		const std::uint64_t indexSpace = fileSize - FileStreamCompressedFormat::FOOTER_SIZE;
+		if (indexOffset < FileStreamCompressedFormat::HEADER_SIZE || indexOffset > indexSpace
+				|| blockCount != (indexSpace - indexOffset) / FileStreamCompressedFormat::INDEX_ENTRY_SIZE
+				|| blockCount != this->uncompressedSize / this->blockSize + (this->uncompressedSize % this->blockSize != 0)) {
+			return false;
+		}
+
+		this->blocks.resize(blockCount);
+		this->file.seek_in_u(indexOffset);
+		for (auto& block : this->blocks) {
+			this->file.read(block.offset).read(block.compressedSize).read(block.flags);
+			if (block.offset < FileStreamCompressedFormat::HEADER_SIZE || block.offset > indexOffset || block.compressedSize > indexOffset - block.offset) {
+				return false;
+			}
+		}
+		return static_cast<bool>(this->file);
+	}
+
+	FileStream file;
+	std::uint64_t blockSize;
+	std::uint64_t uncompressedSize;
+	std::uint64_t pos;
+	std::vector<FileStreamCompressedFormat::Block> blocks;
+	std::vector<Slot> slots;
+	std::uint64_t lastSlot;
+	std::uint64_t useClock;
+	std::uint64_t decompressions;
+	std::vector<std::byte> compressed;
+	bool valid;
+	bool useExceptions;
+	bool bigEndian;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/// Log-bucketed (HDR-style) histogram of nanosecond latencies.
+/// Values below 32 are recorded exactly, everything above is recorded with 16 linear sub-buckets
+/// per power of two, so any reported value is within 1/16th (~6%) of the value that was recorded.
+/// Counters are relaxed atomics: a histogram may be shared between threads, but it is cheaper to give
+/// each thread its own and merge them when exporting.
+class FileStreamLatencyHistogram {
+public:
+	static constexpr std::uint64_t SUB_BUCKET_BITS = 4;
+	static constexpr std::uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+	static constexpr std::uint64_t BUCKET_COUNT = SUB_BUCKET_COUNT * (64 - SUB_BUCKET_BITS) + SUB_BUCKET_COUNT;
+
+	FileStreamLatencyHistogram() = default;
+
+	FileStreamLatencyHistogram(const FileStreamLatencyHistogram& other) {
+		this->merge(other);
+	}
+
+	FileStreamLatencyHistogram& operator=(const FileStreamLatencyHistogram& other) {
+		if (this != &other) {
+			this->reset();
+			this->merge(other);
+		}
+		return *this;
+	}
+
+	void record(std::uint64_t value) {
+		this->buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+		this->total.fetch_add(1, std::memory_order_relaxed);
+		this->sum.fetch_add(value, std::memory_order_relaxed);
+
+		std::uint64_t curMax = this->max.load(std::memory_order_relaxed);
+		while (value > curMax && !this->max.compare_exchange_weak(curMax, value, std::memory_order_relaxed)) {}
+	}
+
+	void merge(const FileStreamLatencyHistogram& other) {
+		for (std::uint64_t i = 0; i < BUCKET_COUNT; i++) {
+			if (const auto count = other.buckets[i].load(std::memory_order_relaxed)) {
+				this->buckets[i].fetch_add(count, std::memory_order_relaxed);
+			}
+		}
+		this->total.fetch_add(other.total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		this->sum.fetch_add(other.sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+		const std::uint64_t otherMax = other.max.load(std::memory_order_relaxed);
+		std::uint64_t curMax = this->max.load(std::memory_order_relaxed);
+		while (otherMax > curMax && !this->max.compare_exchange_weak(curMax, otherMax, std::memory_order_relaxed)) {}
+	}
+
+	void reset() {
+		for (auto& bucket : this->buckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		this->total.store(0, std::memory_order_relaxed);
+		this->sum.store(0, std::memory_order_relaxed);
+		this->max.store(0, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] std::uint64_t count() const {
+		return this->total.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] std::uint64_t max_value() const {
+		return this->max.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] double mean() const {
+		const auto count = this->count();
+		return count ? static_cast<double>(this->sum.load(std::memory_order_relaxed)) / static_cast<double>(count) : 0.0;
+	}
+
+	/// Returns the highest value equivalent to the recorded value at the given percentile (0-100).
+	[[nodiscard]] std::uint64_t value_at_percentile(double percentile) const {
+		const auto count = this->count();
+		if (!count) {
+			return 0;
+		}
+		if (percentile < 0.0) {
+			percentile = 0.0;
+		} else if (percentile > 100.0) {
+			percentile = 100.0;
+		}
+		auto target = static_cast<std::uint64_t>(percentile / 100.0 * static_cast<double>(count) + 0.5);
+		if (!target) {
+			target = 1;
+		}
+
+		std::uint64_t seen = 0;
+		for (std::uint64_t i = 0; i < BUCKET_COUNT; i++) {
+			seen += this->buckets[i].load(std::memory_order_relaxed);
+			if (seen >= target) {
+				const auto highest = bucket_highest_value(i);
+				const auto curMax = this->max_value();
+				return highest < curMax ? highest : curMax;
+			}
+		}
+		return this->max_value();
+	}
+
+	[[nodiscard]] static constexpr std::uint64_t bucket_index(std::uint64_t value) {
+		if (value < SUB_BUCKET_COUNT * 2) {
+			return value;
+		}
+		const std::uint64_t shift = std::bit_width(value) - SUB_BUCKET_BITS - 1;
+		return SUB_BUCKET_COUNT * shift + (value >> shift);
+	}
+
+	[[nodiscard]] static constexpr std::uint64_t bucket_lowest_value(std::uint64_t index) {
+		if (index < SUB_BUCKET_COUNT * 2) {
+			return index;
+		}
+		const std::uint64_t shift = index / SUB_BUCKET_COUNT - 1;
+		return (index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT) << shift;
+	}
+
+	[[nodiscard]] static constexpr std::uint64_t bucket_highest_value(std::uint64_t index) {
+		if (index < SUB_BUCKET_COUNT * 2) {
+			return index;
+		}
+		const std::uint64_t shift = index / SUB_BUCKET_COUNT - 1;
+		return bucket_lowest_value(index) + ((std::uint64_t{1} << shift) - 1);
+	}
+
+private:
+	std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets{};
+	std::atomic<std::uint64_t> total{0};
+	std::atomic<std::uint64_t> sum{0};
+	std::atomic<std::uint64_t> max{0};
+};
+
+/// One latency histogram per FileStream operation kind and transfer size class.
+/// Attach it to one or more streams with FileStream::set_latency_histograms.
+class FileStreamLatencyHistograms {
+public:
+	enum Operation {
+		OP_READ,
+		OP_WRITE,
+		OP_SEEK,
+		OP_FLUSH,
+		OP_COUNT,
+	};
+
+	enum SizeClass {
+		SIZE_NONE,     // Seeks and flushes
+		SIZE_UP_TO_16,
+		SIZE_UP_TO_256,
+		SIZE_UP_TO_4K,
+		SIZE_UP_TO_64K,
+		SIZE_OVER_64K,
+		SIZE_COUNT,
+	};
+
+	[[nodiscard]] static constexpr SizeClass size_class(std::uint64_t bytes) {
+		if (!bytes) {
+			return SIZE_NONE;
+		}
+		if (bytes <= 16) {
+			return SIZE_UP_TO_16;
+		}
+		if (bytes <= 256) {
+			return SIZE_UP_TO_256;
+		}
+		if (bytes <= 4096) {
+			return SIZE_UP_TO_4K;
+		}
+		if (bytes <= 65536) {
+			return SIZE_UP_TO_64K;
+		}
+		return SIZE_OVER_64K;
+	}
+
+	void record(Operation op, std::uint64_t bytes, std::uint64_t nanoseconds) {
+		this->histograms[op][size_class(bytes)].record(nanoseconds);
+	}
+
+	[[nodiscard]] const FileStreamLatencyHistogram& get(Operation op, SizeClass sizeClass) const {
+		return this->histograms[op][sizeClass];
+	}
+
+	/// Merges every size class of the given operation together.
+	[[nodiscard]] FileStreamLatencyHistogram get(Operation op) const {
+		FileStreamLatencyHistogram out;
+		for (const auto& histogram : this->histograms[op]) {
+			out.merge(histogram);
+		}
+		return out;
+	}
+
+	void merge(const FileStreamLatencyHistograms& other) {
+		for (int op = 0; op < OP_COUNT; op++) {
+			for (int sizeClass = 0; sizeClass < SIZE_COUNT; sizeClass++) {
+				this->histograms[op][sizeClass].merge(other.histograms[op][sizeClass]);
+			}
+		}
+	}
+
+	void reset() {
+		for (auto& perOp : this->histograms) {
+			for (auto& histogram : perOp) {
+				histogram.reset();
+			}
+		}
+	}
+
+	/// Tab-separated percentile table (in nanoseconds) of every non-empty histogram.
+	[[nodiscard]] std::string report() const {
+		static constexpr std::array<std::string_view, OP_COUNT> OP_NAMES{"read", "write", "seek", "flush"};
+		static constexpr std::array<std::string_view, SIZE_COUNT> SIZE_NAMES{"-", "<=16", "<=256", "<=4K", "<=64K", ">64K"};
+
+		std::string out = "op\tsize\tcount\tmean\tp50\tp90\tp99\tp99.9\tmax\n";
+		for (int op = 0; op < OP_COUNT; op++) {
+			for (int sizeClass = 0; sizeClass < SIZE_COUNT; sizeClass++) {
+				const auto& histogram = this->histograms[op][sizeClass];
+				if (!histogram.count()) {
+					continue;
+				}
+				out += OP_NAMES[op];
+				out += '\t';
+				out += SIZE_NAMES[sizeClass];
+				out += '\t' + std::to_string(histogram.count());
+				out += '\t' + std::to_string(static_cast<std::uint64_t>(histogram.mean()));
+				for (double percentile : {50.0, 90.0, 99.0, 99.9}) {
+					out += '\t' + std::to_string(histogram.value_at_percentile(percentile));
+				}
+				out += '\t' + std::to_string(histogram.max_value()) + '\n';
+			}
+		}
+		return out;
+	}
+
+private:
+	std::array<std::array<FileStreamLatencyHistogram, SIZE_COUNT>, OP_COUNT> histograms{};
+};
+
+/// Records the lifetime of the timer into the given histograms, if any.
+class FileStreamLatencyTimer {
+public:
+	FileStreamLatencyTimer(FileStreamLatencyHistograms* histograms_, FileStreamLatencyHistograms::Operation op_, std::uint64_t bytes_)
+			: histograms(histograms_)
+			, op(op_)
+			, bytes(bytes_) {
+		if (this->histograms) {
+			this->start = std::chrono::steady_clock::now();
+		}
+	}
+
+	FileStreamLatencyTimer(const FileStreamLatencyTimer&) = delete;
+	FileStreamLatencyTimer& operator=(const FileStreamLatencyTimer&) = delete;
+
+	~FileStreamLatencyTimer() {
+		if (this->histograms) {
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count();
+			this->histograms->record(this->op, this->bytes, static_cast<std::uint64_t>(elapsed));
+		}
+	}
+
+private:
+	FileStreamLatencyHistograms* histograms;
+	FileStreamLatencyHistograms::Operation op;
+	std::uint64_t bytes;
+	std::chrono::steady_clock::time_point start{};
+};
@@ -0,0 +1,515 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "FileStream.h"
+
+constexpr auto FILESTREAM_SORT_RECORD_SIZE_ERROR_MESSAGE = "File isn't a whole number of fixed-length records!";
+constexpr auto FILESTREAM_SORT_TRUNCATED_RECORD_ERROR_MESSAGE = "Variable-length record runs past the end of the file!";
+constexpr auto FILESTREAM_SORT_OPEN_ERROR_MESSAGE = "Couldn't open a file to sort from or into!";
+constexpr auto FILESTREAM_SORT_WRITE_ERROR_MESSAGE = "Couldn't write a run file or the sorted output!";
+
+/// A tree of losers for merging k sorted sources, after Knuth: each internal node holds the source that lost
+/// the match played there, and the winner of the whole tournament is held apart. Once the winner's source
+/// moves on, only the matches on its path to the root are replayed, log2(k) comparisons against the losers
+/// stored there, where a binary heap takes up to twice as many.
+/// beats(a, b) says whether source a's current element goes first; sources that have run out should lose every match.
+template<typename Beats>
+class FileStreamLoserTree {
+public:
+	FileStreamLoserTree(std::uint64_t sources_, Beats beats_)
+			: beats(std::move(beats_))
+			, sources(sources_)
+			, leaves(std::bit_ceil(std::max<std::uint64_t>(sources_, 1)))
+			, losers(this->leaves)
+			, winner(0) {
+		// Play every match from the leaves up, keeping the loser of each and passing the winner on
+		std::vector<std::uint64_t> winners(2 * this->leaves);
+		for (std::uint64_t i = 0; i < this->leaves; i++) {
+			winners[this->leaves + i] = i;
+		}
+		for (std::uint64_t node = this->leaves - 1; node >= 1; node--) {
+			const std::uint64_t a = winners[2 * node];
+			const std::uint64_t b = winners[2 * node + 1];
+			const bool aWins = this->wins(a, b);
+			winners[node] = aWins ? a : b;
+			this->losers[node] = aWins ? b : a;
+		}
+		this->winner = winners[1];
+	}
+
+	/// The source whose element goes next. It's a source that has run out only when they all have.
+	[[nodiscard]] std::uint64_t top() const {
+		return this->winner;
+	}
+
+	/// Replays the winner's matches, after its source has moved on to its next element or run out.
+	void replay() {
+		std::uint64_t current = this->winner;
+		for (std::uint64_t node = (this->leaves + current) / 2; node >= 1; node /= 2) {
+			if (this->wins(this->losers[node], current)) {
+				std::swap(this->losers[node], current);
+			}
+		}
+		this->winner = current;
+	}
+
+private:
+	/// Padding sources past the real ones always lose, and ties go to the lower source, which keeps merges stable.
+	[[nodiscard]] bool wins(std::uint64_t a, std::uint64_t b) {
+		if (b >= this->sources) {
+			return a < this->sources || a < b;
+		}
+		if (a >= this->sources) {
+			return false;
+		}
+		if (this->beats(a, b)) {
+			return true;
+		}
+		return !this->beats(b, a) && a < b;
+	}
+
+	Beats beats;
+	std::uint64_t sources;
+	std::uint64_t leaves;
+	std::vector<std::uint64_t> losers;
+	std::uint64_t winner;
+};
+
+/// Sorts files of records too large to sort in memory. Records are either all recordSize bytes, or, with a
+/// recordSize of VARIABLE_LENGTH, each a little-endian u32 length followed by that many bytes. keyOf is given
+/// each record's bytes, without the length, and returns a key to order it by: anything with operator<, including
+/// a view into the record. keyOf is called from each sorting thread at once. The sort is stable, and the output
+/// has the same layout as the input.
+///
+/// The input is read in runs that fill the memory budget. Each run is split between the threads to sort, and the
+/// sorted parts are merged into a run file in the temporary directory with large buffered writes. The run files
+/// are then merged into the output by a loser tree, reading each through a buffer of its share of the budget.
+/// If there are so many runs that those buffers would be too small for reads to stay sequential, runs are merged
+/// into longer runs first. Input that fits in the budget is sorted straight into the output.
+template<typename KeyOf>
+class FileStreamSorter {
+public:
+	using Key = std::remove_cvref_t<std::invoke_result_t<KeyOf&, std::span<const std::byte>>>;
+
+	static constexpr std::uint64_t VARIABLE_LENGTH = 0;
+	static constexpr std::uint64_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+	/// The smallest read buffer a run gets during a merge, below which runs are merged in more than one pass.
+	static constexpr std::uint64_t MIN_MERGE_BUFFER = 1024 * 1024;
+	static constexpr std::uint64_t WRITE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+	explicit FileStreamSorter(KeyOf keyOf_, std::uint64_t recordSize_ = VARIABLE_LENGTH)
+			: keyOf(std::move(keyOf_))
+			, recordSize(recordSize_)
+			, memoryBudget(DEFAULT_MEMORY_BUDGET)
+			, threads(0)
+			, tempDirectory(std::filesystem::temp_directory_path())
+			, runs(0)
+			, passes(0)
+			, records(0) {}
+
+	[[nodiscard]] std::uint64_t get_memory_budget() const {
+		return this->memoryBudget;
+	}
+
+	/// How much memory runs and merge buffers may use, not counting each thread's stack and the keys' own allocations.
+	FileStreamSorter& set_memory_budget(std::uint64_t bytes) {
+		this->memoryBudget = std::max(bytes, 2 * MIN_MERGE_BUFFER);
+		return *this;
+	}
+
+	[[nodiscard]] const std::filesystem::path& get_temp_directory() const {
+		return this->tempDirectory;
+	}
+
+	/// Where run files are written. They're removed once they've been merged, or if sorting fails.
+	FileStreamSorter& set_temp_directory(std::filesystem::path directory) {
+		this->tempDirectory = std::move(directory);
+		return *this;
+	}
+
+	/// How many threads sort each run, where 0 is one per hardware thread.
+	FileStreamSorter& set_threads(std::uint64_t threads_) {
+		this->threads = threads_;
+		return *this;
+	}
+
+	/// Sorts the records of inputPath into outputPath, which must be a different file.
+	void sort(const std::string& inputPath, const std::string& outputPath) {
+		this->runs = 0;
+		this->passes = 0;
+		this->records = 0;
+
+		TempFiles temps{this->tempDirectory};
+		std::vector<std::filesystem::path> runPaths;
+		{
+			RecordReader input{inputPath, this->recordSize, std::min(WRITE_BUFFER_SIZE, this->memoryBudget / 4)};
+			// Runs get what the input buffer leaves of the budget
+			const std::uint64_t runBudget = this->memoryBudget - std::min(WRITE_BUFFER_SIZE, this->memoryBudget / 4);
+			std::vector<std::byte> arena;
+			arena.reserve(std::min(runBudget, input.size()));
+			std::vector<Entry> entries;
+			std::optional<std::span<const std::byte>> record = input.next();
+			while (record || !this->runs) {
+				arena.clear();
+				entries.clear();
+				// A run takes records until they and their entries fill the budget, and always at least one
+				while (record && (entries.empty() || arena.size() + record->size() + (entries.size() + 1) * sizeof(Entry) <= runBudget)) {
+					entries.push_back({{}, arena.size(), record->size()});
+					arena.insert(arena.end(), record->begin(), record->end());
+					record = input.next();
+				}
+				this->records += entries.size();
+				this->runs++;
+				if (!record && this->runs == 1) {
+					// Everything fit, so there's nothing to merge
+					this->sort_run(arena, entries, outputPath);
+					return;
+				}
+				runPaths.push_back(temps.create());
+				this->sort_run(arena, entries, runPaths.back().string());
+			}
+		}
+
+		// Merge as many runs at once as the budget gives a large enough buffer to, until one merge finishes the job
+		const std::uint64_t fanIn = std::max<std::uint64_t>(this->memoryBudget / MIN_MERGE_BUFFER - 1, 2);
+		while (runPaths.size() > fanIn) {
+			std::vector<std::filesystem::path> merged;
+			for (std::uint64_t first = 0; first < runPaths.size(); first += fanIn) {
+				const std::uint64_t last = std::min<std::uint64_t>(first + fanIn, runPaths.size());
+				if (last - first == 1) {
+					merged.push_back(runPaths[first]);
+					continue;
+				}
+				merged.push_back(temps.create());
+				this->merge_runs({runPaths.begin() + first, runPaths.begin() + last}, merged.back().string());
+				for (std::uint64_t i = first; i < last; i++) {
+					temps.remove(runPaths[i]);
+				}
+			}
+			runPaths = std::move(merged);
+			this->passes++;
+		}
+		this->merge_runs(runPaths, outputPath);
+		this->passes++;
+	}
+
+	/// The number of runs the last sort split its input into.
+	[[nodiscard]] std::uint64_t run_count() const {
+		return this->runs;
+	}
+
+	/// The number of merge passes the last sort made over the data, 0 if it fit in memory.
+	[[nodiscard]] std::uint64_t merge_passes() const {
+		return this->passes;
+	}
+
+	/// The number of records the last sort sorted.
+	[[nodiscard]] std::uint64_t record_count() const {
+		return this->records;
+	}
+
+protected:
+	/// A record in a run's arena, with its key worked out once before sorting.
+	struct Entry {
+		std::optional<Key> key;
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	/// Reads records from a file through a buffer, in large sequential reads.
+	class RecordReader {
+	public:
+		RecordReader(const std::string& path, std::uint64_t recordSize_, std::uint64_t bufferSize)
+				: file(path)
+				, recordSize(recordSize_)
+				, buffer(std::max<std::uint64_t>(bufferSize, recordSize_))
+				, position(0)
+				, end(0)
+				, fileSize(0)
+				, remaining(0) {
+			if (!this->file) {
+				BufferStreamThrow::invalid_argument(FILESTREAM_SORT_OPEN_ERROR_MESSAGE);
+			}
+			this->fileSize = this->file.seek_in_u(0, std::ios::end).tell_in();
+			this->remaining = this->fileSize;
+			this->file.seek_in_u(0).set_access_hint(FileStream::HINT_SEQUENTIAL);
+			if (this->recordSize && this->remaining % this->recordSize) {
+				BufferStreamThrow::invalid_argument(FILESTREAM_SORT_RECORD_SIZE_ERROR_MESSAGE);
+			}
+		}
+
+		/// The size of the file.
+		[[nodiscard]] std::uint64_t size() const {
+			return this->fileSize;
+		}
+
+		/// The next record, including its length for variable-length records, valid until the next call.
+		[[nodiscard]] std::optional<std::span<const std::byte>> next() {
+			std::uint64_t size = this->recordSize;
+			if (!size) {
+				if (!this->fill(4)) {
+					// A few stray bytes after the last record are a record cut short, not the end of the file
+					if (this->position != this->end || this->remaining) {
+						BufferStreamThrow::invalid_argument(FILESTREAM_SORT_TRUNCATED_RECORD_ERROR_MESSAGE);
+					}
+					return std::nullopt;
+				}
+				size = 4;
+				for (std::uint64_t i = 0; i < 4; i++) {
+					size += static_cast<std::uint64_t>(this->buffer[this->position + i]) << (8 * i);
+				}
+			}
+			if (!this->fill(size)) {
+				if (this->position == this->end) {
+					return std::nullopt;
+				}
+				BufferStreamThrow::invalid_argument(FILESTREAM_SORT_TRUNCATED_RECORD_ERROR_MESSAGE);
+			}
+			const std::span<const std::byte> record{this->buffer.data() + this->position, size};
+			this->position += size;
+			return record;
+		}
+
+	private:
+		/// Makes sure size bytes are buffered, reading more if they aren't. False if the file ends first.
+		bool fill(std::uint64_t size) {
+			if (this->end - this->position >= size) {
+				return true;
+			}
+			const std::uint64_t kept = this->end - this->position;
+			if (size > this->remaining + kept) {
+				return false;
+			}
+			// Move the start of the record to the front, and read as much after it as fits
+			std::memmove(this->buffer.data(), this->buffer.data() + this->position, kept);
+			if (this->buffer.size() < size) {
+				this->buffer.resize(size);
+			}
+			const std::uint64_t count = std::min(this->remaining, this->buffer.size() - kept);
+			this->file.read(this->buffer.data() + kept, count);
+			this->remaining -= count;
+			this->position = 0;
+			this->end = kept + count;
+			return true;
+		}
+
+		FileStream file;
+		std::uint64_t recordSize;
+		std::vector<std::byte> buffer;
+		std::uint64_t position;
+		std::uint64_t end;
+		std::uint64_t fileSize;
+		std::uint64_t remaining;
+	};
+
+	/// Gathers records into a large buffer, so the file sees a few large writes rather than one per record.
+	class RecordWriter {
+	public:
+		explicit RecordWriter(const std::string& path)
+				: file(path, FileStream::OPT_WRITE | FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT) {
+			if (!this->file) {
+				BufferStreamThrow::invalid_argument(FILESTREAM_SORT_OPEN_ERROR_MESSAGE);
+			}
+			this->buffer.reserve(WRITE_BUFFER_SIZE);
+		}
+
+		void write(std::span<const std::byte> record) {
+			if (this->buffer.size() + record.size() > WRITE_BUFFER_SIZE) {
+				this->flush();
+				if (record.size() > WRITE_BUFFER_SIZE) {
+					this->file.write(record.data(), record.size());
+					this->check();
+					return;
+				}
+			}
+			this->buffer.insert(this->buffer.end(), record.begin(), record.end());
+		}
+
+		/// Writes out what's buffered. Throws if the file couldn't take it, e.g. when the disk is full.
+		void flush() {
+			this->file.write(this->buffer.data(), this->buffer.size());
+			this->buffer.clear();
+			this->file.flush();
+			this->check();
+		}
+
+		~RecordWriter() {
+			try {
+				this->flush();
+			} catch (...) {}
+		}
+
+	private:
+		void check() {
+			if (!this->file) {
+				BufferStreamThrow::invalid_argument(FILESTREAM_SORT_WRITE_ERROR_MESSAGE);
+			}
+		}
+
+		FileStream file;
+		std::vector<std::byte> buffer;
+	};
+
+	/// Names run files, and removes whichever are left when it's destroyed, whether the sort finished or not.
+	class TempFiles {
+	public:
+		explicit TempFiles(std::filesystem::path directory_)
+				: directory(std::move(directory_))
+				, prefix("bufferstream_sort_" + std::to_string(std::random_device{}()) + "_")
+				, counter(0) {}
+
+		TempFiles(const TempFiles&) = delete;
+		TempFiles& operator=(const TempFiles&) = delete;
+
+		~TempFiles() {
+			for (const auto& path : this->paths) {
+				std::error_code ec;
+				std::filesystem::remove(path, ec);
+			}
+		}
+
+		[[nodiscard]] std::filesystem::path create() {
+			return this->paths.emplace_back(this->directory / (this->prefix + std::to_string(this->counter++) + ".run"));
+		}
+
+		void remove(const std::filesystem::path& path) {
+			std::error_code ec;
+			std::filesystem::remove(path, ec);
+			this->paths.erase(std::find(this->paths.begin(), this->paths.end(), path));
+		}
+
+	private:
+		std::filesystem::path directory;
+		std::string prefix;
+		std::uint64_t counter;
+		std::vector<std::filesystem::path> paths;
+	};
+
+	[[nodiscard]] std::span<const std::byte> payload(std::span<const std::byte> record) const {
+		return this->recordSize ? record : record.subspan(4);
+	}
+
+	/// Sorts a run's entries in parallel parts, then merges the parts into path.
+	void sort_run(const std::vector<std::byte>& arena, std::vector<Entry>& entries, const std::string& path) {
+		const std::uint64_t threadCount = std::clamp<std::uint64_t>(this->threads ? this->threads : std::thread::hardware_concurrency(), 1, std::max<std::uint64_t>(entries.size() / 4096, 1));
+		const std::uint64_t partSize = (entries.size() + threadCount - 1) / threadCount;
+		auto sort_part = [this, &arena, &entries, partSize](std::uint64_t part) {
+			const auto first = entries.begin() + static_cast<std::ptrdiff_t>(std::min(entries.size(), part * partSize));
+			const auto last = entries.begin() + static_cast<std::ptrdiff_t>(std::min(entries.size(), (part + 1) * partSize));
+			for (auto it = first; it != last; it++) {
+				it->key.emplace(this->keyOf(this->payload({arena.data() + it->offset, it->size})));
+			}
+			// Entries are in input order, so ties broken by offset keep the sort stable
+			std::sort(first, last, [](const Entry& a, const Entry& b) {
+				if (*a.key < *b.key) {
+					return true;
+				}
+				return !(*b.key < *a.key) && a.offset < b.offset;
+			});
+		};
+		// keyOf may throw on any thread, so every part is finished and joined before the first error is rethrown
+		std::vector<std::exception_ptr> errors(threadCount);
+		auto sort_part_safely = [&sort_part, &errors](std::uint64_t part) {
+			try {
+				sort_part(part);
+			} catch (...) {
+				errors[part] = std::current_exception();
+			}
+		};
+		std::vector<std::thread> workers;
+		try {
+			for (std::uint64_t part = 1; part < threadCount; part++) {
+				workers.emplace_back(sort_part_safely, part);
+			}
+		} catch (const std::system_error&) {
+			// Out of threads; the calling thread sorts the parts that didn't get one
+		}
+		for (std::uint64_t part = workers.size() + 1; part < threadCount; part++) {
+			sort_part_safely(part);
+		}
+		sort_part_safely(0);
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		for (const auto& error : errors) {
+			if (error) {
+				std::rethrow_exception(error);
+			}
+		}
+
+		// The parts are merged as they're written, rather than sorted into one first
+		std::vector<std::uint64_t> heads(threadCount);
+		for (std::uint64_t part = 0; part < threadCount; part++) {
+			heads[part] = std::min(entries.size(), part * partSize);
+		}
+		auto done = [&entries, &heads, partSize](std::uint64_t part) {
+			return heads[part] >= std::min(entries.size(), (part + 1) * partSize);
+		};
+		FileStreamLoserTree tree{threadCount, [&entries, &heads, &done](std::uint64_t a, std::uint64_t b) {
+			return !done(a) && (done(b) || *entries[heads[a]].key < *entries[heads[b]].key);
+		}};
+		RecordWriter out{path};
+		for (std::uint64_t i = 0; i < entries.size(); i++) {
+			const std::uint64_t part = tree.top();
+			const Entry& entry = entries[heads[part]++];
+			out.write({arena.data() + entry.offset, entry.size});
+			tree.replay();
+		}
+		out.flush();
+	}
+
+	/// Merges sorted run files into path, each read through an equal share of the memory budget.
+	void merge_runs(const std::vector<std::filesystem::path>& paths, const std::string& path) {
+		const std::uint64_t bufferSize = std::max(this->memoryBudget / (paths.size() + 1), MIN_MERGE_BUFFER);
+		std::vector<RecordReader> readers;
+		readers.reserve(paths.size());
+		std::vector<std::optional<std::span<const std::byte>>> heads;
+		std::vector<std::optional<Key>> keys(paths.size());
+		for (std::uint64_t i = 0; i < paths.size(); i++) {
+			heads.push_back(readers.emplace_back(paths[i].string(), this->recordSize, bufferSize).next());
+			if (heads[i]) {
+				keys[i].emplace(this->keyOf(this->payload(*heads[i])));
+			}
+		}
+		FileStreamLoserTree tree{paths.size(), [&keys](std::uint64_t a, std::uint64_t b) {
+			return keys[a] && (!keys[b] || *keys[a] < *keys[b]);
+		}};
+		RecordWriter out{path};
+		for (std::uint64_t run = tree.top(); heads[run]; run = tree.top()) {
+			out.write(*heads[run]);
+			heads[run] = readers[run].next();
+			keys[run].reset();
+			if (heads[run]) {
+				keys[run].emplace(this->keyOf(this->payload(*heads[run])));
+			}
+			tree.replay();
+		}
+		out.flush();
+	}
+
+	KeyOf keyOf;
+	std::uint64_t recordSize;
+	std::uint64_t memoryBudget;
+	std::uint64_t threads;
+	std::filesystem::path tempDirectory;
+	std::uint64_t runs;
+	std::uint64_t passes;
+	std::uint64_t records;
+};
@@ -0,0 +1,12 @@
+// Compiled once into bufferstream_compiled, see BUFFERSTREAM_COMPILED_INSTANTIATIONS.
+
+#include <BufferStream.h>
+#include <FileStream.h>
+
+#define BUFFERSTREAM_INSTANTIATION(T) BUFFERSTREAM_INSTANTIATE(, T)
+BUFFERSTREAM_COMMON_TYPES(BUFFERSTREAM_INSTANTIATION)
+#undef BUFFERSTREAM_INSTANTIATION
+
+#define FILESTREAM_INSTANTIATION(T) FILESTREAM_INSTANTIATE(, T)
+BUFFERSTREAM_COMMON_TYPES(FILESTREAM_INSTANTIATION)
+#undef FILESTREAM_INSTANTIATION
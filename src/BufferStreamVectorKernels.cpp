@@ -0,0 +1,4 @@
+// Added to every target that links bufferstream, so the vector kernels are installed in every program
+// without each file that uses BufferStream having to parse the intrinsics headers.
+
+#include <BufferStreamVectorKernels.h>
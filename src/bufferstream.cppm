@@ -0,0 +1,73 @@
+// Module interface for BufferStream and FileStream, built when BUFFERSTREAM_BUILD_MODULE is enabled.
+// Importers get the classes and concepts without parsing the standard headers behind them.
+// Macros and the error message constants aren't exported.
+
+module;
+
+#include <BufferStream.h>
+#include <BufferStreamCRC32C.h>
+#include <BufferStreamGorilla.h>
+#include <BufferStreamHash.h>
+#include <BufferStreamRLE.h>
+#include <BufferStreamVectorKernels.h>
+#include <FileStream.h>
+#include <FileStreamColumnar.h>
+#include <FileStreamCompressed.h>
+#include <FileStreamSort.h>
+#include <FileStreamSortedTable.h>
+
+export module bufferstream;
+
+export using ::BufferStreamPODType;
+export using ::BufferStreamPODByteType;
+export using ::BufferStreamPossiblyNonContiguousContainer;
+export using ::BufferStreamNonResizableContiguousContainer;
+export using ::BufferStreamResizableContiguousContainer;
+export using ::BufferStreamPossiblyNonContiguousResizableContainer;
+
+export using ::BufferStreamCPU;
+export using ::BufferStreamKernels;
+export using ::BufferStreamDispatch;
+export using ::BufferStreamVectorKernels;
+export using ::BufferStreamLZ;
+export using ::BufferStreamRLE;
+export using ::BufferStreamBitWriter;
+export using ::BufferStreamBitReader;
+export using ::BufferStreamGorilla;
+export using ::BufferStreamGorillaWriter;
+export using ::BufferStreamGorillaReader;
+export using ::BufferStreamCRC32C;
+export using ::BufferStreamHashLanes;
+export using ::BufferStreamHashMD5;
+export using ::BufferStreamHashSHA256;
+export using ::BufferStreamHashKernels;
+export using ::BufferStreamHash;
+export using ::BufferStreamMD5;
+export using ::BufferStreamSHA256;
+export using ::BufferStreamStridedLayout;
+export using ::BufferStreamThrow;
+export using ::BufferStreamFixedString;
+export using ::BufferStream;
+export using ::BufferStreamReadOnly;
+
+export using ::FileStreamLatencyHistogram;
+export using ::FileStreamLatencyHistograms;
+export using ::FileStreamLatencyTimer;
+export using ::FileStreamBlockCache;
+export using ::FileStreamAccessPatternDetector;
+export using ::FileStreamNativeFile;
+export using ::FileStreamSegment;
+export using ::FileStream;
+export using ::FileStreamCompressedFormat;
+export using ::FileStreamCompressedWriter;
+export using ::FileStreamCompressedReader;
+export using ::FileStreamColumnarType;
+export using ::FileStreamColumnarFormat;
+export using ::FileStreamColumnarWriter;
+export using ::FileStreamColumnarReader;
+export using ::FileStreamMappedFile;
+export using ::FileStreamSortedTableFormat;
+export using ::FileStreamSortedTableWriter;
+export using ::FileStreamSortedTableReader;
+export using ::FileStreamLoserTree;
+export using ::FileStreamSorter;
@@ -0,0 +1,211 @@
+// Verifies the documented allocation-free APIs never touch the heap.
+// This is its own test executable because it replaces the global allocation functions.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+
+#include <BufferStream.h>
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations{0};
+std::atomic<std::uint64_t> g_deallocations{0};
+
+void* counted_allocate(std::size_t size) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void* counted_allocate_aligned(std::size_t size, std::align_val_t alignment) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	const auto align = static_cast<std::size_t>(alignment);
+	if (void* ptr = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void counted_deallocate(void* ptr) {
+	if (ptr) {
+		g_deallocations.fetch_add(1, std::memory_order_relaxed);
+		std::free(ptr);
+	}
+}
+
+/// Counts allocations and deallocations made during its lifetime.
+class AllocationCounter {
+public:
+	AllocationCounter()
+			: allocations(g_allocations.load())
+			, deallocations(g_deallocations.load()) {}
+
+	[[nodiscard]] std::uint64_t count() const {
+		return g_allocations.load() - this->allocations + g_deallocations.load() - this->deallocations;
+	}
+
+private:
+	std::uint64_t allocations;
+	std::uint64_t deallocations;
+};
+
+struct POD {
+	int x;
+	int y;
+};
+
+} // namespace
+
+void* operator new(std::size_t size) { return counted_allocate(size); }
+void* operator new[](std::size_t size) { return counted_allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { try { return counted_allocate(size); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { try { return counted_allocate(size); } catch (...) { return nullptr; } }
+void* operator new(std::size_t size, std::align_val_t alignment) { return counted_allocate_aligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return counted_allocate_aligned(size, alignment); }
+void operator delete(void* ptr) noexcept { counted_deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { counted_deallocate(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { counted_deallocate(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { counted_deallocate(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { counted_deallocate(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { counted_deallocate(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { counted_deallocate(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { counted_deallocate(ptr); }
+
+TEST(Allocation, counter_works) {
+	AllocationCounter counter;
+	void* volatile ptr = ::operator new(sizeof(int));
+	::operator delete(ptr);
+	EXPECT_EQ(counter.count(), 2);
+}
+
+TEST(Allocation, scalar_reads) {
+	std::array<std::byte, 64> buffer{};
+	BufferStream stream{buffer};
+
+	AllocationCounter counter;
+	std::uint32_t x = 0;
+	stream.read(x);
+	stream >> x;
+	[[maybe_unused]] auto y = stream.read<double>();
+	[[maybe_unused]] auto pod = stream.read<POD>();
+	[[maybe_unused]] auto ints = stream.read<std::int16_t, 4>();
+	stream.set_big_endian(true);
+	[[maybe_unused]] auto z = stream.read<std::uint64_t>();
+	[[maybe_unused]] auto b = stream.peek();
+	EXPECT_EQ(counter.count(), 0);
+}
+
+TEST(Allocation, scalar_writes) {
+	std::array<std::byte, 64> buffer{};
+	BufferStream stream{buffer};
+
+	AllocationCounter counter;
+	stream.write(std::uint32_t{1}) << 2.0 << POD{3, 4};
+	stream.write(std::array<std::int16_t, 4>{});
+	stream.set_big_endian(true).write(std::uint64_t{5});
+	EXPECT_EQ(counter.count(), 0);
+}
+
+TEST(Allocation, span_reads) {
+	std::array<std::uint32_t, 16> buffer{};
+	BufferStream stream{buffer};
+
+	AllocationCounter counter;
+	[[maybe_unused]] auto span = stream.read_span<std::uint32_t>(4);
+	std::span<std::uint32_t> view;
+	stream.read(view, 4);
+	std::array<std::uint32_t, 4> backing{};
+	std::span<std::uint32_t> copy{backing};
+	stream.read(copy);
+	[[maybe_unused]] auto atSpan = stream.at_span<std::uint32_t>(2, 8);
+	std::uint32_t raw[2]{};
+	stream.read(raw, 2);
+	EXPECT_EQ(counter.count(), 0);
+}
+
+TEST(Allocation, at) {
+	std::array<std::uint32_t, 16> buffer{};
+	BufferStreamReadOnly stream{buffer};
+
+	AllocationCounter counter;
+	[[maybe_unused]] auto a = stream.at(4);
+	[[maybe_unused]] auto b = stream.at<std::uint32_t>(4);
+	[[maybe_unused]] auto c = stream.at<std::uint32_t, 2>(4);
+	[[maybe_unused]] auto d = stream.at_bytes<4>(8);
+	[[maybe_unused]] auto e = stream.at<std::uint16_t>(2, std::ios::end);
+	EXPECT_EQ(counter.count(), 0);
+}
+
+TEST(Allocation, pre_reserved_writes) {
+	std::vector<std::byte> buffer(256);
+	BufferStream stream{buffer};
+	const std::array<std::uint32_t, 8> ints{1, 2, 3, 4, 5, 6, 7, 8};
+	const std::vector<char> chars(16, 'a');
+
+	AllocationCounter counter;
+	stream << std::uint64_t{1} << ints << chars;
+	stream.write(std::string_view{"Hello world"});
+	stream.write(std::span<const std::uint32_t>{ints});
+	stream.write(ints.data(), ints.size());
+	EXPECT_EQ(counter.count(), 0);
+	EXPECT_EQ(buffer.size(), 256);
+}
+
+TEST(Allocation, string_view_reads) {
+	std::string buffer = "Hello world";
+	buffer.push_back('\0');
+	buffer += "Goodbye";
+	buffer.push_back('\0');
+	BufferStream stream{buffer};
+
+	AllocationCounter counter;
+	const auto hello = stream.read_string_view();
+	const auto goodbye = stream.read_string_view(8);
+	const auto atHello = stream.at_string_view(0);
+	const auto atWorld = stream.at_string_view(5, false, 6);
+	EXPECT_EQ(counter.count(), 0);
+
+	EXPECT_EQ(hello, "Hello world");
+	EXPECT_EQ(goodbye, "Goodbye");
+	EXPECT_EQ(atHello, "Hello world");
+	EXPECT_EQ(atWorld, "world");
+	EXPECT_EQ(stream.tell(), buffer.size());
+}
+
+TEST(Allocation, fixed_string_reads) {
+	std::string buffer = "Hello world";
+	buffer.push_back('\0');
+	BufferStream stream{buffer};
+
+	AllocationCounter counter;
+	const auto hello = stream.read_fixed_string<32>();
+	const auto world = stream.at_fixed_string<8>(5, false, 6);
+	EXPECT_EQ(counter.count(), 0);
+
+	EXPECT_EQ(hello, "Hello world");
+	EXPECT_EQ(world, "world");
+}
+
+TEST(Allocation, arena_reads) {
+	std::string buffer = "Hello world";
+	buffer.push_back('\0');
+	buffer += "abcdefgh";
+	BufferStream stream{buffer};
+	std::array<std::byte, 256> storage{};
+	std::pmr::monotonic_buffer_resource arena{storage.data(), storage.size(), std::pmr::null_memory_resource()};
+
+	AllocationCounter counter;
+	[[maybe_unused]] auto hello = stream.read_string(&arena);
+	[[maybe_unused]] auto bytes = stream.read_bytes(4, &arena);
+	[[maybe_unused]] auto ints = stream.read<std::pmr::vector<std::uint16_t>>(2, &arena);
+	[[maybe_unused]] auto atBytes = stream.at_bytes(4, 0, &arena);
+	std::array<std::byte, 4> into{};
+	stream.seek(0).read_bytes_into(into);
+	EXPECT_EQ(counter.count(), 0);
+}
@@ -2,6 +2,10 @@
 
 #include <deque>
 
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#endif
+
 #include <BufferStream.h>
 
 struct POD {
@@ -134,6 +138,24 @@ TEST(BufferStream, seek) {
 	} catch (const std::overflow_error&) {}
 }
 
+TEST(BufferStream, bytes) {
+	std::array<std::uint8_t, 8> buffer{0, 1, 2, 3, 4, 5, 6, 7};
+	BufferStream stream{buffer};
+	stream.skip(5);
+
+	const auto bytes = stream.bytes(2, 3);
+	EXPECT_EQ(bytes.data(), stream.data() + 2);
+	EXPECT_EQ(bytes.size(), 3);
+	EXPECT_EQ(bytes[2], std::byte{4});
+	EXPECT_EQ(stream.tell(), 5);
+	EXPECT_TRUE(stream.bytes(8, 0).empty());
+
+	stream.set_exceptions_enabled(false);
+	EXPECT_THROW((void) stream.bytes(6, 3), std::overflow_error);
+	EXPECT_THROW((void) stream.bytes(9, 0), std::overflow_error);
+	EXPECT_THROW((void) stream.bytes(1, UINT64_MAX), std::overflow_error);
+}
+
 TEST(BufferStream, skip) {
 	std::vector<unsigned char> buffer;
 	buffer.resize(8);
@@ -152,6 +174,14 @@ TEST(BufferStream, skip) {
 
 	stream.skip<std::int16_t>(-1);
 	EXPECT_EQ(stream.tell(), 3);
+
+	stream.skip_u<std::int16_t>(2);
+	EXPECT_EQ(stream.tell(), 3 + 2 * sizeof(std::int16_t));
+
+	// Counts whose byte size wraps around 64 bits are still out of range
+	EXPECT_THROW(stream.skip_u<std::int32_t>(UINT64_MAX / 2), std::overflow_error);
+	EXPECT_THROW(stream.skip<std::int16_t>(-4), std::overflow_error);
+	EXPECT_EQ(stream.tell(), 3 + 2 * sizeof(std::int16_t));
 }
 
 TEST(BufferStream, read_int_ref) {
@@ -812,6 +842,195 @@ TEST(BufferStream, read_string) {
 	stream.seek(0);
 }
 
+TEST(BufferStream, read_string_view) {
+	std::string buffer = "Hello world";
+	buffer.push_back('\0');
+	buffer.push_back('\0');
+	buffer.push_back('\0');
+	BufferStream stream{buffer};
+
+	EXPECT_EQ(stream.read_string_view(), "Hello world");
+	EXPECT_EQ(stream.tell(), 12);
+	stream.seek(0);
+
+	EXPECT_EQ(stream.read_string_view(5), "Hello");
+	stream.seek(0);
+
+	EXPECT_EQ(stream.read_string_view(13).size(), 11);
+	EXPECT_EQ(stream.tell(), 13);
+	stream.seek(0);
+
+	EXPECT_EQ(stream.read_string_view(13, false).size(), 13);
+	EXPECT_EQ(stream.tell(), 13);
+
+	std::string unterminated = "Hello";
+	BufferStream unterminatedStream{unterminated};
+	try {
+		std::ignore = unterminatedStream.read_string_view();
+		FAIL();
+	} catch (const std::overflow_error&) {}
+}
+
+TEST(BufferStream, read_strided) {
+	// 8x8 image of 16-bit pixels, where each pixel holds (row << 8) | column
+	std::array<std::uint16_t, 64> image{};
+	for (std::uint16_t row = 0; row < 8; row++) {
+		for (std::uint16_t column = 0; column < 8; column++) {
+			image[row * 8 + column] = static_cast<std::uint16_t>(row << 8 | column);
+		}
+	}
+	BufferStream stream{image};
+
+	std::array<std::uint16_t, 12> tile{};
+	stream.seek((2 * 8 + 1) * sizeof(std::uint16_t)).read_strided(std::span{tile}, 3, 4, 8);
+	for (std::uint16_t row = 0; row < 3; row++) {
+		for (std::uint16_t column = 0; column < 4; column++) {
+			EXPECT_EQ(tile[row * 4 + column], (row + 2) << 8 | (column + 1));
+		}
+	}
+	EXPECT_EQ(stream.tell(), (4 * 8 + 5) * sizeof(std::uint16_t));
+
+	stream.set_big_endian(true).seek(0).read_strided(std::span{tile}, 3, 4, 8);
+	EXPECT_EQ(tile[5], 0x0101);
+	EXPECT_EQ(tile[6], 0x0201);
+	stream.set_big_endian(false);
+
+	// Every other column of every other row, as a 3D layout of 2 planes of 2x2
+	std::array<std::uint16_t, 8> sparse{};
+	stream.seek(0).read_strided(std::span{sparse}, BufferStreamStridedLayout<3>{{2, 2, 2}, {32, 16, 2}});
+	EXPECT_EQ(sparse, (std::array<std::uint16_t, 8>{0x0000, 0x0002, 0x0200, 0x0202, 0x0400, 0x0402, 0x0600, 0x0602}));
+
+	std::array<std::uint16_t, 4> small{};
+	try {
+		stream.seek(0).read_strided(std::span{small}, 3, 4, 8);
+		FAIL();
+	} catch (const std::invalid_argument&) {}
+	try {
+		stream.seek(50 * sizeof(std::uint16_t)).read_strided(std::span{tile}, 3, 4, 8);
+		FAIL();
+	} catch (const std::overflow_error&) {}
+	EXPECT_EQ(stream.tell(), 50 * sizeof(std::uint16_t));
+
+	// Layouts whose span or element count wrap around 64 bits
+	try {
+		stream.seek(0).read_strided(std::span{tile}, BufferStreamStridedLayout<1>{{3}, {std::uint64_t{1} << 63}});
+		FAIL();
+	} catch (const std::overflow_error&) {}
+	try {
+		stream.seek(0).read_strided(std::span{tile}, BufferStreamStridedLayout<2>{{std::uint64_t{1} << 32, std::uint64_t{1} << 32}, {0, 0}});
+		FAIL();
+	} catch (const std::overflow_error&) {}
+	stream.set_exceptions_enabled(false).seek(0).read_strided(std::span{tile}, BufferStreamStridedLayout<1>{{3}, {std::uint64_t{1} << 63}});
+	EXPECT_EQ(stream.tell(), 0);
+	stream.set_exceptions_enabled(true);
+}
+
+TEST(BufferStream, read_column) {
+	struct Record {
+		std::uint64_t timestamp;
+		std::uint32_t flags;
+		std::uint32_t id;
+		std::byte padding[32];
+	};
+	static_assert(sizeof(Record) == 48);
+
+	std::vector<Record> records(11);
+	for (std::uint32_t i = 0; i < records.size(); i++) {
+		records[i].id = 0x1000 + i;
+	}
+	BufferStream stream{records};
+
+	std::array<std::uint32_t, 11> ids{};
+	stream.read_column(0, sizeof(Record), offsetof(Record, id), ids.size(), std::span{ids});
+	for (std::uint32_t i = 0; i < ids.size(); i++) {
+		EXPECT_EQ(ids[i], 0x1000 + i);
+	}
+	EXPECT_EQ(stream.tell(), stream.size());
+
+	std::array<std::uint32_t, 3> some{};
+	stream.set_big_endian(true).read_column(2 * sizeof(Record), sizeof(Record), offsetof(Record, id), some.size(), std::span{some});
+	EXPECT_EQ(some[0], 0x02100000);
+	EXPECT_EQ(some[2], 0x04100000);
+	EXPECT_EQ(stream.tell(), 5 * sizeof(Record));
+
+	// The last record only needs to be long enough to hold the field
+	BufferStream shortStream{reinterpret_cast<std::byte*>(records.data()), records.size() * sizeof(Record) - 32};
+	EXPECT_NO_THROW(shortStream.read_column(0, sizeof(Record), offsetof(Record, id), ids.size(), std::span{ids}));
+	try {
+		shortStream.read_column(sizeof(Record), sizeof(Record), offsetof(Record, id), ids.size(), std::span{ids});
+		FAIL();
+	} catch (const std::overflow_error&) {}
+	try {
+		shortStream.read_column(0, sizeof(Record), offsetof(Record, id), ids.size(), std::span{some});
+		FAIL();
+	} catch (const std::invalid_argument&) {}
+}
+
+TEST(BufferStream, read_fixed_string) {
+	std::string buffer = "Hello world";
+	buffer.push_back('\0');
+	buffer += "Hi";
+	buffer.push_back('\0');
+	buffer.push_back('\0');
+	BufferStream stream{buffer};
+
+	const auto hello = stream.read_fixed_string<16>();
+	EXPECT_EQ(hello, "Hello world");
+	EXPECT_EQ(hello.size(), 11);
+	EXPECT_EQ(std::string_view{hello}, "Hello world");
+	EXPECT_STREQ(hello.c_str(), "Hello world");
+	EXPECT_EQ(stream.tell(), 12);
+
+	const auto hi = stream.read_fixed_string<8>(3);
+	EXPECT_EQ(hi, "Hi");
+	EXPECT_EQ(stream.tell(), 15);
+
+	EXPECT_EQ(stream.seek(0).read_fixed_string<5>(5), "Hello");
+	try {
+		std::ignore = stream.seek(0).read_fixed_string<4>();
+		FAIL();
+	} catch (const std::overflow_error&) {}
+	EXPECT_EQ(stream.tell(), 0);
+
+	stream.set_exceptions_enabled(false);
+	EXPECT_EQ(stream.read_fixed_string<4>(), "Hell");
+	EXPECT_EQ(stream.tell(), 12);
+}
+
+TEST(BufferStream, read_with_allocator) {
+	std::string buffer = "Hello world";
+	buffer.push_back('\0');
+	buffer += "abcdefgh";
+	BufferStream stream{buffer};
+
+	// Nothing can be allocated outside the arena
+	std::array<std::byte, 1024> storage{};
+	std::pmr::monotonic_buffer_resource arena{storage.data(), storage.size(), std::pmr::null_memory_resource()};
+
+	const std::pmr::string hello = stream.read_string(&arena);
+	EXPECT_EQ(hello, "Hello world");
+	EXPECT_EQ(hello.get_allocator().resource(), &arena);
+
+	const auto bytes = stream.read_bytes(4, &arena);
+	EXPECT_EQ(bytes.size(), 4);
+	EXPECT_EQ(bytes[0], std::byte{'a'});
+
+	const auto chars = stream.read<std::pmr::vector<char>>(4, &arena);
+	EXPECT_EQ(chars.back(), 'h');
+
+	const std::pmr::string world = stream.seek(6).read_string(5, false, &arena);
+	EXPECT_EQ(world, "world");
+
+	const auto atBytes = stream.at_bytes(3, 12, &arena);
+	EXPECT_EQ(atBytes[2], std::byte{'c'});
+	EXPECT_EQ(stream.tell(), 11);
+
+	std::array<std::byte, 5> into{};
+	stream.seek(0).read_bytes_into(into);
+	EXPECT_EQ(into[4], std::byte{'o'});
+	EXPECT_EQ(stream.tell(), 5);
+}
+
 TEST(BufferStream, read_bytes) {
 	{
 		int x = 10;
@@ -907,6 +1126,32 @@ TEST(BufferStream, at_string) {
 	EXPECT_EQ(stream.at_string(13, false, 0).size(), 13);
 }
 
+TEST(BufferStream, at_string_view) {
+	std::string buffer = "Hello world";
+	buffer.push_back('\0');
+	buffer.push_back('\0');
+	buffer.push_back('\0');
+	BufferStream stream{buffer};
+
+	EXPECT_EQ(stream.at_string_view(0), "Hello world");
+	EXPECT_EQ(stream.at_string_view(6), "world");
+	EXPECT_EQ(stream.at_string_view(5, false, 0), "Hello");
+	EXPECT_EQ(stream.at_string_view(13, true, 0).size(), 11);
+	EXPECT_EQ(stream.at_string_view(13, false, 0).size(), 13);
+	EXPECT_EQ(stream.tell(), 0);
+}
+
+TEST(BufferStream, at_fixed_string) {
+	std::string buffer = "Hello world";
+	buffer.push_back('\0');
+	BufferStream stream{buffer};
+
+	EXPECT_EQ(stream.at_fixed_string<16>(0), "Hello world");
+	EXPECT_EQ(stream.at_fixed_string<16>(5, false, 6), "world");
+	EXPECT_EQ(stream.at_fixed_string_u<16>(6), "world");
+	EXPECT_EQ(stream.tell(), 0);
+}
+
 TEST(BufferStream, at_bytes) {
 	{
 		int x = 10;
@@ -933,3 +1178,67 @@ TEST(BufferStream, peek) {
 	EXPECT_EQ(stream.seek(1).peek(), std::byte{'e'});
 	EXPECT_EQ(stream.seek(2).peek<char>(), 'l');
 }
+
+TEST(BufferStream, read_huge_count) {
+	std::array<std::uint32_t, 4> buffer{};
+	BufferStream stream{buffer};
+
+	// sizeof(T) * n wraps around to 0 here, which must not pass the bounds check
+	std::vector<std::uint32_t> out;
+	EXPECT_THROW(stream.read(out, (UINT64_MAX / 4) + 1), std::overflow_error);
+	EXPECT_THROW((void) stream.read_span<std::uint64_t>(UINT64_MAX / 8 + 2), std::overflow_error);
+	EXPECT_THROW((void) stream.read_string_view(UINT64_MAX), std::overflow_error);
+	EXPECT_THROW(stream.write(buffer.data(), (UINT64_MAX / 4) + 1), std::overflow_error);
+	EXPECT_EQ(stream.tell(), 0);
+}
+
+#if __has_include(<sys/mman.h>)
+TEST(BufferStream, buffer_over_4gb) {
+	// Untouched pages of an anonymous mapping are never allocated, so this only costs the pages written to
+	constexpr std::uint64_t size = 5ull * 1024 * 1024 * 1024;
+	void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mapping == MAP_FAILED) {
+		GTEST_SKIP() << "Can't map 5 GiB of address space";
+	}
+
+	BufferStream stream{static_cast<std::byte*>(mapping), size};
+	EXPECT_EQ(stream.size(), size);
+
+	// An array straddling the 4 GiB boundary
+	constexpr std::uint64_t boundary = 4ull * 1024 * 1024 * 1024;
+	std::array<std::uint64_t, 64> values{};
+	for (std::uint64_t i = 0; i < values.size(); i++) {
+		values[i] = boundary + i;
+	}
+	stream.seek_u(boundary - 256).write(values);
+	EXPECT_EQ(stream.tell(), boundary + 256);
+
+	stream.set_big_endian(true).seek_u(boundary + 1024).write(values).set_big_endian(false);
+
+	stream.seek_u(boundary - 256);
+	std::array<std::uint64_t, 64> valuesIn{};
+	stream.read(valuesIn);
+	EXPECT_EQ(valuesIn, values);
+
+	// Skips of more than 2^31 elements, in both directions
+	stream.seek_u(0).skip_u<std::uint32_t>((boundary + 1024) / sizeof(std::uint32_t));
+	EXPECT_EQ(stream.tell(), boundary + 1024);
+	stream.set_big_endian(true);
+	stream.read(valuesIn);
+	EXPECT_EQ(valuesIn, values);
+	stream.skip<std::uint64_t>(-static_cast<std::int64_t>((boundary + 1024 + sizeof(values)) / sizeof(std::uint64_t)));
+	EXPECT_EQ(stream.tell(), 0);
+	stream.set_big_endian(false);
+
+	// Spans, views and positions past 4 GiB
+	const auto span = stream.seek_u(boundary - 256).read_span<std::uint64_t>(values.size());
+	EXPECT_EQ(span.front(), boundary);
+	EXPECT_EQ(span.back(), boundary + values.size() - 1);
+	EXPECT_EQ(stream.at<std::uint64_t>(boundary - 256 + 8), boundary + 1);
+	EXPECT_EQ(stream.seek(-8, std::ios::cur).read<std::uint64_t>(), boundary + values.size() - 1);
+	EXPECT_EQ(stream.seek_u(8, std::ios::end).tell(), size - 8);
+	EXPECT_THROW((void) stream.read_span<std::uint64_t>(2), std::overflow_error);
+
+	::munmap(mapping, size);
+}
+#endif
@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+
+#include <string_view>
+#include <vector>
+
+#include <BufferStreamCRC32C.h>
+#include <BufferStreamHash.h>
+
+namespace {
+
+std::vector<std::byte> noise(std::uint64_t n) {
+	std::vector<std::byte> bytes(n);
+	std::uint64_t state = 3;
+	for (auto& byte : bytes) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		byte = static_cast<std::byte>(state >> 56);
+	}
+	return bytes;
+}
+
+std::span<const std::byte> as_bytes(std::string_view str) {
+	return std::as_bytes(std::span{str});
+}
+
+template<std::uint64_t N>
+std::string hex(const std::array<std::byte, N>& digest) {
+	constexpr std::string_view DIGITS = "0123456789abcdef";
+	std::string out;
+	for (auto byte : digest) {
+		out += DIGITS[static_cast<std::uint8_t>(byte) >> 4];
+		out += DIGITS[static_cast<std::uint8_t>(byte) & 15];
+	}
+	return out;
+}
+
+} // namespace
+
+TEST(Checksum, crc32c_known_values) {
+	EXPECT_EQ(BufferStreamCRC32C::compute({}), 0);
+	EXPECT_EQ(BufferStreamCRC32C::compute(as_bytes("123456789")), 0xE3069283);
+	EXPECT_EQ(BufferStreamCRC32C::compute(as_bytes("The quick brown fox jumps over the lazy dog")), 0x22620404);
+	const std::vector<std::byte> zeros(32);
+	EXPECT_EQ(BufferStreamCRC32C::compute(zeros), 0x8A9136AA);
+
+	// Continuing from an earlier checksum is the same as checksumming everything at once
+	EXPECT_EQ(BufferStreamCRC32C::compute(as_bytes("6789"), BufferStreamCRC32C::compute(as_bytes("12345"))), 0xE3069283);
+}
+
+TEST(Checksum, crc32c_every_level) {
+	const auto bytes = noise(40000);
+	for (auto level : {BufferStreamCPU::LEVEL_SCALAR, BufferStreamCPU::LEVEL_SSE42, BufferStreamCPU::LEVEL_AVX2, BufferStreamCPU::LEVEL_AVX512}) {
+		if (level > BufferStreamCPU::detected()) {
+			continue;
+		}
+		SCOPED_TRACE(BufferStreamCPU::name(level));
+		BufferStreamDispatch::force(level);
+		// Lengths around the 8-byte words and the three interleaved streams, at every alignment
+		for (std::uint64_t n : {0, 1, 7, 8, 9, 100, 12287, 12288, 12289, 24576 + 13, 39990}) {
+			for (std::uint64_t offset = 0; offset < 8; offset++) {
+				const auto* data = bytes.data() + offset;
+				EXPECT_EQ(BufferStreamDispatch::kernels().crc32c(0x12345678, data, n), BufferStreamKernels::crc32c_scalar(0x12345678, data, n)) << n << " bytes at offset " << offset;
+			}
+		}
+	}
+	BufferStreamDispatch::reset();
+}
+
+TEST(Checksum, crc32c_combine) {
+	const auto bytes = noise(5000);
+	const std::span all{bytes};
+	const auto expected = BufferStreamCRC32C::compute(all);
+	for (std::uint64_t split : {0, 1, 3, 64, 2500, 4999, 5000}) {
+		const auto a = BufferStreamCRC32C::compute(all.first(split));
+		const auto b = BufferStreamCRC32C::compute(all.subspan(split));
+		EXPECT_EQ(BufferStreamCRC32C::combine(a, b, bytes.size() - split), expected) << split;
+	}
+}
+
+TEST(Checksum, crc32c_parallel) {
+	const auto bytes = noise(1000003);
+	const auto expected = BufferStreamCRC32C::compute(bytes);
+
+	// Small segments so the test splits a megabyte many ways
+	for (std::uint64_t threads = 1; threads <= 8; threads++) {
+		EXPECT_EQ(BufferStreamCRC32C::compute_parallel(bytes, 0, threads, 1000), expected) << threads << " threads";
+	}
+	EXPECT_EQ(BufferStreamCRC32C::compute_parallel(bytes), expected);
+	EXPECT_EQ(BufferStreamCRC32C::compute_parallel(std::span{bytes}.subspan(7, 5), 0, 4, 1), BufferStreamCRC32C::compute(std::span{bytes}.subspan(7, 5)));
+	EXPECT_EQ(BufferStreamCRC32C::compute_parallel(std::span<const std::byte>{}, 0, 4, 1), 0);
+
+	const auto start = BufferStreamCRC32C::compute(as_bytes("prefix"));
+	EXPECT_EQ(BufferStreamCRC32C::compute_parallel(bytes, start, 3, 1000), BufferStreamCRC32C::compute(bytes, start));
+}
+
+TEST(Checksum, crc32c_stream_range) {
+	auto bytes = noise(3000);
+	BufferStreamReadOnly stream{bytes};
+	stream.seek_u(10);
+	EXPECT_EQ(BufferStreamCRC32C::compute(stream, 100, 2000), BufferStreamCRC32C::compute(std::span{bytes}.subspan(100, 2000)));
+	EXPECT_EQ(BufferStreamCRC32C::compute_parallel(stream, 100, 2000, 0, 3, 100), BufferStreamCRC32C::compute(std::span{bytes}.subspan(100, 2000)));
+	EXPECT_EQ(BufferStreamCRC32C::compute(stream, 3000, 0), 0);
+	EXPECT_EQ(stream.tell(), 10);
+
+	EXPECT_THROW((void) BufferStreamCRC32C::compute(stream, 2000, 1001), std::overflow_error);
+	EXPECT_THROW((void) BufferStreamCRC32C::compute(stream, 3001, 0), std::overflow_error);
+	EXPECT_THROW((void) BufferStreamCRC32C::compute_parallel(stream, 1, ~std::uint64_t{0}), std::overflow_error);
+}
+
+TEST(Checksum, md5_known_values) {
+	EXPECT_EQ(hex(BufferStreamMD5::hash({})), "d41d8cd98f00b204e9800998ecf8427e");
+	EXPECT_EQ(hex(BufferStreamMD5::hash(as_bytes("a"))), "0cc175b9c0f1b6a831c399e269772661");
+	EXPECT_EQ(hex(BufferStreamMD5::hash(as_bytes("abc"))), "900150983cd24fb0d6963f7d28e17f72");
+	EXPECT_EQ(hex(BufferStreamMD5::hash(as_bytes("message digest"))), "f96b697d7cb7938d525a2f31aaf161d0");
+	EXPECT_EQ(hex(BufferStreamMD5::hash(as_bytes("abcdefghijklmnopqrstuvwxyz"))), "c3fcd3d76192e4007dfb496cca67e13b");
+	EXPECT_EQ(hex(BufferStreamMD5::hash(as_bytes("12345678901234567890123456789012345678901234567890123456789012345678901234567890"))), "57edf4a22be3c955ac49da2e2107b67a");
+}
+
+TEST(Checksum, sha256_known_values) {
+	EXPECT_EQ(hex(BufferStreamSHA256::hash({})), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+	EXPECT_EQ(hex(BufferStreamSHA256::hash(as_bytes("abc"))), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	EXPECT_EQ(hex(BufferStreamSHA256::hash(as_bytes("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"))), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+	const std::string million(1000000, 'a');
+	EXPECT_EQ(hex(BufferStreamSHA256::hash(as_bytes(million))), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+	// The SHA extensions and the portable code agree, whichever one hash() picked
+#ifdef BUFFERSTREAM_X86
+	if (BufferStreamCPU::has_sha() && BufferStreamCPU::detected() >= BufferStreamCPU::LEVEL_SSE42) {
+		const auto bytes = noise(64 * 100);
+		auto state = BufferStreamHashSHA256::INITIAL_STATE;
+		auto expected = state;
+		BufferStreamHashSHA256::sha_ni(state.data(), bytes.data(), 100);
+		BufferStreamHashSHA256::scalar(expected.data(), bytes.data(), 100);
+		EXPECT_EQ(state, expected);
+	}
+#endif
+	BufferStreamDispatch::force(BufferStreamCPU::LEVEL_SCALAR);
+	EXPECT_EQ(hex(BufferStreamSHA256::hash(as_bytes(million))), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+	BufferStreamDispatch::reset();
+}
+
+TEST(Checksum, hash_incremental) {
+	const auto bytes = noise(1000);
+	const std::span all{bytes};
+	BufferStreamSHA256 sha;
+	BufferStreamMD5 md5;
+	// Pieces that end inside, on and across block boundaries
+	for (std::uint64_t start = 0, size = 1; start < bytes.size(); start += size, size = size * 3 % 97 + 1) {
+		const auto piece = all.subspan(start, std::min(size, bytes.size() - start));
+		sha.update(piece);
+		md5.update(piece);
+		if (start < 500 && start + size >= 500) {
+			EXPECT_EQ(sha.digest(), BufferStreamSHA256::hash(all.first(start + piece.size())));
+		}
+	}
+	EXPECT_EQ(sha.digest(), BufferStreamSHA256::hash(all));
+	EXPECT_EQ(md5.digest(), BufferStreamMD5::hash(all));
+	EXPECT_EQ(sha.reset().update(as_bytes("abc")).digest(), BufferStreamSHA256::hash(as_bytes("abc")));
+}
+
+TEST(Checksum, hash_many_every_level) {
+	const auto bytes = noise(20000);
+	std::vector<std::span<const std::byte>> inputs;
+	// Lengths around where the padding needs a second block, and a few long ones that outlast the short ones
+	for (std::uint64_t size : {0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 3000, 100, 7, 9000, 64, 2, 0, 513, 17, 4096}) {
+		inputs.push_back(std::span{bytes}.subspan(inputs.size() * 31, size));
+	}
+	std::vector<BufferStreamMD5::Digest> md5;
+	std::vector<BufferStreamSHA256::Digest> sha;
+	for (const auto input : inputs) {
+		md5.push_back(BufferStreamMD5::hash(input));
+		sha.push_back(BufferStreamSHA256::hash(input));
+	}
+
+	for (auto level : {BufferStreamCPU::LEVEL_SCALAR, BufferStreamCPU::LEVEL_SSE42, BufferStreamCPU::LEVEL_AVX2, BufferStreamCPU::LEVEL_AVX512}) {
+		if (level > BufferStreamCPU::detected()) {
+			continue;
+		}
+		SCOPED_TRACE(BufferStreamCPU::name(level));
+		BufferStreamDispatch::force(level);
+		EXPECT_EQ(BufferStreamMD5::hash_many(inputs), md5);
+		EXPECT_EQ(BufferStreamSHA256::hash_many(inputs), sha);
+		EXPECT_EQ(BufferStreamMD5::hash_many(std::span{inputs}.first(3)), std::vector(md5.begin(), md5.begin() + 3));
+		EXPECT_TRUE(BufferStreamSHA256::hash_many({}).empty());
+
+		// Every lane kernel against the scalar one directly, since hash_many() may not use the narrower ones
+		const auto lanes = BufferStreamHashKernels<BufferStreamHashSHA256>::lanes(level);
+		std::vector<std::uint32_t> state(8 * lanes.count);
+		std::vector<const std::byte*> data(lanes.count);
+		for (std::uint64_t lane = 0; lane < lanes.count; lane++) {
+			data[lane] = bytes.data() + lane * 64;
+			for (std::uint64_t word = 0; word < 8; word++) {
+				state[word * lanes.count + lane] = BufferStreamHashSHA256::INITIAL_STATE[word];
+			}
+		}
+		lanes.kernel(state.data(), data.data(), 3);
+		for (std::uint64_t lane = 0; lane < lanes.count; lane++) {
+			auto expected = BufferStreamHashSHA256::INITIAL_STATE;
+			BufferStreamHashSHA256::scalar(expected.data(), bytes.data() + lane * 64, 3);
+			for (std::uint64_t word = 0; word < 8; word++) {
+				EXPECT_EQ(state[word * lanes.count + lane], expected[word]) << "lane " << lane;
+			}
+		}
+	}
+	BufferStreamDispatch::reset();
+}
+
+TEST(Checksum, hash_stream_range) {
+	auto bytes = noise(3000);
+	BufferStreamReadOnly stream{bytes};
+	stream.seek_u(10);
+	const auto expected = BufferStreamSHA256::hash(std::span{bytes}.subspan(100, 2000));
+	EXPECT_EQ(BufferStreamSHA256::hash(stream, 100, 2000), expected);
+	EXPECT_EQ(BufferStreamSHA256{}.update(stream, 100, 1000).update(stream, 1100, 1000).digest(), expected);
+
+	const std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges{{100, 2000}, {0, 3000}, {3000, 0}, {5, 5}};
+	const auto digests = BufferStreamSHA256::hash_many(stream, ranges);
+	ASSERT_EQ(digests.size(), ranges.size());
+	EXPECT_EQ(digests[0], expected);
+	EXPECT_EQ(digests[1], BufferStreamSHA256::hash(bytes));
+	EXPECT_EQ(digests[2], BufferStreamSHA256::hash({}));
+	EXPECT_EQ(BufferStreamMD5::hash_many(stream, ranges)[3], BufferStreamMD5::hash(std::span{bytes}.subspan(5, 5)));
+	EXPECT_EQ(stream.tell(), 10);
+
+	EXPECT_THROW((void) BufferStreamMD5::hash(stream, 2000, 1001), std::overflow_error);
+	const std::vector<std::pair<std::uint64_t, std::uint64_t>> bad{{0, 10}, {2999, 2}};
+	EXPECT_THROW((void) BufferStreamSHA256::hash_many(stream, bad), std::overflow_error);
+}
@@ -0,0 +1,661 @@
+#include <gtest/gtest.h>
+
+#include <numeric>
+#include <random>
+
+#include <BufferStreamGorilla.h>
+#include <BufferStreamRLE.h>
+#include <FileStreamColumnar.h>
+#include <FileStreamCompressed.h>
+
+namespace {
+
+std::string temp_file_path(std::string_view name) {
+	return (std::filesystem::temp_directory_path() / "bufferstream_test" / name).string();
+}
+
+std::vector<std::byte> round_trip(const std::vector<std::byte>& in) {
+	std::vector<std::byte> compressed;
+	BufferStreamLZ::compress(in, compressed);
+	EXPECT_LE(compressed.size(), BufferStreamLZ::max_compressed_size(in.size()));
+	std::vector<std::byte> out(in.size());
+	EXPECT_TRUE(BufferStreamLZ::decompress(compressed, out));
+	return out;
+}
+
+std::vector<std::byte> bytes_of(std::initializer_list<int> values) {
+	std::vector<std::byte> out;
+	for (int value : values) {
+		out.push_back(static_cast<std::byte>(value));
+	}
+	return out;
+}
+
+} // namespace
+
+TEST(Compressed, lz_round_trip) {
+	EXPECT_TRUE(round_trip({}).empty());
+
+	std::vector<std::byte> small{std::byte{1}, std::byte{2}, std::byte{3}};
+	EXPECT_EQ(round_trip(small), small);
+
+	// Runs, which compress to overlapping matches
+	std::vector<std::byte> run(10000, std::byte{'a'});
+	EXPECT_EQ(round_trip(run), run);
+	std::vector<std::byte> compressed;
+	BufferStreamLZ::compress(run, compressed);
+	EXPECT_LT(compressed.size(), run.size() / 50);
+
+	// Repeats further back than the largest offset, and noise that doesn't compress at all
+	std::vector<std::byte> mixed(300000);
+	std::uint64_t state = 1;
+	for (std::uint64_t i = 0; i < mixed.size(); i++) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		mixed[i] = i > 1000 && (state >> 60) < 12 ? mixed[i - 1 - (state >> 20) % 900] : static_cast<std::byte>(state >> 56);
+	}
+	EXPECT_EQ(round_trip(mixed), mixed);
+	for (std::uint64_t i = 0; i < 70000; i++) {
+		mixed[i] = static_cast<std::byte>(i * 31);
+	}
+	EXPECT_EQ(round_trip(mixed), mixed);
+}
+
+TEST(Compressed, lz_malformed) {
+	std::vector<std::byte> in(4096);
+	for (std::uint64_t i = 0; i < in.size(); i++) {
+		in[i] = static_cast<std::byte>(i % 100);
+	}
+	std::vector<std::byte> compressed;
+	BufferStreamLZ::compress(in, compressed);
+	std::vector<std::byte> out(in.size());
+
+	// Truncated, or decompressing to the wrong size
+	EXPECT_FALSE(BufferStreamLZ::decompress(std::span{compressed}.first(compressed.size() - 1), out));
+	std::vector<std::byte> shortOut(in.size() - 1);
+	EXPECT_FALSE(BufferStreamLZ::decompress(compressed, shortOut));
+	std::vector<std::byte> longOut(in.size() + 1);
+	EXPECT_FALSE(BufferStreamLZ::decompress(compressed, longOut));
+
+	// A match reaching back before the start of the output
+	const std::vector<std::byte> badOffset{std::byte{0x10}, std::byte{'x'}, std::byte{0x02}, std::byte{0x00}};
+	std::vector<std::byte> badOut(5);
+	EXPECT_FALSE(BufferStreamLZ::decompress(badOffset, badOut));
+
+	// Flipping any byte must never read or write out of bounds
+	for (std::uint64_t i = 0; i < compressed.size(); i++) {
+		auto corrupt = compressed;
+		corrupt[i] ^= std::byte{0x5a};
+		(void) BufferStreamLZ::decompress(corrupt, out);
+	}
+}
+
+TEST(Compressed, read_write) {
+	const auto path = temp_file_path("compressed.bsz");
+	std::vector<std::uint32_t> values(10000);
+	for (std::uint64_t i = 0; i < values.size(); i++) {
+		values[i] = static_cast<std::uint32_t>(i / 3);
+	}
+	{
+		FileStreamCompressedWriter writer{path, 1024};
+		writer.write(std::uint16_t{0xabcd}).write(std::string{"header"});
+		writer.write(values);
+		writer.set_big_endian(true).write(std::uint32_t{0x01020304});
+		EXPECT_EQ(writer.tell(), 2 + 7 + values.size() * 4 + 4);
+	}
+	EXPECT_LT(std::filesystem::file_size(path), values.size() * 4 / 2);
+
+	FileStreamCompressedReader reader{path, 2};
+	ASSERT_TRUE(reader);
+	EXPECT_EQ(reader.size(), 2 + 7 + values.size() * 4 + 4);
+	EXPECT_EQ(reader.block_size(), 1024);
+	EXPECT_EQ(reader.block_count(), (reader.size() + 1023) / 1024);
+	EXPECT_EQ(reader.blocks_decompressed(), 0);
+
+	EXPECT_EQ(reader.read<std::uint16_t>(), 0xabcd);
+	EXPECT_EQ(reader.read_string(), "header");
+	std::vector<std::uint32_t> valuesIn;
+	reader.read(valuesIn, values.size());
+	EXPECT_EQ(valuesIn, values);
+	EXPECT_EQ(reader.set_big_endian(true).read<std::uint32_t>(), 0x01020304);
+	EXPECT_EQ(reader.tell(), reader.size());
+	EXPECT_THROW((void) reader.read<std::uint8_t>(), std::overflow_error);
+	reader.set_big_endian(false);
+
+	// Random access only decompresses the block it touches
+	FileStreamCompressedReader random{path, 2};
+	EXPECT_EQ(random.at<std::uint32_t>(9 + 4 * 5000), values[5000]);
+	EXPECT_EQ(random.blocks_decompressed(), 1);
+	EXPECT_EQ(random.at<std::uint32_t>(9 + 4 * 5001), values[5001]);
+	EXPECT_EQ(random.blocks_decompressed(), 1);
+	EXPECT_EQ(random.tell(), 0);
+
+	// A value straddling two blocks
+	EXPECT_EQ(random.seek_u(1022).read<std::uint32_t>(), random.at<std::uint32_t>(1022));
+	EXPECT_EQ(random.blocks_decompressed(), 3);
+
+	EXPECT_EQ(random.seek_u(4, std::ios::end).set_big_endian(true).read<std::uint32_t>(), 0x01020304);
+	random.set_big_endian(false);
+	EXPECT_EQ(random.seek(-8, std::ios::cur).read<std::uint32_t>(), values.back());
+	EXPECT_THROW(random.seek_u(reader.size() + 1), std::overflow_error);
+	EXPECT_THROW(random.seek(-1), std::overflow_error);
+	EXPECT_EQ(random.at_bytes(3, 4).size(), 3);
+
+	std::filesystem::remove(path);
+}
+
+TEST(Compressed, corrupt) {
+	const auto path = temp_file_path("corrupt.bsz");
+	{
+		FileStreamCompressedWriter writer{path, 256};
+		for (std::uint32_t i = 0; i < 1000; i++) {
+			writer.write(i % 7);
+		}
+	}
+	const auto size = std::filesystem::file_size(path);
+
+	// Not a container
+	EXPECT_FALSE(FileStreamCompressedReader{temp_file_path("missing.bsz")});
+	{
+		std::vector<std::byte> bytes(size);
+		FileStream{path}.read(bytes.data(), bytes.size());
+		FileStream{path, FileStream::OPT_TRUNCATE}.write(bytes.data(), bytes.size() - 1);
+		EXPECT_FALSE(FileStreamCompressedReader{path});
+		bytes[size - 20] = std::byte{0xff};
+		FileStream{path, FileStream::OPT_TRUNCATE}.write(bytes.data(), bytes.size());
+		EXPECT_FALSE(FileStreamCompressedReader{path});
+		bytes[size - 20] = std::byte{0};
+		FileStream{path, FileStream::OPT_TRUNCATE}.write(bytes.data(), bytes.size());
+	}
+
+	// A corrupt block is reported when it's read, and the blocks around it are still readable
+	FileStreamCompressedReader good{path};
+	ASSERT_TRUE(good);
+	FileStream{path, FileStream::OPT_READ | FileStream::OPT_WRITE}.seek_out_u(FileStreamCompressedFormat::HEADER_SIZE).write(std::uint32_t{0xffffffff});
+
+	FileStreamCompressedReader reader{path};
+	ASSERT_TRUE(reader);
+	EXPECT_THROW((void) reader.read<std::uint32_t>(), std::invalid_argument);
+	EXPECT_EQ(reader.at<std::uint32_t>(256), 64 % 7);
+	EXPECT_THROW((void) reader.at<std::uint32_t>(0), std::invalid_argument);
+
+	reader.set_exceptions_enabled(false);
+	EXPECT_EQ(reader.seek_u(0).read<std::uint32_t>(), 0);
+
+	std::filesystem::remove(path);
+}
+
+TEST(Compressed, parallel_write) {
+	std::vector<std::uint64_t> values(200000);
+	std::uint64_t state = 7;
+	for (auto& value : values) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		value = (state >> 40) % 1000;
+	}
+	const auto write = [&values](const std::string& path, std::uint64_t threads, std::uint64_t maxBlocksInFlight) {
+		FileStreamCompressedWriter writer{path, 4096, threads, maxBlocksInFlight};
+		// Small writes and large ones, both crossing block boundaries
+		for (std::uint64_t i = 0; i < 1000; i++) {
+			writer.write(values[i]);
+		}
+		writer.write(values.data() + 1000, values.size() - 1000);
+		writer.write(std::string{"end"});
+		writer.finish();
+	};
+
+	const auto path = temp_file_path("parallel_1.bsz");
+	write(path, 1, 0);
+	std::vector<std::byte> expected(std::filesystem::file_size(path));
+	FileStream{path}.read(expected.data(), expected.size());
+
+	// The file doesn't depend on how many threads compressed it, or how many blocks were in flight
+	for (const auto& [threads, maxBlocksInFlight] : {std::pair{2, 0}, std::pair{4, 1}, std::pair{4, 3}, std::pair{8, 64}}) {
+		const auto parallelPath = temp_file_path("parallel_n.bsz");
+		write(parallelPath, threads, maxBlocksInFlight);
+		std::vector<std::byte> bytes(std::filesystem::file_size(parallelPath));
+		FileStream{parallelPath}.read(bytes.data(), bytes.size());
+		EXPECT_EQ(bytes, expected) << threads << " threads, " << maxBlocksInFlight << " blocks in flight";
+		std::filesystem::remove(parallelPath);
+	}
+
+	FileStreamCompressedReader reader{path};
+	ASSERT_TRUE(reader);
+	std::vector<std::uint64_t> valuesIn;
+	reader.read(valuesIn, values.size());
+	EXPECT_EQ(valuesIn, values);
+	EXPECT_EQ(reader.read_string(), "end");
+
+	// Destroying the writer without finishing still writes every block in order
+	{
+		FileStreamCompressedWriter writer{path, 1024, 3, 2};
+		writer.write(values);
+	}
+	FileStreamCompressedReader unfinished{path};
+	ASSERT_TRUE(unfinished);
+	EXPECT_EQ(unfinished.at<std::uint64_t>(8 * 12345), values[12345]);
+	std::filesystem::remove(path);
+}
+
+TEST(Compressed, rle_known_packets) {
+	// The example from Apple's PackBits technote
+	auto packed = bytes_of({0xfe, 0xaa, 0x02, 0x80, 0x00, 0x2a, 0xfd, 0xaa, 0x03, 0x80, 0x00, 0x2a, 0x22, 0xf7, 0xaa, 0x80});
+	const auto unpacked = bytes_of({0xaa, 0xaa, 0xaa, 0x80, 0x00, 0x2a, 0xaa, 0xaa, 0xaa, 0xaa, 0x80, 0x00, 0x2a, 0x22,
+		0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa});
+	BufferStream in{packed};
+	std::vector<std::byte> out(unpacked.size());
+	EXPECT_EQ(BufferStreamRLE::decode_packbits(in, out), out.size());
+	EXPECT_EQ(out, unpacked);
+	EXPECT_EQ(in.tell(), packed.size() - 1);
+
+	// TGA with 3-byte pixels: a run of 3, then 2 literal pixels
+	auto tga = bytes_of({0x82, 1, 2, 3, 0x01, 4, 5, 6, 7, 8, 9});
+	BufferStream tgaIn{tga};
+	std::vector<std::byte> pixels(15);
+	EXPECT_EQ(BufferStreamRLE::decode_tga(tgaIn, pixels, 3), pixels.size());
+	EXPECT_EQ(pixels, bytes_of({1, 2, 3, 1, 2, 3, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+
+	std::vector<std::byte> encoded;
+	BufferStream tgaOut{encoded};
+	BufferStreamRLE::encode_tga(tgaOut, pixels, 3);
+	encoded.resize(tgaOut.tell());
+	EXPECT_EQ(encoded, tga);
+}
+
+TEST(Compressed, rle_round_trip) {
+	std::uint64_t state = 5;
+	const auto random = [&state] {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return state >> 33;
+	};
+	for (std::uint64_t elementSize : {1, 2, 3, 4, 7}) {
+		// Noise, short and long runs, and runs of single bytes that don't line up with the elements
+		std::vector<std::byte> data;
+		while (data.size() < 20000 * elementSize) {
+			std::vector<std::byte> element(elementSize);
+			for (auto& byte : element) {
+				byte = static_cast<std::byte>(random() % 4 ? random() : 0);
+			}
+			const std::uint64_t repeat = random() % 3 ? 1 : random() % 300 + 1;
+			for (std::uint64_t i = 0; i < repeat; i++) {
+				data.insert(data.end(), element.begin(), element.end());
+			}
+		}
+		data.resize(data.size() / elementSize * elementSize);
+
+		for (bool tga : {false, true}) {
+			SCOPED_TRACE(tga ? "tga" : "packbits");
+			std::vector<std::byte> encoded;
+			BufferStream out{encoded};
+			(tga ? BufferStreamRLE::encode_tga : BufferStreamRLE::encode_packbits)(out, data, elementSize);
+			encoded.resize(out.tell());
+			EXPECT_LE(encoded.size(), BufferStreamRLE::max_encoded_size(data.size(), elementSize));
+			EXPECT_LT(encoded.size(), data.size() * 3 / 4) << elementSize << " byte elements";
+
+			BufferStream in{encoded};
+			std::vector<std::byte> decoded(data.size());
+			EXPECT_EQ((tga ? BufferStreamRLE::decode_tga : BufferStreamRLE::decode_packbits)(in, decoded, elementSize), decoded.size());
+			EXPECT_EQ(decoded, data) << elementSize << " byte elements";
+			EXPECT_EQ(in.tell(), encoded.size());
+		}
+	}
+
+	// Nothing repeats at all, or everything does
+	for (std::uint64_t size : {0, 1, 2, 127, 128, 129, 1000}) {
+		std::vector<std::byte> noise(size);
+		for (auto& byte : noise) {
+			byte = static_cast<std::byte>(random());
+		}
+		const std::vector<std::byte> same(size, std::byte{9});
+		for (const auto& data : {noise, same}) {
+			std::vector<std::byte> encoded;
+			BufferStream out{encoded};
+			BufferStreamRLE::encode_packbits(out, data);
+			encoded.resize(out.tell());
+			EXPECT_LE(encoded.size(), BufferStreamRLE::max_encoded_size(size));
+			BufferStream in{encoded};
+			std::vector<std::byte> decoded(size);
+			EXPECT_EQ(BufferStreamRLE::decode_packbits(in, decoded), size);
+			EXPECT_EQ(decoded, data) << size;
+		}
+	}
+}
+
+TEST(Compressed, rle_malformed) {
+	std::vector<std::byte> out(8);
+
+	// Running out of input, a run longer than the output, and data that isn't whole elements
+	auto truncated = bytes_of({0x05, 1, 2});
+	BufferStream truncatedIn{truncated};
+	EXPECT_THROW((void) BufferStreamRLE::decode_packbits(truncatedIn, out), std::overflow_error);
+	auto overrun = bytes_of({0xf0, 1});
+	BufferStream overrunIn{overrun};
+	EXPECT_THROW((void) BufferStreamRLE::decode_packbits(overrunIn, out), std::invalid_argument);
+	BufferStream elementIn{overrun};
+	EXPECT_THROW((void) BufferStreamRLE::decode_tga(elementIn, out, 3), std::invalid_argument);
+	std::vector<std::byte> encoded;
+	BufferStream encodeOut{encoded};
+	EXPECT_THROW(BufferStreamRLE::encode_tga(encodeOut, out, 3), std::invalid_argument);
+
+	// Without exceptions, decoding stops before the bad packet
+	auto partial = bytes_of({0x81, 7, 0x7f, 1});
+	BufferStream partialIn{partial};
+	partialIn.set_exceptions_enabled(false);
+	EXPECT_EQ(BufferStreamRLE::decode_tga(partialIn, out, 1), 2);
+	EXPECT_EQ(out[1], std::byte{7});
+	EXPECT_EQ(partialIn.tell(), 2);
+}
+
+TEST(Compressed, bits_round_trip) {
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> fields;
+	std::uint64_t state = 12345;
+	for (std::uint32_t i = 0; i < 2000; i++) {
+		state = state * 6364136223846793005 + 1442695040888963407;
+		fields.emplace_back(state, i % 65);
+	}
+
+	std::vector<std::byte> buffer;
+	BufferStream out{buffer};
+	BufferStreamBitWriter writer{out};
+	std::uint64_t total = 0;
+	for (auto [value, count] : fields) {
+		writer.write(value, count);
+		total += count;
+	}
+	writer.flush().write(std::uint8_t{0xee});
+	ASSERT_EQ(out.tell(), (total + 7) / 8 + 1);
+
+	BufferStream in{buffer};
+	BufferStreamBitReader reader{in};
+	for (auto [value, count] : fields) {
+		const std::uint64_t mask = count == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << count) - 1;
+		ASSERT_EQ(reader.read_long(count), value & mask) << count << " bits";
+	}
+	EXPECT_EQ(reader.sync().read<std::uint8_t>(), 0xee);
+
+	BufferStream oneByte{buffer.data(), 1};
+	BufferStreamBitReader shortReader{oneByte};
+	EXPECT_EQ(shortReader.read(8), static_cast<std::uint8_t>(buffer[0]));
+	EXPECT_THROW((void) shortReader.read(1), std::overflow_error);
+
+	// Unary prefixes, and reading past the end with exceptions disabled
+	const auto bytes = bytes_of({0b11101100, 0b01111111});
+	BufferStream prefixes{const_cast<std::byte*>(bytes.data()), bytes.size()};
+	prefixes.set_exceptions_enabled(false);
+	BufferStreamBitReader unary{prefixes};
+	EXPECT_EQ(unary.read_ones(6), 3);
+	EXPECT_EQ(unary.read_ones(6), 2);
+	EXPECT_EQ(unary.read_ones(6), 0);
+	EXPECT_EQ(unary.read_ones(6), 0);
+	EXPECT_EQ(unary.read_ones(6), 6);
+	EXPECT_FALSE(unary.overrun());
+	EXPECT_EQ(unary.read(1), 1);
+	EXPECT_EQ(unary.read(2), 0);
+	EXPECT_TRUE(unary.overrun());
+}
+
+TEST(Compressed, gorilla_round_trip) {
+	// Millisecond samples in nanoseconds with some jitter, a slowly drifting reading, and the odd outlier
+	std::vector<std::int64_t> timestamps;
+	std::vector<double> values;
+	std::int64_t timestamp = 1'700'000'000'000'000'000;
+	double reading = 21.5;
+	for (std::uint64_t i = 0; i < 10000; i++) {
+		timestamp += 1'000'000 + (i % 50 == 0 ? static_cast<std::int64_t>(i % 7) * 1000 - 3000 : 0);
+		if (i % 20 == 0) {
+			reading += (static_cast<double>(i % 9) - 4.0) * 0.25;
+		}
+		timestamps.push_back(timestamp);
+		values.push_back(reading);
+	}
+	timestamps.insert(timestamps.end(), {INT64_MAX, INT64_MIN, 0, -1, INT64_MAX});
+	values.insert(values.end(), {std::numeric_limits<double>::quiet_NaN(), -0.0, std::numeric_limits<double>::infinity(), 1e-300, std::numeric_limits<double>::denorm_min()});
+
+	std::vector<std::byte> buffer;
+	BufferStream out{buffer};
+	{
+		BufferStreamGorillaWriter writer{out};
+		writer.write(timestamps, values);
+		EXPECT_EQ(writer.size(), timestamps.size());
+	}
+	out.write(std::uint8_t{0xee});
+	const std::uint64_t encoded = out.tell() - 1;
+	EXPECT_LT(encoded * 8, timestamps.size() * 16) << encoded << " bytes";
+
+	BufferStream in{buffer};
+	BufferStreamGorillaReader reader{in};
+	std::vector<std::int64_t> decodedTimestamps(timestamps.size() + 10);
+	std::vector<double> decodedValues(values.size() + 10);
+	std::uint64_t decoded = 0;
+	// Batches that don't line up with anything
+	while (const std::uint64_t n = reader.read(std::span{decodedTimestamps}.subspan(decoded, std::min<std::uint64_t>(333, decodedTimestamps.size() - decoded)), std::span{decodedValues}.subspan(decoded))) {
+		decoded += n;
+	}
+	EXPECT_TRUE(reader.done());
+	ASSERT_EQ(decoded, timestamps.size());
+	EXPECT_EQ(in.tell(), encoded);
+	EXPECT_EQ(in.read<std::uint8_t>(), 0xee);
+	for (std::uint64_t i = 0; i < decoded; i++) {
+		ASSERT_EQ(decodedTimestamps[i], timestamps[i]) << i;
+		ASSERT_EQ(std::bit_cast<std::uint64_t>(decodedValues[i]), std::bit_cast<std::uint64_t>(values[i])) << i;
+	}
+
+	// An empty series is just the end code
+	std::vector<std::byte> empty;
+	BufferStream emptyStream{empty};
+	BufferStreamGorillaWriter{emptyStream}.finish();
+	EXPECT_EQ(emptyStream.tell(), 1);
+	emptyStream.seek_u(0);
+	BufferStreamGorillaReader emptyReader{emptyStream};
+	EXPECT_EQ(emptyReader.read(std::span{decodedTimestamps}, std::span{decodedValues}), 0);
+	EXPECT_TRUE(emptyReader.done());
+}
+
+TEST(Compressed, gorilla_malformed) {
+	std::vector<std::byte> buffer;
+	BufferStream out{buffer};
+	BufferStreamGorillaWriter writer{out};
+	for (std::int64_t i = 0; i < 100; i++) {
+		writer.write(i * 60, static_cast<double>(i % 10) * 1.5);
+	}
+	const std::int64_t timestamps[1]{};
+	const double values[2]{};
+	EXPECT_THROW(writer.write(std::span{timestamps}, std::span{values}), std::invalid_argument);
+	const std::uint64_t size = writer.finish().tell();
+
+	// Cut off before the end code
+	std::vector<std::int64_t> decodedTimestamps(200);
+	std::vector<double> decodedValues(200);
+	BufferStream cut{buffer.data(), size / 2};
+	BufferStreamGorillaReader throwing{cut};
+	EXPECT_THROW((void) throwing.read(std::span{decodedTimestamps}, std::span{decodedValues}), std::overflow_error);
+
+	cut.seek_u(0).set_exceptions_enabled(false);
+	BufferStreamGorillaReader lenient{cut};
+	const std::uint64_t decoded = lenient.read(std::span{decodedTimestamps}, std::span{decodedValues});
+	EXPECT_GT(decoded, 0);
+	EXPECT_LT(decoded, 100);
+	EXPECT_TRUE(lenient.done());
+	for (std::uint64_t i = 0; i < decoded; i++) {
+		EXPECT_EQ(decodedTimestamps[i], static_cast<std::int64_t>(i) * 60);
+	}
+
+	// A value window past the end of its 64 bits: 0 timestamp code, 11 value code, 31 leading zeros and a length of 64
+	const auto corrupt = bytes_of({0b01111111, 0b11111111, 0, 0});
+	BufferStream corruptStream{const_cast<std::byte*>(corrupt.data()), corrupt.size()};
+	BufferStreamGorillaReader corruptReader{corruptStream};
+	EXPECT_THROW((void) corruptReader.read(std::span{decodedTimestamps}, std::span{decodedValues}), std::invalid_argument);
+}
+
+TEST(Compressed, columnar_round_trip) {
+	const auto path = temp_file_path("columnar.bsc");
+	constexpr std::uint64_t rows = 2500;
+	std::vector<std::int64_t> ids(rows);
+	std::vector<std::int32_t> sensors(rows);
+	std::vector<double> prices(rows);
+	std::vector<float> noise(rows);
+	std::vector<std::int64_t> hashes(rows);
+	std::mt19937_64 random{7};
+	for (std::uint64_t i = 0; i < rows; i++) {
+		ids[i] = 1000 + static_cast<std::int64_t>(i) * 3;
+		sensors[i] = static_cast<std::int32_t>(random() % 5) - 2;
+		prices[i] = std::array{9.99, 19.99, 4.5}[random() % 3];
+		noise[i] = static_cast<float>(random() % 100000) / 7.0f;
+		hashes[i] = static_cast<std::int64_t>(random());
+	}
+	prices[1] = std::numeric_limits<double>::quiet_NaN();
+
+	using Format = FileStreamColumnarFormat;
+	{
+		FileStreamColumnarWriter writer{path, {{"id", Format::TYPE_INT64}, {"sensor", Format::TYPE_INT32}, {"price", Format::TYPE_DOUBLE}, {"noise", Format::TYPE_FLOAT}, {"hash", Format::TYPE_INT64}}, 1000};
+		ASSERT_TRUE(writer);
+		// Columns are written in batches of their own, and row groups go out once every column has enough
+		writer.write<std::int64_t>(0, ids);
+		writer.write<std::int32_t>(1, std::span{sensors}.first(1500)).write<std::int32_t>(1, std::span{sensors}.subspan(1500));
+		for (std::uint64_t i = 0; i < rows; i += 100) {
+			writer.write<double>(2, std::span{prices}.subspan(i, 100));
+		}
+		writer.write<float>(3, noise);
+		EXPECT_EQ(writer.row_group_count(), 0);
+		writer.write<std::int64_t>(4, hashes);
+		EXPECT_EQ(writer.row_group_count(), 2);
+		EXPECT_THROW(writer.write<float>(0, noise), std::invalid_argument);
+		EXPECT_THROW(writer.write<float>(5, noise), std::invalid_argument);
+		writer.finish();
+		EXPECT_EQ(writer.row_group_count(), 3);
+	}
+
+	FileStreamColumnarReader reader{path};
+	ASSERT_TRUE(reader);
+	ASSERT_EQ(reader.columns().size(), 5);
+	EXPECT_EQ(reader.columns()[3].name, "noise");
+	EXPECT_EQ(reader.columns()[3].type, Format::TYPE_FLOAT);
+	EXPECT_EQ(reader.find_column("price"), 2);
+	EXPECT_EQ(reader.find_column("missing"), std::nullopt);
+	EXPECT_EQ(reader.row_count(), rows);
+	ASSERT_EQ(reader.row_group_count(), 3);
+	EXPECT_EQ(reader.row_group(2).rows, 500);
+
+	// Each chunk gets the encoding that suits it
+	EXPECT_EQ(reader.row_group(0).chunks[0].encoding, Format::ENCODING_DELTA);
+	EXPECT_EQ(reader.row_group(0).chunks[1].encoding, Format::ENCODING_BIT_PACKED);
+	EXPECT_EQ(reader.row_group(0).chunks[2].encoding, Format::ENCODING_DICTIONARY);
+	EXPECT_EQ(reader.row_group(0).chunks[3].encoding, Format::ENCODING_PLAIN);
+	EXPECT_EQ(reader.row_group(0).chunks[4].encoding, Format::ENCODING_PLAIN);
+	EXPECT_LT(reader.row_group(0).chunks[0].size, 32);
+
+	// Only the chunks asked for are read
+	std::vector<std::int64_t> idsIn;
+	std::vector<double> pricesIn;
+	std::vector<float> noiseIn;
+	reader.read(0, idsIn).read(3, noiseIn);
+	EXPECT_EQ(idsIn, ids);
+	EXPECT_EQ(noiseIn, noise);
+	EXPECT_EQ(reader.chunks_read(), 6);
+	reader.read(2, pricesIn);
+	ASSERT_EQ(pricesIn.size(), rows);
+	EXPECT_TRUE(std::isnan(pricesIn[1]));
+	pricesIn[1] = prices[1] = 0;
+	EXPECT_EQ(pricesIn, prices);
+	std::vector<std::int32_t> sensorsIn;
+	reader.read(1, sensorsIn);
+	EXPECT_EQ(sensorsIn, sensors);
+	std::vector<std::int64_t> hashesIn;
+	reader.read(1, 4, hashesIn);
+	EXPECT_TRUE(std::equal(hashesIn.begin(), hashesIn.end(), hashes.begin() + 1000));
+
+	// Statistics leave NaNs out, and skip the row groups a range rules out
+	EXPECT_EQ(reader.statistics<std::int64_t>(1, 0), std::make_pair(std::int64_t{4000}, std::int64_t{6997}));
+	EXPECT_EQ(reader.statistics<double>(0, 2), std::make_pair(4.5, 19.99));
+	EXPECT_EQ(reader.row_groups_overlapping<std::int64_t>(0, 5000, 5003), std::vector<std::uint64_t>{1});
+	EXPECT_EQ(reader.row_groups_overlapping<std::int64_t>(0, 6997, 7000), (std::vector<std::uint64_t>{1, 2}));
+	EXPECT_TRUE(reader.row_groups_overlapping<std::int64_t>(0, 0, 999).empty());
+	EXPECT_THROW((void) reader.statistics<float>(0, 0), std::invalid_argument);
+	EXPECT_THROW(reader.read(3, 0, idsIn), std::invalid_argument);
+
+	reader.set_exceptions_enabled(false);
+	reader.read(0, 3, idsIn);
+	EXPECT_TRUE(idsIn.empty());
+
+	std::filesystem::remove(path);
+}
+
+TEST(Compressed, columnar_malformed) {
+	using Format = FileStreamColumnarFormat;
+	std::vector<std::int32_t> values(100);
+	std::iota(values.begin(), values.end(), 0);
+
+	// Chunk encodings reject data that doesn't decode to the values asked for
+	std::vector<std::byte> encoded;
+	Format::Chunk chunk{};
+	Format::encode_chunk<std::int32_t>(values, encoded, chunk);
+	EXPECT_EQ(chunk.encoding, Format::ENCODING_DELTA);
+	std::vector<std::int32_t> out(values.size());
+	EXPECT_TRUE(Format::decode_chunk<std::int32_t>(chunk.encoding, encoded, out));
+	EXPECT_EQ(out, values);
+	EXPECT_FALSE(Format::decode_chunk<std::int32_t>(chunk.encoding, std::span{encoded}.first(10), out));
+	EXPECT_FALSE(Format::decode_chunk<std::int32_t>(Format::ENCODING_PLAIN, encoded, out));
+	EXPECT_FALSE(Format::decode_chunk<std::int32_t>(Format::ENCODING_COUNT, encoded, out));
+	const auto dictionary = bytes_of({2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 2, 0b01001000});
+	std::vector<std::int32_t> small(3);
+	EXPECT_TRUE(Format::decode_chunk<std::int32_t>(Format::ENCODING_DICTIONARY, dictionary, std::span{small}.first(2)));
+	EXPECT_EQ(small[0], 2);
+	EXPECT_EQ(small[1], 1);
+	// The third index is 2, past the end of the dictionary
+	EXPECT_FALSE(Format::decode_chunk<std::int32_t>(Format::ENCODING_DICTIONARY, dictionary, small));
+	std::vector<double> doubles(3);
+	EXPECT_FALSE(Format::decode_chunk<double>(Format::ENCODING_DELTA, encoded, doubles));
+
+	const auto path = temp_file_path("malformed.bsc");
+	{
+		FileStreamColumnarWriter writer{path, {{"a", Format::TYPE_INT32}, {"b", Format::TYPE_INT32}}, 64};
+		writer.write<std::int32_t>(0, values).write<std::int32_t>(1, values);
+	}
+	{
+		// Columns of different lengths
+		FileStreamColumnarWriter writer{temp_file_path("uneven.bsc"), {{"a", Format::TYPE_INT32}, {"b", Format::TYPE_INT32}}};
+		writer.write<std::int32_t>(0, values).write<std::int32_t>(1, std::span{values}.first(99));
+		EXPECT_THROW(writer.finish(), std::invalid_argument);
+		std::filesystem::remove(temp_file_path("uneven.bsc"));
+	}
+	const auto size = std::filesystem::file_size(path);
+
+	EXPECT_FALSE(FileStreamColumnarReader{temp_file_path("missing.bsc")});
+	std::vector<std::byte> bytes(size);
+	FileStream{path}.read(bytes.data(), bytes.size());
+	auto rewrite = [&path](const std::vector<std::byte>& contents) {
+		FileStream{path, FileStream::OPT_TRUNCATE}.write(contents.data(), contents.size());
+	};
+	rewrite(std::vector<std::byte>(bytes.begin(), bytes.end() - 1));
+	EXPECT_FALSE(FileStreamColumnarReader{path});
+	// Every byte of the metadata and trailer matters, so flipping any of them either fails validation or still reads
+	for (std::uint64_t i = size - 100; i < size; i++) {
+		auto flipped = bytes;
+		flipped[i] ^= std::byte{0x80};
+		rewrite(flipped);
+		FileStreamColumnarReader reader{path};
+		if (reader) {
+			reader.set_exceptions_enabled(false);
+			std::vector<std::int32_t> column;
+			for (std::uint64_t c = 0; c < reader.columns().size(); c++) {
+				reader.read(c, column);
+			}
+		}
+	}
+
+	// A corrupt chunk is reported when it's read, and the chunks around it are still readable
+	rewrite(bytes);
+	FileStreamColumnarReader good{path};
+	ASSERT_TRUE(good);
+	const auto firstChunk = good.row_group(0).chunks[0];
+	FileStream{path, FileStream::OPT_READ | FileStream::OPT_WRITE}.seek_out_u(firstChunk.offset + 16).write(std::uint8_t{64});
+	FileStreamColumnarReader reader{path};
+	ASSERT_TRUE(reader);
+	std::vector<std::int32_t> column;
+	EXPECT_THROW(reader.read(0, 0, column), std::invalid_argument);
+	reader.read(0, 1, column);
+	EXPECT_TRUE(std::equal(column.begin(), column.end(), values.begin()));
+	reader.set_exceptions_enabled(false);
+	reader.read(0, 0, column);
+	EXPECT_EQ(column, std::vector<std::int32_t>(64));
+
+	std::filesystem::remove(path);
+}
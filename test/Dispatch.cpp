@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <BufferStream.h>
+#include <BufferStreamVectorKernels.h>
+
+namespace {
+
+/// Runs fn once with each level's kernels this host can run, then goes back to the detected level.
+template<typename F>
+void for_each_level(F&& fn) {
+	for (auto level : {BufferStreamCPU::LEVEL_SCALAR, BufferStreamCPU::LEVEL_SSE42, BufferStreamCPU::LEVEL_AVX2, BufferStreamCPU::LEVEL_AVX512}) {
+		if (level > BufferStreamCPU::detected()) {
+			continue;
+		}
+		SCOPED_TRACE(BufferStreamCPU::name(level));
+		EXPECT_EQ(BufferStreamDispatch::force(level), level);
+		EXPECT_EQ(BufferStreamDispatch::level(), level);
+		fn(level);
+	}
+	BufferStreamDispatch::reset();
+}
+
+template<std::uint64_t Size>
+void check_swap(void (*BufferStreamKernels::*kernel)(std::byte*, std::uint64_t)) {
+	// Lengths on both sides of every vector width, so each main loop and tail gets run
+	for (std::uint64_t n : {0, 1, 7, 8, 15, 16, 31, 32, 33, 63, 64, 65, 200, 1001}) {
+		std::vector<std::byte> bytes(n * Size + 1);
+		for (std::uint64_t i = 0; i < bytes.size(); i++) {
+			bytes[i] = static_cast<std::byte>(i * 7 + 3);
+		}
+		auto expected = bytes;
+		BufferStreamKernels::swap_scalar<Size>(expected.data() + 1, n);
+
+		// Offset by a byte, since streams rarely hand out aligned pointers
+		(BufferStreamDispatch::kernels().*kernel)(bytes.data() + 1, n);
+		EXPECT_EQ(bytes, expected) << n << " elements of " << Size << " bytes";
+	}
+}
+
+} // namespace
+
+TEST(Dispatch, detect) {
+	EXPECT_GE(BufferStreamCPU::detected(), BufferStreamCPU::LEVEL_SCALAR);
+	EXPECT_EQ(BufferStreamDispatch::level(), BufferStreamCPU::detected());
+
+	// Levels the CPU can't run are clamped to the detected level
+	EXPECT_EQ(BufferStreamDispatch::force(BufferStreamCPU::LEVEL_AVX512), BufferStreamCPU::detected());
+	BufferStreamDispatch::reset();
+}
+
+TEST(Dispatch, swap_scalar) {
+	std::uint32_t value = 0x11223344;
+	BufferStreamKernels::swap_scalar<4>(reinterpret_cast<std::byte*>(&value), 1);
+	EXPECT_EQ(value, 0x44332211);
+
+	std::uint64_t wide = 0x0102030405060708;
+	BufferStreamKernels::swap_scalar<8>(reinterpret_cast<std::byte*>(&wide), 1);
+	EXPECT_EQ(wide, 0x0807060504030201);
+}
+
+TEST(Dispatch, swap_every_level) {
+	for_each_level([](BufferStreamCPU::Level) {
+		check_swap<2>(&BufferStreamKernels::swap16);
+		check_swap<4>(&BufferStreamKernels::swap32);
+		check_swap<8>(&BufferStreamKernels::swap64);
+	});
+}
+
+TEST(Dispatch, read_big_endian_every_level) {
+	std::vector<std::uint32_t> source(100);
+	for (std::uint64_t i = 0; i < source.size(); i++) {
+		source[i] = static_cast<std::uint32_t>(i * 0x01020304);
+	}
+
+	for_each_level([&source](BufferStreamCPU::Level) {
+		std::vector<std::byte> buffer;
+		BufferStream out{buffer};
+		out.set_big_endian(true);
+		out.write(source.data(), source.size());
+
+		BufferStream in{buffer};
+		in.set_big_endian(true);
+		std::vector<std::uint32_t> values(source.size());
+		in.read(values.data(), values.size());
+		EXPECT_EQ(values, source);
+
+		in.seek_u(0);
+		in.set_big_endian(false);
+		EXPECT_EQ(in.read<std::uint32_t>(), 0);
+		EXPECT_EQ(in.read<std::uint32_t>(), 0x04030201);
+		EXPECT_EQ(in.seek_u(8).read<std::uint32_t>(), 0x08060402);
+	});
+}
+
+TEST(Dispatch, compare_every_level) {
+	std::vector<std::byte> a(300);
+	for (std::uint64_t i = 0; i < a.size(); i++) {
+		a[i] = static_cast<std::byte>(i * 7 + 3);
+	}
+	for_each_level([&a](BufferStreamCPU::Level) {
+		const auto& kernels = BufferStreamDispatch::kernels();
+		// One difference, or one equal byte, at every position on both sides of each vector width
+		for (std::uint64_t n : {0, 1, 15, 16, 17, 63, 64, 65, 200, 299}) {
+			for (std::uint64_t at = 0; at <= n; at++) {
+				auto b = a;
+				if (at < n) {
+					b[at + 1] ^= std::byte{0x40};
+				}
+				EXPECT_EQ(kernels.mismatch(a.data() + 1, b.data() + 1, n), at) << n << " bytes";
+
+				std::vector<std::byte> c(a.size());
+				for (std::uint64_t i = 0; i < c.size(); i++) {
+					c[i] = ~a[i];
+				}
+				if (at < n) {
+					c[at + 1] = a[at + 1];
+				}
+				EXPECT_EQ(kernels.first_equal(a.data() + 1, c.data() + 1, n), at) << n << " bytes";
+			}
+		}
+	});
+}
+
+TEST(Dispatch, shuffle_layout) {
+	const std::uint32_t values[] = {0x11223344, 0x55667788};
+	std::vector<std::byte> buffer;
+	BufferStream out{buffer};
+	out.write_shuffled(std::span{values});
+	out.set_big_endian(true).write_shuffled(std::span{values});
+	const std::vector<std::uint8_t> expected{
+		0x44, 0x88, 0x33, 0x77, 0x22, 0x66, 0x11, 0x55,
+		0x11, 0x55, 0x22, 0x66, 0x33, 0x77, 0x44, 0x88,
+	};
+	EXPECT_EQ(std::vector<std::uint8_t>(reinterpret_cast<const std::uint8_t*>(buffer.data()), reinterpret_cast<const std::uint8_t*>(buffer.data()) + out.tell()), expected);
+
+	// Bit plane j of 8 bytes holds bit j of each, the first byte in the lowest bit; the ninth byte isn't shuffled
+	const std::uint8_t bytes[] = {0x01, 0x00, 0x01, 0x80, 0x00, 0x00, 0x00, 0x03, 0xab};
+	std::vector<std::byte> bits;
+	BufferStream bitStream{bits};
+	ASSERT_EQ(bitStream.write_bitshuffled(std::span{bytes}).tell(), 9);
+	EXPECT_EQ(bits[0], std::byte{0x85});
+	EXPECT_EQ(bits[1], std::byte{0x80});
+	EXPECT_EQ(bits[7], std::byte{0x08});
+	EXPECT_EQ(bits[8], std::byte{0xab});
+}
+
+TEST(Dispatch, shuffle_every_level) {
+	std::vector<std::byte> elements(1001 * 9);
+	for (std::uint64_t i = 0; i < elements.size(); i++) {
+		elements[i] = static_cast<std::byte>(i * 7 + i / 13);
+	}
+	for_each_level([&elements](BufferStreamCPU::Level) {
+		const auto& kernels = BufferStreamDispatch::kernels();
+		for (std::uint64_t size : {1, 2, 3, 4, 8, 9}) {
+			for (std::uint64_t n : {0, 1, 15, 16, 17, 31, 32, 33, 64, 100, 1001}) {
+				for (bool swap : {false, true}) {
+					std::vector<std::byte> expected(n * size);
+					for (std::uint64_t i = 0; i < n; i++) {
+						for (std::uint64_t b = 0; b < size; b++) {
+							expected[(swap ? size - 1 - b : b) * n + i] = elements[i * size + b];
+						}
+					}
+					std::vector<std::byte> shuffled(n * size);
+					kernels.shuffle(shuffled.data(), elements.data(), n, size, swap);
+					EXPECT_EQ(shuffled, expected) << n << " elements of " << size << " bytes, swap " << swap;
+
+					std::vector<std::byte> unshuffled(n * size);
+					kernels.unshuffle(unshuffled.data(), shuffled.data(), n, size, swap);
+					EXPECT_TRUE(std::equal(unshuffled.begin(), unshuffled.end(), elements.begin())) << n << " elements of " << size << " bytes, swap " << swap;
+				}
+			}
+		}
+
+		for (std::uint64_t n : {0, 8, 16, 24, 32, 40, 64, 72, 128, 256, 264, 392, 1000}) {
+			const std::uint64_t stride = n / 8 + 3;
+			std::vector<std::byte> expected(8 * stride);
+			for (std::uint64_t i = 0; i < n; i++) {
+				for (std::uint64_t j = 0; j < 8; j++) {
+					if ((static_cast<unsigned>(elements[i]) >> j) & 1) {
+						expected[j * stride + i / 8] |= static_cast<std::byte>(1 << (i % 8));
+					}
+				}
+			}
+			std::vector<std::byte> planes(8 * stride);
+			kernels.bit_transpose(planes.data(), stride, elements.data(), n);
+			EXPECT_EQ(planes, expected) << n << " bytes";
+
+			std::vector<std::byte> bytes(n);
+			kernels.bit_untranspose(bytes.data(), planes.data(), stride, n);
+			EXPECT_TRUE(std::equal(bytes.begin(), bytes.end(), elements.begin())) << n << " bytes";
+		}
+	});
+}
+
+TEST(Dispatch, shuffled_stream_every_level) {
+	std::vector<double> source(3000);
+	for (std::uint64_t i = 0; i < source.size(); i++) {
+		source[i] = 20.0 + static_cast<double>(i % 97) * 0.125;
+	}
+	for_each_level([&source](BufferStreamCPU::Level) {
+		for (bool bigEndian : {false, true}) {
+			for (std::uint64_t n : {0, 7, 8, 1001, 3000}) {
+				const std::span<const double> values{source.data(), n};
+				std::vector<std::byte> buffer;
+				BufferStream out{buffer};
+				out.set_big_endian(bigEndian);
+				out.write_shuffled(values).write_bitshuffled(values).write(std::uint8_t{0xee});
+				ASSERT_EQ(out.tell(), 16 * n + 1);
+
+				BufferStream in{buffer};
+				in.set_big_endian(bigEndian);
+				std::vector<double> shuffled(n), bitshuffled(n);
+				in.read_shuffled(std::span{shuffled}).read_bitshuffled(std::span{bitshuffled});
+				EXPECT_TRUE(std::equal(shuffled.begin(), shuffled.end(), values.begin())) << n << " elements";
+				EXPECT_TRUE(std::equal(bitshuffled.begin(), bitshuffled.end(), values.begin())) << n << " elements";
+				EXPECT_EQ(in.read<std::uint8_t>(), 0xee);
+			}
+		}
+	});
+
+	// Bit shuffled big endian data is the little endian bit planes with the byte groups reversed
+	const std::uint16_t words[] = {0x0102, 0x0304, 0x0506, 0x0708, 0x090a, 0x0b0c, 0x0d0e, 0x0f10};
+	std::vector<std::byte> little, big;
+	BufferStream{little}.write_bitshuffled(std::span{words});
+	BufferStream{big}.set_big_endian(true).write_bitshuffled(std::span{words});
+	ASSERT_EQ(little.size(), 16);
+	ASSERT_EQ(big.size(), 16);
+	EXPECT_TRUE(std::equal(little.begin(), little.begin() + 8, big.begin() + 8));
+	EXPECT_TRUE(std::equal(little.begin() + 8, little.end(), big.begin()));
+}
@@ -0,0 +1,731 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include <FileStream.h>
+#include <FileStreamSort.h>
+#include <FileStreamSortedTable.h>
+
+namespace {
+
+std::string temp_file_path(std::string_view name) {
+	return (std::filesystem::temp_directory_path() / "bufferstream_test" / name).string();
+}
+
+} // namespace
+
+TEST(FileStream, latency_histogram_buckets) {
+	for (std::uint64_t value : {0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123'456'789ull, ~0ull}) {
+		const auto index = FileStreamLatencyHistogram::bucket_index(value);
+		EXPECT_LT(index, FileStreamLatencyHistogram::BUCKET_COUNT);
+		EXPECT_LE(FileStreamLatencyHistogram::bucket_lowest_value(index), value);
+		EXPECT_GE(FileStreamLatencyHistogram::bucket_highest_value(index), value);
+	}
+	for (std::uint64_t index = 1; index < FileStreamLatencyHistogram::BUCKET_COUNT; index++) {
+		EXPECT_EQ(FileStreamLatencyHistogram::bucket_lowest_value(index), FileStreamLatencyHistogram::bucket_highest_value(index - 1) + 1);
+	}
+}
+
+TEST(FileStream, latency_histogram_percentiles) {
+	FileStreamLatencyHistogram a, b;
+	for (std::uint64_t i = 1; i <= 900; i++) {
+		a.record(100);
+	}
+	for (std::uint64_t i = 1; i <= 100; i++) {
+		b.record(10'000);
+	}
+	a.merge(b);
+
+	EXPECT_EQ(a.count(), 1000);
+	EXPECT_EQ(a.max_value(), 10'000);
+	EXPECT_EQ(a.value_at_percentile(50), FileStreamLatencyHistogram::bucket_highest_value(FileStreamLatencyHistogram::bucket_index(100)));
+	EXPECT_EQ(a.value_at_percentile(99), 10'000);
+
+	a.reset();
+	EXPECT_EQ(a.count(), 0);
+	EXPECT_EQ(a.value_at_percentile(99), 0);
+}
+
+TEST(FileStream, latency_histograms_record) {
+	const auto path = temp_file_path("latency_histograms_record.bin");
+	FileStreamLatencyHistograms histograms;
+	{
+		FileStream stream{path, FileStream::OPT_READ | FileStream::OPT_WRITE | FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		ASSERT_TRUE(stream);
+		stream.set_latency_histograms(&histograms);
+
+		std::vector<std::byte> data(100'000);
+		stream.write<std::uint32_t>(42).write(data);
+		stream.flush();
+		stream.seek_in(0);
+		EXPECT_EQ(stream.read<std::uint32_t>(), 42);
+	}
+
+	EXPECT_EQ(histograms.get(FileStreamLatencyHistograms::OP_WRITE, FileStreamLatencyHistograms::SIZE_UP_TO_16).count(), 1);
+	EXPECT_EQ(histograms.get(FileStreamLatencyHistograms::OP_WRITE, FileStreamLatencyHistograms::SIZE_OVER_64K).count(), 1);
+	EXPECT_EQ(histograms.get(FileStreamLatencyHistograms::OP_READ).count(), 1);
+	EXPECT_EQ(histograms.get(FileStreamLatencyHistograms::OP_SEEK).count(), 1);
+	EXPECT_EQ(histograms.get(FileStreamLatencyHistograms::OP_FLUSH).count(), 1);
+	EXPECT_NE(histograms.report().find("write\t>64K\t1\t"), std::string::npos);
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, block_cache_read) {
+	const auto path = temp_file_path("block_cache_read.bin");
+	std::vector<std::uint32_t> data(50'000);
+	for (std::uint32_t i = 0; i < data.size(); i++) {
+		data[i] = i * 2654435761u;
+	}
+	{
+		FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		stream.write(data);
+	}
+
+	auto cache = std::make_shared<FileStreamBlockCache>(64 * 1024, 4096, 4);
+	FileStream a{path};
+	FileStream b{path};
+	a.set_block_cache(cache);
+	b.set_block_cache(cache);
+
+	for (std::uint64_t i = 0; i < 2000; i++) {
+		const std::uint64_t index = (i * 7919) % data.size();
+		auto& stream = i % 2 ? a : b;
+		EXPECT_EQ(stream.seek_in_u(index * sizeof(std::uint32_t)).read<std::uint32_t>(), data[index]);
+		EXPECT_EQ(stream.tell_in(), (index + 1) * sizeof(std::uint32_t));
+	}
+	const auto stats = cache->stats();
+	EXPECT_GT(stats.hits, 0);
+	EXPECT_GT(stats.misses, 0);
+	EXPECT_GT(stats.evictions, 0);
+
+	// Reads spanning several blocks
+	a.seek_in(1000);
+	std::vector<std::byte> bytes = a.read_bytes(10'000);
+	EXPECT_EQ(std::memcmp(bytes.data(), reinterpret_cast<const std::byte*>(data.data()) + 1000, bytes.size()), 0);
+	EXPECT_EQ(a.peek(), reinterpret_cast<const std::byte*>(data.data())[11'000]);
+	EXPECT_EQ(a.tell_in(), 11'000);
+
+	// Reading past the end fails
+	a.seek_in(2, std::ios::end);
+	EXPECT_TRUE(a);
+	std::ignore = a.read<std::uint32_t>();
+	EXPECT_FALSE(a);
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, block_cache_write_through) {
+	const auto path = temp_file_path("block_cache_write_through.bin");
+	{
+		FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		stream.write(std::vector<std::uint32_t>(10'000, 1));
+	}
+
+	auto cache = std::make_shared<FileStreamBlockCache>(64 * 1024, 4096, 4);
+	FileStream reader{path};
+	FileStream writer{path, FileStream::OPT_READ | FileStream::OPT_WRITE};
+	reader.set_block_cache(cache);
+	writer.set_block_cache(cache);
+
+	EXPECT_EQ(reader.seek_in(4096).read<std::uint32_t>(), 1);
+	writer.seek_out(4096).write<std::uint32_t>(2);
+	EXPECT_EQ(reader.seek_in(4096).read<std::uint32_t>(), 2);
+	EXPECT_EQ(writer.seek_in(4096).read<std::uint32_t>(), 2);
+	EXPECT_EQ(writer.tell_out(), 4100);
+
+	// A stream that truncates the file drops the blocks cached from its old contents
+	{
+		FileStream rewriter{path, FileStream::OPT_TRUNCATE};
+		rewriter.write(std::vector<std::uint32_t>(10'000, 3)).flush();
+		rewriter.set_block_cache(cache);
+	}
+	EXPECT_EQ(reader.seek_in(4096).read<std::uint32_t>(), 3);
+
+	// Writes that bypass the cache need the file's blocks invalidated by hand
+	{
+		FileStream outside{path, FileStream::OPT_READ | FileStream::OPT_WRITE};
+		outside.seek_out(4096).write<std::uint32_t>(4);
+	}
+	EXPECT_EQ(reader.seek_in(4096).read<std::uint32_t>(), 3);
+	cache->invalidate(cache->register_file(path));
+	EXPECT_EQ(reader.seek_in(4096).read<std::uint32_t>(), 4);
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, block_cache_write_grows_file) {
+	const auto path = temp_file_path("block_cache_write_grows_file.bin");
+	{
+		FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		stream.write(std::vector<std::uint8_t>(100, 1));
+	}
+
+	auto cache = std::make_shared<FileStreamBlockCache>(64 * 1024, 4096, 4);
+	FileStream stream{path, FileStream::OPT_READ | FileStream::OPT_WRITE};
+	stream.set_block_cache(cache);
+	EXPECT_EQ(stream.seek_in(0).read<std::uint8_t>(), 1);
+	// Caches an empty block past the end of the file
+	std::ignore = stream.seek_in(3 * 4096).read<std::uint8_t>();
+	EXPECT_FALSE(stream);
+	stream.clear();
+
+	// The short first block and the empty one no longer mark the end once a write goes past them
+	stream.seek_out(70000).write<std::uint8_t>(2);
+	stream.flush();
+	EXPECT_EQ(stream.seek_in(200).read<std::uint8_t>(), 0);
+	EXPECT_TRUE(stream);
+	EXPECT_EQ(stream.seek_in(99).read<std::uint8_t>(), 1);
+	EXPECT_EQ(stream.seek_in(3 * 4096).read<std::uint8_t>(), 0);
+	EXPECT_TRUE(stream);
+	EXPECT_EQ(stream.seek_in(70000).read<std::uint8_t>(), 2);
+	EXPECT_TRUE(stream);
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, access_pattern_detector) {
+	using Detector = FileStreamAccessPatternDetector;
+	{
+		Detector detector;
+		for (std::uint64_t i = 0; i < 8; i++) {
+			detector.record(i * 16, 16);
+		}
+		EXPECT_EQ(detector.get_pattern(), Detector::PATTERN_SEQUENTIAL);
+	}
+	{
+		Detector detector;
+		for (std::uint64_t i = 0; i < 8; i++) {
+			detector.record(i * 4096, 16);
+		}
+		EXPECT_EQ(detector.get_pattern(), Detector::PATTERN_STRIDED);
+		EXPECT_EQ(detector.get_stride(), 4096);
+
+		// One odd read doesn't change the classification
+		detector.record(3, 16);
+		EXPECT_EQ(detector.get_pattern(), Detector::PATTERN_STRIDED);
+	}
+	{
+		Detector detector;
+		for (std::uint64_t i = 0; i < 8; i++) {
+			detector.record((i * 7919 * 4096) % 1'000'003, 16);
+		}
+		EXPECT_EQ(detector.get_pattern(), Detector::PATTERN_RANDOM);
+	}
+}
+
+TEST(FileStream, access_pattern) {
+	const auto path = temp_file_path("access_pattern.bin");
+	{
+		FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		stream.write(std::vector<std::byte>(1024 * 1024));
+	}
+
+	FileStream stream{path};
+	EXPECT_EQ(stream.get_access_hint(), FileStream::HINT_NONE);
+	stream.set_access_hint(FileStream::HINT_AUTO);
+	EXPECT_EQ(stream.get_access_pattern(), FileStreamAccessPatternDetector::PATTERN_UNKNOWN);
+
+	for (int i = 0; i < 8; i++) {
+		std::ignore = stream.read<std::uint64_t>();
+	}
+	EXPECT_EQ(stream.get_access_pattern(), FileStreamAccessPatternDetector::PATTERN_SEQUENTIAL);
+
+	for (int i = 0; i < 8; i++) {
+		std::ignore = stream.seek_in(i * 8192).read<std::uint64_t>();
+	}
+	EXPECT_EQ(stream.get_access_pattern(), FileStreamAccessPatternDetector::PATTERN_STRIDED);
+
+	for (int i = 0; i < 8; i++) {
+		std::ignore = stream.seek_in((i * 7919 * 4096) % 1'000'003).read<std::uint64_t>();
+	}
+	EXPECT_EQ(stream.get_access_pattern(), FileStreamAccessPatternDetector::PATTERN_RANDOM);
+
+	stream.set_access_hint(FileStream::HINT_SEQUENTIAL);
+	EXPECT_EQ(stream.get_access_pattern(), FileStreamAccessPatternDetector::PATTERN_SEQUENTIAL);
+	stream.set_access_hint(FileStream::HINT_NONE);
+	EXPECT_EQ(stream.get_access_pattern(), FileStreamAccessPatternDetector::PATTERN_UNKNOWN);
+	EXPECT_TRUE(stream);
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, vectored) {
+	const auto path = temp_file_path("vectored.bin");
+	for (const bool bigEndian : {false, true}) {
+		const std::uint32_t header = 0x01020304;
+		const std::array<std::byte, 5> body{std::byte{1}, std::byte{2}, std::byte{3}, std::byte{4}, std::byte{5}};
+		const std::array<std::uint16_t, 3> footer{0x0102, 0x0304, 0x0506};
+		{
+			FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+			stream.set_big_endian(bigEndian);
+			stream.write<std::uint8_t>(0xff);
+			stream.write_vectored({std::span{&header, 1}, std::span{body}, std::span{footer}});
+			stream.write<std::uint8_t>(0xee);
+			EXPECT_EQ(stream.tell_out(), 1 + sizeof(header) + body.size() + sizeof(footer) + 1);
+		}
+
+		FileStream stream{path};
+		stream.set_big_endian(bigEndian);
+		EXPECT_EQ(std::filesystem::file_size(path), 1 + sizeof(header) + body.size() + sizeof(footer) + 1);
+		EXPECT_EQ(stream.read<std::uint8_t>(), 0xff);
+		EXPECT_EQ(stream.read<std::uint32_t>(), header);
+
+		std::array<std::byte, 5> bodyIn{};
+		std::array<std::uint16_t, 3> footerIn{};
+		stream.seek_in(1);
+		std::uint32_t headerIn = 0;
+		stream.read_vectored({std::span{&headerIn, 1}, std::span{bodyIn}, std::span{footerIn}});
+		EXPECT_EQ(headerIn, header);
+		EXPECT_EQ(bodyIn, body);
+		EXPECT_EQ(footerIn, footer);
+		EXPECT_EQ(stream.read<std::uint8_t>(), 0xee);
+		EXPECT_TRUE(stream);
+
+		// Reading past the end fails the stream
+		stream.seek_in(2, std::ios::end);
+		std::array<std::byte, 4> tail{};
+		std::vector<std::span<std::byte>> buffers{std::span{tail}.first(2), std::span{tail}.subspan(2)};
+		stream.read_vectored(std::span<const std::span<std::byte>>{buffers});
+		EXPECT_FALSE(stream);
+		EXPECT_EQ(tail[0], std::byte{bigEndian ? std::uint8_t{0x06} : std::uint8_t{0x05}});
+		EXPECT_EQ(tail[1], std::byte{0xee});
+
+		// Const segments can't be read into, and nothing is read into the others either
+		stream.clear();
+		stream.seek_in(1);
+		const std::array<std::byte, 4> constant{};
+		std::array<std::byte, 4> before{};
+		try {
+			stream.read_vectored({std::span{before}, std::span{constant}});
+			FAIL();
+		} catch (const std::invalid_argument&) {}
+		stream.set_exceptions_enabled(false).read_vectored({std::span{before}, std::span{constant}});
+		stream.set_exceptions_enabled(true);
+		EXPECT_EQ(before, (std::array<std::byte, 4>{}));
+		EXPECT_EQ(constant, (std::array<std::byte, 4>{}));
+		EXPECT_EQ(stream.tell_in(), 1);
+	}
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, vectored_many_segments) {
+	const auto path = temp_file_path("vectored_many_segments.bin");
+	std::vector<std::uint64_t> values(5000);
+	for (std::uint64_t i = 0; i < values.size(); i++) {
+		values[i] = i * 0x0101010101010101ull;
+	}
+	std::vector<FileStreamSegment> segments;
+	for (auto& value : values) {
+		segments.emplace_back(std::span{&value, 1});
+	}
+	{
+		FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		stream.set_big_endian(true);
+		stream.write_vectored(segments);
+	}
+
+	FileStream stream{path};
+	stream.set_big_endian(true);
+	EXPECT_EQ(std::filesystem::file_size(path), values.size() * sizeof(std::uint64_t));
+	EXPECT_EQ(stream.read<std::uint64_t>(), 0);
+	EXPECT_EQ(stream.read<std::uint64_t>(), 0x0101010101010101ull);
+
+	std::vector<std::uint64_t> in(values.size());
+	segments.clear();
+	for (auto& value : in) {
+		segments.emplace_back(std::span{&value, 1});
+	}
+	stream.seek_in(0).read_vectored(segments);
+	EXPECT_EQ(in, values);
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, read_strided) {
+	const auto path = temp_file_path("read_strided.bin");
+	{
+		FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		stream.set_big_endian(true);
+		for (std::uint32_t row = 0; row < 64; row++) {
+			for (std::uint32_t column = 0; column < 64; column++) {
+				stream.write(row << 16 | column);
+			}
+		}
+	}
+
+	FileStream stream{path};
+	stream.set_big_endian(true);
+
+	// Most of each row, read in one go and gathered in memory
+	std::vector<std::uint32_t> wide(4 * 60);
+	stream.seek_in(4).read_strided(std::span{wide}, 4, 60, 64);
+	EXPECT_EQ(wide[0], 1);
+	EXPECT_EQ(wide[61], 1 << 16 | 2);
+	EXPECT_EQ(stream.tell_in(), (3 * 64 + 61) * sizeof(std::uint32_t));
+
+	// A narrow column, read run by run
+	std::vector<std::uint32_t> narrow(8 * 2);
+	stream.seek_in(0).read_strided(std::span{narrow}, 8, 2, 64 * 8);
+	EXPECT_EQ(narrow[0], 0);
+	EXPECT_EQ(narrow[3], 8 << 16 | 1);
+	EXPECT_EQ(narrow[15], 56 << 16 | 1);
+	EXPECT_EQ(stream.tell_in(), (7 * 64 * 8 + 2) * sizeof(std::uint32_t));
+	EXPECT_TRUE(stream);
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, read_with_allocator) {
+	const auto path = temp_file_path("read_with_allocator.bin");
+	{
+		FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		stream.write(std::string_view{"Hello world"});
+		stream.write(std::string_view{"abc"}, true, 8);
+	}
+
+	std::array<std::byte, 1024> storage{};
+	std::pmr::monotonic_buffer_resource arena{storage.data(), storage.size(), std::pmr::null_memory_resource()};
+
+	FileStream stream{path};
+	EXPECT_EQ(stream.read_string(&arena), "Hello world");
+	EXPECT_EQ(stream.read_string(8, true, &arena), "abc");
+	EXPECT_EQ(stream.tell_in(), 20);
+
+	const auto bytes = stream.seek_in(0).read_bytes(5, &arena);
+	EXPECT_EQ(bytes.size(), 5);
+	EXPECT_EQ(bytes.get_allocator().resource(), &arena);
+
+	std::array<std::byte, 6> into{};
+	stream.read_bytes_into(into);
+	EXPECT_EQ(into[1], std::byte{'w'});
+	EXPECT_TRUE(stream);
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, file_over_4gb) {
+	const auto path = temp_file_path("over_4gb.bin");
+	constexpr std::uint64_t size = 5ull * 1024 * 1024 * 1024;
+	constexpr std::uint64_t boundary = 4ull * 1024 * 1024 * 1024;
+	std::array<std::uint32_t, 64> values{};
+	for (std::uint64_t i = 0; i < values.size(); i++) {
+		values[i] = static_cast<std::uint32_t>(i * 0x01020304);
+	}
+	{
+		FileStream stream{path, FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		stream.write<std::uint8_t>(1);
+	}
+	// Sparse, so only the blocks written to take up disk space
+	std::error_code ec;
+	std::filesystem::resize_file(path, size, ec);
+	if (ec) {
+		std::filesystem::remove(path);
+		GTEST_SKIP() << "Can't create a sparse 5 GiB file: " << ec.message();
+	}
+
+	{
+		FileStream stream{path, FileStream::OPT_READ | FileStream::OPT_WRITE};
+		stream.set_big_endian(true);
+		stream.seek_out_u(boundary - 128).write(values);
+		EXPECT_EQ(stream.tell_out(), boundary + 128);
+		stream.write_vectored({std::span{values}.first(32), std::span{values}.subspan(32)});
+		EXPECT_EQ(stream.tell_out(), boundary + 384);
+	}
+	EXPECT_EQ(std::filesystem::file_size(path), size);
+
+	FileStream stream{path};
+	stream.set_big_endian(true);
+	EXPECT_EQ(stream.read<std::uint8_t>(), 1);
+
+	// Skip more than 2^31 elements, across the 4 GiB boundary
+	stream.skip_in_u<std::uint32_t>((boundary - 128 - 4) / sizeof(std::uint32_t)).skip_in(3);
+	EXPECT_EQ(stream.tell_in(), boundary - 128);
+	std::vector<std::uint32_t> valuesIn;
+	stream.read(valuesIn, values.size() * 2);
+	EXPECT_TRUE(std::equal(values.begin(), values.end(), valuesIn.begin()));
+	EXPECT_TRUE(std::equal(values.begin(), values.end(), valuesIn.begin() + values.size()));
+	EXPECT_EQ(stream.tell_in(), boundary + 384);
+
+	std::array<std::uint32_t, 64> vectoredIn{};
+	stream.seek_in_u(boundary - 128).read_vectored({std::span{vectoredIn}.first(10), std::span{vectoredIn}.subspan(10)});
+	EXPECT_EQ(vectoredIn, values);
+
+	stream.seek_in_u(4, std::ios::end);
+	EXPECT_EQ(stream.tell_in(), size - 4);
+	EXPECT_EQ(stream.read<std::uint32_t>(), 0);
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, sorted_table_round_trip) {
+	const auto path = temp_file_path("table.bsst");
+	auto key_of = [](std::uint64_t i) {
+		return "user/" + std::to_string(100000 + i * 2);
+	};
+	constexpr std::uint64_t count = 20000;
+	{
+		FileStreamSortedTableWriter writer{path, 512};
+		ASSERT_TRUE(writer);
+		for (std::uint64_t i = 0; i < count; i++) {
+			writer.add(key_of(i), "value " + std::to_string(i));
+		}
+		// Empty keys and values are fine, but keys must keep increasing
+		EXPECT_THROW(writer.add(key_of(0), "again"), std::invalid_argument);
+		EXPECT_THROW(writer.add(key_of(count - 1), "again"), std::invalid_argument);
+		writer.add("zzz", std::string_view{});
+		EXPECT_EQ(writer.size(), count + 1);
+	}
+
+	FileStreamSortedTableReader reader{path};
+	ASSERT_TRUE(reader);
+	EXPECT_EQ(reader.size(), count + 1);
+	EXPECT_GT(reader.block_count(), 100);
+	auto text = [](std::span<const std::byte> value) {
+		return std::string{reinterpret_cast<const char*>(value.data()), value.size()};
+	};
+	for (std::uint64_t i = 0; i < count; i += 7) {
+		const auto value = reader.get(key_of(i));
+		ASSERT_TRUE(value);
+		EXPECT_EQ(text(*value), "value " + std::to_string(i));
+	}
+	ASSERT_TRUE(reader.get("zzz"));
+	EXPECT_TRUE(reader.get("zzz")->empty());
+
+	// Keys between, before and after the ones added aren't found, and nearly all of them stop at the filter
+	std::uint64_t filtered = 0;
+	for (std::uint64_t i = 0; i < count; i++) {
+		const auto missing = "user/" + std::to_string(100001 + i * 2);
+		EXPECT_FALSE(reader.get(missing));
+		filtered += !reader.may_contain(missing);
+	}
+	EXPECT_GT(filtered, count * 97 / 100);
+	EXPECT_FALSE(reader.get(""));
+	EXPECT_FALSE(reader.get("a"));
+	EXPECT_FALSE(reader.get("zzzz"));
+	EXPECT_FALSE(reader.find_block("zzzz"));
+
+	// Each key lives in exactly the block the index points to
+	std::uint64_t visited = 0;
+	std::string previous;
+	reader.for_each([&](std::string_view key, std::span<const std::byte>) {
+		EXPECT_LT(previous, key);
+		previous = key;
+		visited++;
+	});
+	EXPECT_EQ(visited, count + 1);
+	EXPECT_EQ(reader.find_block(key_of(0)), 0);
+	EXPECT_EQ(reader.find_block("zzz"), reader.block_count() - 1);
+
+	// A table without a filter still finds everything
+	{
+		FileStreamSortedTableWriter writer{path, 64, 1, 0};
+		writer.add("a", "1").add("b", "2");
+	}
+	FileStreamSortedTableReader unfiltered{path};
+	ASSERT_TRUE(unfiltered);
+	EXPECT_TRUE(unfiltered.may_contain("c"));
+	EXPECT_EQ(text(*unfiltered.get("b")), "2");
+	EXPECT_FALSE(unfiltered.get("c"));
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, sorted_table_malformed) {
+	const auto path = temp_file_path("malformed.bsst");
+	{
+		FileStreamSortedTableWriter writer{path, 128, 4};
+		for (std::uint64_t i = 0; i < 200; i++) {
+			writer.add("key" + std::to_string(1000 + i), std::string(i % 13, 'v'));
+		}
+	}
+	const auto size = std::filesystem::file_size(path);
+	std::vector<std::byte> bytes(size);
+	FileStream{path}.read(bytes.data(), bytes.size());
+	auto rewrite = [&path](const std::vector<std::byte>& contents) {
+		FileStream{path, FileStream::OPT_TRUNCATE}.write(contents.data(), contents.size());
+	};
+
+	EXPECT_FALSE(FileStreamSortedTableReader{temp_file_path("missing.bsst")});
+	rewrite({});
+	EXPECT_FALSE(FileStreamSortedTableReader{path});
+	rewrite(std::vector<std::byte>(bytes.begin(), bytes.end() - 1));
+	EXPECT_FALSE(FileStreamSortedTableReader{path});
+
+	// Flipping any byte either fails validation, or leaves a table whose lookups stay within the file
+	for (std::uint64_t i = 0; i < size; i++) {
+		auto flipped = bytes;
+		flipped[i] ^= std::byte{0x80};
+		rewrite(flipped);
+		FileStreamSortedTableReader reader{path};
+		if (reader) {
+			reader.set_exceptions_enabled(false);
+			(void) reader.get("key1000");
+			(void) reader.get("key1150");
+			reader.for_each([](std::string_view, std::span<const std::byte>) {});
+		}
+	}
+
+	// A corrupt block is reported when it's read, and the blocks around it are still readable
+	auto corrupt = bytes;
+	corrupt[FileStreamSortedTableFormat::HEADER_SIZE] = std::byte{5};
+	rewrite(corrupt);
+	FileStreamSortedTableReader reader{path};
+	ASSERT_TRUE(reader);
+	EXPECT_THROW((void) reader.get("key1000"), std::invalid_argument);
+	EXPECT_TRUE(reader.get("key1199"));
+	reader.set_exceptions_enabled(false);
+	EXPECT_FALSE(reader.get("key1000"));
+
+	std::filesystem::remove(path);
+}
+
+TEST(FileStream, loser_tree) {
+	// Merging sorted sequences of every count, including none and ones that start empty
+	for (std::uint64_t k : {1, 2, 3, 5, 8, 13}) {
+		std::vector<std::vector<int>> sources(k);
+		std::vector<int> expected;
+		for (std::uint64_t i = 0; i < k; i++) {
+			for (std::uint64_t j = 0; j < (i * 7) % 11; j++) {
+				sources[i].push_back(static_cast<int>((j * 5 + i) % 17 + j * 17));
+				expected.push_back(sources[i].back());
+			}
+		}
+		std::sort(expected.begin(), expected.end());
+		std::vector<std::uint64_t> heads(k);
+		auto done = [&](std::uint64_t i) {
+			return heads[i] == sources[i].size();
+		};
+		FileStreamLoserTree tree{k, [&](std::uint64_t a, std::uint64_t b) {
+			return !done(a) && (done(b) || sources[a][heads[a]] < sources[b][heads[b]]);
+		}};
+		std::vector<int> merged;
+		for (std::uint64_t i = tree.top(); !done(i); i = tree.top()) {
+			merged.push_back(sources[i][heads[i]++]);
+			tree.replay();
+		}
+		EXPECT_EQ(merged, expected);
+	}
+}
+
+TEST(FileStream, sort_fixed_length) {
+	struct Record {
+		std::uint64_t key;
+		std::uint64_t index;
+	};
+	const auto input = temp_file_path("sort_input.bin");
+	const auto output = temp_file_path("sort_output.bin");
+	constexpr std::uint64_t count = 300000;
+	std::vector<Record> records(count);
+	std::mt19937_64 random{3};
+	for (std::uint64_t i = 0; i < count; i++) {
+		records[i] = {random() % 50000, i};
+	}
+	FileStream{input, FileStream::OPT_WRITE | FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT}.write(records.data(), records.size());
+
+	auto key_of = [](std::span<const std::byte> record) {
+		std::uint64_t key;
+		std::memcpy(&key, record.data(), sizeof(key));
+		return key;
+	};
+	FileStreamSorter sorter{key_of, sizeof(Record)};
+	sorter.set_memory_budget(0).set_threads(3).set_temp_directory(std::filesystem::temp_directory_path() / "bufferstream_test");
+	EXPECT_EQ(sorter.get_memory_budget(), 2 * FileStreamSorter<decltype(key_of)>::MIN_MERGE_BUFFER);
+	sorter.sort(input, output);
+	EXPECT_EQ(sorter.record_count(), count);
+	EXPECT_GT(sorter.run_count(), 4);
+	// Only two runs fit in this budget at once, so the runs are merged over several passes
+	EXPECT_GT(sorter.merge_passes(), 1);
+
+	// Equal keys keep their input order
+	std::stable_sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+		return a.key < b.key;
+	});
+	std::vector<Record> sorted(count);
+	FileStream{output}.read(sorted.data(), sorted.size());
+	EXPECT_TRUE(std::equal(sorted.begin(), sorted.end(), records.begin(), [](const Record& a, const Record& b) {
+		return a.key == b.key && a.index == b.index;
+	}));
+
+	// The run files are gone
+	for (const auto& entry : std::filesystem::directory_iterator{sorter.get_temp_directory()}) {
+		EXPECT_EQ(entry.path().filename().string().find("bufferstream_sort_"), std::string::npos);
+	}
+
+	// Input that fits in memory is sorted without any run files, and an empty file sorts to an empty file
+	FileStreamSorter{key_of, sizeof(Record)}.sort(output, input);
+	FileStream{input}.read(sorted.data(), sorted.size());
+	EXPECT_TRUE(std::equal(sorted.begin(), sorted.end(), records.begin(), [](const Record& a, const Record& b) {
+		return a.index == b.index;
+	}));
+	FileStream{input, FileStream::OPT_TRUNCATE};
+	FileStreamSorter empty{key_of, sizeof(Record)};
+	empty.sort(input, output);
+	EXPECT_EQ(empty.record_count(), 0);
+	EXPECT_EQ(std::filesystem::file_size(output), 0);
+
+	std::filesystem::remove(input);
+	std::filesystem::remove(output);
+}
+
+TEST(FileStream, sort_variable_length) {
+	const auto input = temp_file_path("sort_variable_input.bin");
+	const auto output = temp_file_path("sort_variable_output.bin");
+	std::vector<std::string> records;
+	std::mt19937_64 random{5};
+	{
+		FileStream file{input, FileStream::OPT_WRITE | FileStream::OPT_TRUNCATE | FileStream::OPT_CREATE_IF_NONEXISTENT};
+		for (std::uint64_t i = 0; i < 60000; i++) {
+			std::string record(random() % 120, 'x');
+			for (char& c : record) {
+				c = static_cast<char>('a' + random() % 4);
+			}
+			records.push_back(record);
+			file.write(static_cast<std::uint32_t>(record.size())).write(record, false);
+		}
+		// A record far longer than the merge buffers
+		records.emplace_back(3 * 1024 * 1024, 'b');
+		file.write(static_cast<std::uint32_t>(records.back().size())).write(records.back(), false);
+	}
+
+	// Keys can be views into the record they're taken from
+	FileStreamSorter sorter{[](std::span<const std::byte> record) {
+		return std::string_view{reinterpret_cast<const char*>(record.data()), record.size()};
+	}};
+	sorter.set_memory_budget(4 * 1024 * 1024).set_temp_directory(std::filesystem::temp_directory_path() / "bufferstream_test");
+	sorter.sort(input, output);
+	EXPECT_GT(sorter.run_count(), 1);
+
+	std::sort(records.begin(), records.end());
+	FileStream sorted{output};
+	for (const auto& record : records) {
+		ASSERT_EQ(sorted.read_string(sorted.read<std::uint32_t>(), false), record);
+	}
+	EXPECT_EQ(sorted.tell_in(), std::filesystem::file_size(output));
+
+	// Records that run past the end of the file, or files that aren't a whole number of records, can't be sorted
+	FileStream{input, FileStream::OPT_TRUNCATE}.write(std::uint32_t{10}).write(std::string{"short"}, false);
+	EXPECT_THROW(sorter.sort(input, output), std::invalid_argument);
+	EXPECT_THROW(FileStreamSorter([](std::span<const std::byte> record) { return record.size(); }, 4).sort(input, output), std::invalid_argument);
+	EXPECT_THROW(sorter.sort(temp_file_path("missing.bin"), output), std::invalid_argument);
+	// Nor can files with a few stray bytes after the last whole record
+	for (std::uint64_t stray = 1; stray < 4; stray++) {
+		FileStream{input, FileStream::OPT_TRUNCATE}.write(std::uint32_t{5}).write(std::string{"whole"}, false).write(std::string(stray, 'x'), false);
+		EXPECT_THROW(sorter.sort(input, output), std::invalid_argument);
+	}
+
+	// Errors from the key extractor reach the caller from any sorting thread
+	FileStream{input, FileStream::OPT_TRUNCATE}.write(std::vector<std::uint64_t>(100000));
+	FileStreamSorter throwing{[](std::span<const std::byte>) -> std::uint64_t {
+		throw std::runtime_error{"bad record"};
+	}, sizeof(std::uint64_t)};
+	throwing.set_threads(4);
+	EXPECT_THROW(throwing.sort(input, output), std::runtime_error);
+
+	// Failed writes aren't mistaken for a finished sort
+	if (std::filesystem::exists("/dev/full")) {
+		EXPECT_THROW(FileStreamSorter([](std::span<const std::byte> record) { return record[0]; }, sizeof(std::uint64_t)).sort(input, "/dev/full"), std::invalid_argument);
+	}
+
+	std::filesystem::remove(input);
+	std::filesystem::remove(output);
+}
@@ -0,0 +1,20 @@
+#include <gtest/gtest.h>
+
+#include <array>
+
+#include <BufferStream.h>
+
+// Nothing in this executable includes BufferStreamVectorKernels.h, the library target brings the kernels in
+TEST(HeaderOnly, vector_kernels_installed) {
+	EXPECT_TRUE(BufferStreamDispatch::vector_kernels_installed());
+	EXPECT_EQ(BufferStreamDispatch::level(), BufferStreamCPU::detected());
+
+	std::array<std::uint32_t, 16> values{};
+	values.fill(0x01020304);
+	BufferStream stream{values};
+	std::array<std::uint32_t, 16> swapped{};
+	stream.set_big_endian(true).read(swapped.data(), swapped.size());
+	for (const auto value : swapped) {
+		EXPECT_EQ(value, 0x04030201);
+	}
+}